@@ -0,0 +1,291 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Alarm and sound schedule. See alarm_schedule.h
+//
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/portmacro.h"
+
+// Own files to include
+#include "alarm_schedule.h"
+#include "display_functions.h"
+#include "schedule_cron.h"
+
+// Set logging tag per module
+static const char *TAG = "AlarmSchedule";
+
+#define DAY_MINUTES (24 * 60)
+// Looking ahead for the next time. A slot for 29 February can take 8 years
+#define SCHEDULE_MAX_DAYS (8 * 366)
+
+#if MAX_SOUNDFILES > 32
+#error "alarm_schedule_due returns a bit per slot in 32 bits"
+#endif
+
+// Sorted on when. The first entry goes off first.
+static schedule_entry_t schedule[MAX_SOUNDFILES];
+static int schedule_count = 0;
+static volatile bool schedule_dirty = true;
+// Last minute handed out. Each minute only once
+static uint32_t schedule_checked = 0;
+// Copy of the first entry for alarm_schedule_next. The http server reads
+// it while the display task changes the schedule. When is SCHEDULE_NEVER
+// when there is none or the settings changed.
+static schedule_entry_t schedule_head = {.when = SCHEDULE_NEVER, .slot = 0};
+static portMUX_TYPE schedule_head_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Days since 1970-01-01 of a date. Month 1 to 12. Works for all dates
+// after 1970 without the C library. (H. Hinnant days_from_civil)
+static int32_t days_from_date(int year, int month, int day) {
+  year -= month <= 2;
+  int32_t era = year / 400;
+  int32_t yoe = year - era * 400;
+  int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// And back
+static void date_from_days(int32_t days, int *year, int *month, int *day) {
+  days += 719468;
+  int32_t era = days / 146097;
+  int32_t doe = days - era * 146097;
+  int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int32_t mp = (5 * doy + 2) / 153;
+  *day = doy - (153 * mp + 2) / 5 + 1;
+  *month = mp + (mp < 10 ? 3 : -9);
+  *year = yoe + era * 400 + (*month <= 2);
+}
+
+static int days_in_month(int year, int month) {
+  static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if ((month == 2) && ((year % 4 == 0) && ((year % 100 != 0) || (year % 400 == 0)))) {
+    return 29;
+  }
+  return days[month - 1];
+}
+
+uint32_t alarm_schedule_minute(const struct tm *time) {
+  return (uint32_t)days_from_date(time->tm_year + 1900, time->tm_mon + 1, time->tm_mday) *
+             DAY_MINUTES +
+         (time->tm_hour * 60) + time->tm_min;
+}
+
+void alarm_schedule_to_tm(uint32_t minute, struct tm *time) {
+  int year, month, day;
+  int32_t days = minute / DAY_MINUTES;
+  date_from_days(days, &year, &month, &day);
+  time->tm_year = year - 1900;
+  time->tm_mon = month - 1;
+  time->tm_mday = day;
+  // 1970-01-01 was a thursday. 0 is sunday
+  time->tm_wday = (days + 4) % 7;
+  time->tm_hour = (minute % DAY_MINUTES) / 60;
+  time->tm_min = minute % 60;
+  time->tm_sec = 0;
+}
+
+// First minute of the day from start that the cron goes off. -1 if none
+static int cron_first_minute(const schedule_cron_t *cron, int start) {
+  uint64_t minutes;
+  for (int hour = start / 60; hour < 24; hour++) {
+    if (!((cron->hours >> hour) & 1)) {
+      continue;
+    }
+    minutes = cron->minutes;
+    if (hour == start / 60) {
+      // Not the minutes before start
+      minutes &= ~((1ULL << (start % 60)) - 1);
+    }
+    if (minutes != 0) {
+      return (hour * 60) + __builtin_ctzll(minutes);
+    }
+  }
+  return -1;
+}
+
+uint32_t alarm_schedule_cron_next(const schedule_cron_t *cron, uint32_t from) {
+  int32_t day = from / DAY_MINUTES;
+  int32_t last_day = day + SCHEDULE_MAX_DAYS;
+  int start = from % DAY_MINUTES;
+  int minute;
+  int year, month, mday;
+  if (schedule_cron_empty(cron)) {
+    return SCHEDULE_NEVER;
+  }
+  while (day < last_day) {
+    date_from_days(day, &year, &month, &mday);
+    if (!((cron->months >> (month - 1)) & 1)) {
+      // Skip to the next month
+      day += days_in_month(year, month) - mday + 1;
+      start = 0;
+      continue;
+    }
+    // 1970-01-01 was a thursday. 0 is sunday
+    if (schedule_cron_day_match(cron, month, mday, (day + 4) % 7)) {
+      minute = cron_first_minute(cron, start);
+      if (minute >= 0) {
+        return (day * DAY_MINUTES) + minute;
+      }
+    }
+    day++;
+    start = 0;
+  }
+  return SCHEDULE_NEVER;
+}
+
+// First minute from (and including) from that the slot goes off.
+static uint32_t slot_next(int slot, uint32_t from) {
+  if ((slot != 0) && clock_settings.alarmsounds[slot].is_alarm) {
+    // Only changes the sound of the alarm. Does not go off by itself
+    return SCHEDULE_NEVER;
+  }
+  return alarm_schedule_cron_next(&clock_settings.cron[slot], from);
+}
+
+// Put an entry on its place in the sorted schedule. Slots going off in
+// the same minute are in slot order. Like the scan.
+static void schedule_insert(uint32_t when, int slot) {
+  int x = schedule_count;
+  if (when == SCHEDULE_NEVER) {
+    return;
+  }
+  while ((x > 0) && ((schedule[x - 1].when > when) ||
+                     ((schedule[x - 1].when == when) && (schedule[x - 1].slot > slot)))) {
+    schedule[x] = schedule[x - 1];
+    x--;
+  }
+  schedule[x].when = when;
+  schedule[x].slot = slot;
+  schedule_count++;
+}
+
+// Copy the first entry. Or none
+static void schedule_publish(bool valid) {
+  schedule_entry_t head = {.when = SCHEDULE_NEVER, .slot = 0};
+  if (valid && (schedule_count > 0)) {
+    head = schedule[0];
+  }
+  portENTER_CRITICAL(&schedule_head_mux);
+  schedule_head = head;
+  portEXIT_CRITICAL(&schedule_head_mux);
+}
+
+static void schedule_rebuild(uint32_t from) {
+  schedule_count = 0;
+  for (int slot = 0; slot < MAX_SOUNDFILES; slot++) {
+    schedule_insert(slot_next(slot, from), slot);
+  }
+  schedule_publish(true);
+  ESP_LOGI(TAG, "Schedule rebuilt. %d slots go off", schedule_count);
+}
+
+// Remove the first entry. And put it back with the next time it goes off
+static void schedule_advance(uint32_t from) {
+  int slot = schedule[0].slot;
+  schedule_count--;
+  memmove(&schedule[0], &schedule[1], schedule_count * sizeof(schedule_entry_t));
+  schedule_insert(slot_next(slot, from), slot);
+  schedule_publish(true);
+}
+
+void alarm_schedule_from_fields(int slot) {
+  const alarmsounds_t *sound = &clock_settings.alarmsounds[slot];
+  schedule_cron_t *cron = &clock_settings.cron[slot];
+  memset(cron, 0, sizeof(schedule_cron_t));
+  if ((sound->hour < 0) || (sound->hour > 23) || (sound->minute < 0) || (sound->minute > 59)) {
+    // Never
+    return;
+  }
+  schedule_cron_daily(cron, sound->hour, sound->minute);
+  if (slot == 0) {
+    // The alarm. Every day
+    return;
+  }
+  if ((sound->weekday == 0) && (sound->month == 0)) {
+    // A sound every day. But not at 00:00 or on a whole hour. It does not
+    // change the alarm sound.
+    if (sound->is_alarm || (sound->hour == 0) || (sound->minute == 0)) {
+      cron->days = 0;
+      cron->weekdays = 0;
+    }
+    return;
+  }
+  if ((sound->weekday >= 1) && (sound->weekday <= 7)) {
+    // weekday 1 is sunday
+    cron->weekdays = 1 << (sound->weekday - 1);
+  }
+  if ((sound->month >= 1) && (sound->month <= 12)) {
+    // Both a weekday and a date only match the weekday in that month
+    cron->months = 1 << (sound->month - 1);
+    cron->days = ((sound->day >= 1) && (sound->day <= 31)) ? 1UL << (sound->day - 1) : 0;
+  }
+}
+
+void alarm_schedule_migrate(void) {
+  if (clock_settings.cron_version == CLOCK_CRON_VERSION) {
+    return;
+  }
+  ESP_LOGI(TAG, "Converting alarm times of version %d", clock_settings.cron_version);
+  for (int slot = 0; slot < MAX_SOUNDFILES; slot++) {
+    alarm_schedule_from_fields(slot);
+  }
+  clock_settings.cron_version = CLOCK_CRON_VERSION;
+  alarm_schedule_changed();
+}
+
+void alarm_schedule_changed(void) {
+  schedule_dirty = true;
+  schedule_publish(false);
+}
+
+uint32_t alarm_schedule_due(const struct tm *now) {
+  uint32_t minute = alarm_schedule_minute(now);
+  uint32_t due = 0;
+  if (minute == schedule_checked) {
+    // Already done this minute
+    return 0;
+  }
+  if (schedule_dirty || (minute < schedule_checked)) {
+    // New settings. Or the time was set back
+    schedule_dirty = false;
+    schedule_rebuild(minute);
+  }
+  schedule_checked = minute;
+  // Mostly the first entry is not due. Then this is all
+  while ((schedule_count > 0) && (schedule[0].when <= minute)) {
+    if (schedule[0].when == minute) {
+      due |= 1UL << schedule[0].slot;
+      schedule_advance(minute + 1);
+    } else {
+      // Missed. Can still go off this minute
+      schedule_advance(minute);
+    }
+  }
+  return due;
+}
+
+void alarm_schedule_refresh(uint32_t from) {
+  if (schedule_dirty) {
+    schedule_dirty = false;
+    schedule_rebuild(from);
+  }
+}
+
+bool alarm_schedule_next(schedule_entry_t *entry) {
+  portENTER_CRITICAL(&schedule_head_mux);
+  *entry = schedule_head;
+  portEXIT_CRITICAL(&schedule_head_mux);
+  // Changed after the copy was made. It is from the old settings
+  return (entry->when != SCHEDULE_NEVER) && !schedule_dirty;
+}
@@ -0,0 +1,68 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef ALARM_SCHEDULE_H_
+#define ALARM_SCHEDULE_H_
+
+// Index of the next time each alarm or sound slot goes off. Kept sorted.
+// The minute tick only looks at the first entry. Only after a change of
+// the settings all slots are worked out again.
+//
+// When a slot goes off is its cron in clock_settings. See schedule_cron.h
+//
+// Times are minutes of local wall clock time. Counted from 1970-01-01
+// 00:00 local. Like the old scan it compares hour and minute of the
+// local time. A time skipped by daylight saving does not go off. When
+// the clock is set back the index is rebuilt. So a time that happens
+// twice goes off twice.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "schedule_cron.h"
+
+#define SCHEDULE_NEVER UINT32_MAX
+
+typedef struct {
+  uint32_t when;  // local minute the slot goes off next
+  int slot;       // entry in clock_settings.alarmsounds
+} schedule_entry_t;
+
+// Set the cron of a slot from the old fields hour, minute, weekday, month
+// and day. The same times as before there was a cron. Except a weekday
+// and a date together. That only matches the weekday in the month.
+void alarm_schedule_from_fields(int slot);
+
+// Convert settings stored before there was a cron. Nothing when converted.
+void alarm_schedule_migrate(void);
+
+// The alarm sounds in clock_settings changed. The index is rebuilt on
+// the next check.
+void alarm_schedule_changed(void);
+
+// Slots going off in the minute of now. As a bit per slot. Each minute
+// only once. Slots missed because the time jumped ahead are skipped.
+uint32_t alarm_schedule_due(const struct tm *now);
+
+// Rebuild the index after a change of the settings. Without waiting for
+// the next check. From is the first minute not checked yet.
+void alarm_schedule_refresh(uint32_t from);
+
+// The first slot to go off. False when there is none. Or the settings
+// changed and the index is not rebuilt yet. Can be called from any task.
+bool alarm_schedule_next(schedule_entry_t *entry);
+
+// First local minute from (and including) from that a cron goes off.
+// SCHEDULE_NEVER when not in the next 8 years.
+uint32_t alarm_schedule_cron_next(const schedule_cron_t *cron, uint32_t from);
+
+// Local minute of a broken down time. And back. Back only fills in
+// year, month, day, weekday, hour and minute.
+uint32_t alarm_schedule_minute(const struct tm *time);
+void alarm_schedule_to_tm(uint32_t minute, struct tm *time);
+
+#endif
@@ -21,3 +21,16 @@ QueueHandle_t display_task_queue(void) {
   }
   return queue_p;
 }
+
+// Names in the order of disp_task_signal_t
+static const char *const signal_names[DISP_TASK_SIGNALS] = {
+    "noop",          "encoder_up",    "encoder_down", "encoder_press", "encoder_press_released",
+    "minute_passed", "timer_expired", "scroll_frame", "anim_frame",
+    "alarm_due"};
+
+const char *disp_task_signal_name(disp_task_signal_t signal) {
+  if (((int)signal < 0) || (signal >= DISP_TASK_SIGNALS)) {
+    return "unknown";
+  }
+  return signal_names[signal];
+}
@@ -8,6 +8,8 @@
 #define APP_QUEUE_H_
 // Define the queues used inside the application
 
+#include <stdint.h>
+
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
@@ -25,14 +27,28 @@ typedef enum {
   encoder_press_released,
   minute_passed,
   timer_expired,
+  scroll_frame,
+  anim_frame,
+  alarm_due,
 } disp_task_signal_t;
+// amount of signals above
+#define DISP_TASK_SIGNALS (alarm_due + 1)
 
-// struct is problably overkill.
+// The producer fills in the time it sent the event. The display task
+// uses it for the time from sending to handling.
 typedef struct {
   disp_task_signal_t disp_task_signal;
+  int64_t time;  // esp_timer_get_time() of the producer
+  union {
+    int delta;          // encoder_up/encoder_down: steps. Negative is down
+    uint32_t press_ms;  // encoder_press_released: time the button was held
+  } payload;
 } disp_task_queue_item_t;
 
 // returns the handle for this queue and start it when not already started
 QueueHandle_t display_task_queue(void);
 
+// Name of a signal. For logging and the metrics.
+const char *disp_task_signal_name(disp_task_signal_t signal);
+
 #endif
@@ -8,15 +8,19 @@
 
 // Own header files
 #include "defaults_globals.h"
+#include "display_anim.h"
 #include "display_clock.h"
+#include "display_scroll.h"
 #include "eventhandler.h"
 #include "filesystem.h"
 #include "networkstartstop.h"
 #include "nvramfunctions.h"
+#include "schedule_store.h"
 #include "sound.h"
 #include "time_task.h"
 #include "i2c_functions.h"
 #include "ds3231.h"
+#include "max7219.h"
 
 //Set logging tag per module
 static const char* TAG =  DEFAULT_ESPNAME ;
@@ -67,6 +71,12 @@ setupparams_t setupparams = {
 
 void app_main(void) {
     float temp_ds3231;
+    max7219_flush_stats_t flush_stats;
+    display_scroll_stats_t scroll_stats;
+    display_anim_stats_t anim_stats;
+#ifdef MAX7219_GRAYSCALE
+    max7219_gray_stats_t gray_stats;
+#endif
 
   ESP_LOGI(TAG, "Start of program");
   //we need 64bit time_t to function after 2038. 
@@ -82,6 +92,8 @@ void app_main(void) {
   //
   // Starting filesystem
   spiffs_start();
+  // Sounds table in a file. Needs the filesystem
+  schedule_store_start();
   // Init the I2C port
   i2c_init_port();
   // Starting network and network apps when network is available.
@@ -107,6 +119,37 @@ void app_main(void) {
     ESP_LOGI(TAG, "Esp free heap size: %d. Minimal free %d", esp_get_free_heap_size(),
              esp_get_minimum_free_heap_size());
     ESP_LOGI(TAG, "Last SNTP sync is %d minutes ago.", last_sntp_sync_min());
+    // Display flush timing. Time to display and time the display task was blocked
+    max7219_get_flush_stats(&flush_stats);
+    ESP_LOGI(TAG, "Display flushes %d. Flush %d us (avg %d, max %d). Blocked %d us (max %d)",
+             flush_stats.flush_count, flush_stats.flush_us_last, flush_stats.flush_us_avg,
+             flush_stats.flush_us_max, flush_stats.call_us_last, flush_stats.call_us_max);
+    ESP_LOGI(TAG, "Display rows sent %d. Rows skipped (unchanged) %d. Frames dropped %d",
+             flush_stats.rows_sent, flush_stats.rows_skipped, flush_stats.frames_dropped);
+    // Encoder event until the answer is on the display
+    ESP_LOGI(TAG, "Encoder to display %d us (avg %d, max %d) over %d events",
+             flush_stats.latency_us_last, flush_stats.latency_us_avg, flush_stats.latency_us_max,
+             flush_stats.latency_count);
+    ESP_LOGI(TAG, "Display register writes %d. Last batch %d us (max %d)",
+             flush_stats.commands, flush_stats.command_us_last, flush_stats.command_us_max);
+    // Smooth scroller frame timing
+    display_scroll_get_stats(&scroll_stats);
+    ESP_LOGI(TAG, "Scrolls %d. Frames %d. Dropped %d. Frame %d us (avg %d, max %d)",
+             scroll_stats.scrolls, scroll_stats.frames, scroll_stats.frames_dropped,
+             scroll_stats.frame_us_last, scroll_stats.frame_us_avg, scroll_stats.frame_us_max);
+    // Digit animation frame timing
+    display_anim_get_stats(&anim_stats);
+    ESP_LOGI(TAG, "Animations %d. Frames %d. Dropped %d. Over budget %d. Frame %d us (avg %d, max %d)",
+             anim_stats.animations, anim_stats.frames, anim_stats.frames_dropped,
+             anim_stats.over_budget, anim_stats.frame_us_last, anim_stats.frame_us_avg,
+             anim_stats.frame_us_max);
+#ifdef MAX7219_GRAYSCALE
+    // Grayscale plane refresh. Cycles per second is 1000000 / cycle us
+    max7219_get_gray_stats(&gray_stats);
+    ESP_LOGI(TAG, "Gray cycles %d. Cycle %d us (max %d). Planes %d. Late %d",
+             gray_stats.cycles, gray_stats.cycle_us_last, gray_stats.cycle_us_max,
+             gray_stats.planes_sent, gray_stats.planes_late);
+#endif
     //Lots of CPU time available here
 
     //Just testing
@@ -0,0 +1,207 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Digit transition animations. See display_anim.h
+#include <string.h>
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Own files to include
+#include "app_queue.h"
+#include "display_anim.h"
+#include "max7219.h"
+
+// Set logging tag per module
+static const char *TAG = "DisplayAnim";
+
+// Rendered old and new character of a changed digit
+typedef struct {
+  int position;
+  int length;  // columns. The widest of both characters
+  u_int8_t old_columns[ANIM_DIGIT_COLUMNS];
+  u_int8_t new_columns[ANIM_DIGIT_COLUMNS];
+} anim_digit_t;
+
+static anim_digit_t anim_digits[ANIM_MAX_DIGITS];
+static int anim_count = 0;
+static display_anim_effect_t anim_effect = ANIM_EFFECT;
+static int64_t anim_start_us = 0;
+static bool anim_running = false;
+static esp_timer_handle_t anim_timer = NULL;
+// Set by the timer. Cleared when the display task draws the frame
+static volatile bool frame_pending = false;
+// Ticks to drop after a frame over budget. Gives the display task air.
+static volatile int frames_to_skip = 0;
+static display_anim_stats_t anim_stats;
+
+// Runs in the esp_timer task. Only one frame signal is in the queue at a
+// time. Ticks while the display task did not draw the last frame are dropped.
+static void display_anim_tick(void *arg) {
+  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = anim_frame,
+                                                 .time = esp_timer_get_time()};
+  if (frame_pending || (frames_to_skip > 0)) {
+    if (frames_to_skip > 0) {
+      frames_to_skip--;
+    }
+    anim_stats.frames_dropped++;
+    return;
+  }
+  frame_pending = true;
+  if (xQueueSendToBack(display_task_queue(), &signal_to_send, 0) != pdTRUE) {
+    frame_pending = false;
+    anim_stats.frames_dropped++;
+  }
+}
+
+// Render 1 character into the columns of a digit. Returns the width.
+static int display_anim_render(char character, u_int8_t *columns) {
+  char text[2] = {character, 0};
+  memset(columns, 0, ANIM_DIGIT_COLUMNS);
+  return max7219_render_columns(text, columns, ANIM_DIGIT_COLUMNS);
+}
+
+esp_err_t display_anim_start(const display_anim_digit_t *digits, int count,
+                             display_anim_effect_t effect) {
+  int x;
+  anim_digit_t *digit;
+  display_anim_stop();
+  anim_count = 0;
+  for (x = 0; (x < count) && (anim_count < ANIM_MAX_DIGITS); x++) {
+    // Only changed digits are animated
+    if (digits[x].old_char == digits[x].new_char) {
+      continue;
+    }
+    digit = &anim_digits[anim_count++];
+    digit->position = digits[x].position;
+    digit->length = MAX(display_anim_render(digits[x].old_char, digit->old_columns),
+                        display_anim_render(digits[x].new_char, digit->new_columns));
+  }
+  if (anim_count == 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (anim_timer == NULL) {
+    const esp_timer_create_args_t timer_args = {.callback = &display_anim_tick,
+                                                .name = "anim"};
+    if (esp_timer_create(&timer_args, &anim_timer) != ESP_OK) {
+      ESP_LOGE(TAG, "Error in creating animation timer");
+      anim_count = 0;
+      return ESP_FAIL;
+    }
+  }
+  anim_effect = effect;
+  frame_pending = false;
+  frames_to_skip = 0;
+  anim_running = true;
+  anim_start_us = esp_timer_get_time();
+  anim_stats.animations++;
+  ESP_LOGD(TAG, "Animating %d digits with effect %d", anim_count, effect);
+  return esp_timer_start_periodic(anim_timer, ANIM_FRAME_US);
+}
+
+// Mix the old and new columns of a digit for a step between 0 (old) and
+// ANIM_FRAMES (new).
+static void display_anim_mix(const anim_digit_t *digit, int step, u_int8_t *columns) {
+  int x;
+  int y;
+  int shift;
+  int rank;
+  for (x = 0; x < digit->length; x++) {
+    switch (anim_effect) {
+      case anim_rollup:
+        // Bit 0 is the top row. Shifting right moves the dots up.
+        shift = (step * 8) / ANIM_FRAMES;
+        columns[x] = (u_int8_t)((digit->old_columns[x] >> shift) |
+                                (digit->new_columns[x] << (8 - shift)));
+        break;
+      case anim_wipe:
+        if (x < (step * digit->length) / ANIM_FRAMES) {
+          columns[x] = digit->new_columns[x];
+        } else {
+          columns[x] = digit->old_columns[x];
+        }
+        break;
+      case anim_dissolve:
+        // 37 has no factor in common with 64. So each of the 64 dots of
+        // an 8x8 block gets its own rank.
+        columns[x] = 0;
+        for (y = 0; y < 8; y++) {
+          rank = (((x * 8) + y) * 37 + 11) & 63;
+          if (rank < (step * 64) / ANIM_FRAMES) {
+            columns[x] |= digit->new_columns[x] & (1 << y);
+          } else {
+            columns[x] |= digit->old_columns[x] & (1 << y);
+          }
+        }
+        break;
+      default:
+        columns[x] = digit->new_columns[x];
+        break;
+    }
+  }
+}
+
+bool display_anim_frame(void) {
+  int64_t frame_start = esp_timer_get_time();
+  uint32_t frame_us;
+  u_int8_t columns[ANIM_DIGIT_COLUMNS];
+  int step;
+  int x;
+  frame_pending = false;
+  if (!anim_running) {
+    return false;
+  }
+  // Steps since the start. Follows the clock.
+  step = (int)((frame_start - anim_start_us) / ANIM_FRAME_US);
+  if (step >= ANIM_FRAMES) {
+    display_anim_stop();
+    return false;
+  }
+  for (x = 0; x < anim_count; x++) {
+    display_anim_mix(&anim_digits[x], step, columns);
+    max7219_sprite_fill_columns(columns, anim_digits[x].position, anim_digits[x].length);
+  }
+  max7219_send_display();
+
+  frame_us = (uint32_t)(esp_timer_get_time() - frame_start);
+  if (frame_us > ANIM_FRAME_BUDGET_US) {
+    // Too slow. Skip a frame instead of filling the queue
+    anim_stats.over_budget++;
+    frames_to_skip = 1;
+  }
+  anim_stats.frames++;
+  anim_stats.frame_us_last = frame_us;
+  if (frame_us > anim_stats.frame_us_max) {
+    anim_stats.frame_us_max = frame_us;
+  }
+  if (anim_stats.frame_us_avg == 0) {
+    anim_stats.frame_us_avg = frame_us;
+  } else {
+    anim_stats.frame_us_avg = ((anim_stats.frame_us_avg * 7) + frame_us) / 8;
+  }
+  return true;
+}
+
+void display_anim_stop(void) {
+  if (anim_timer != NULL) {
+    esp_timer_stop(anim_timer);
+  }
+  anim_running = false;
+}
+
+bool display_anim_active(void) {
+  return anim_running;
+}
+
+void display_anim_get_stats(display_anim_stats_t *stats) {
+  *stats = anim_stats;
+}
@@ -0,0 +1,74 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef DISPLAY_ANIM_H_
+#define DISPLAY_ANIM_H_
+
+// Transition animations for changing digits. Each digit is rendered once
+// into a strip for the old and the new character. An esp_timer asks the
+// display task for a new frame. Each frame mixes the old and new strip
+// of the changed digits only. The step follows the time, not the amount
+// of frames. Late or dropped frames skip steps. The animation always
+// ends on time and never blocks the display task queue.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#define ANIM_FRAMES 8             // steps from the old to the new digit
+#define ANIM_FRAME_US 40000       // time between frames. 8 frames is 320ms
+#define ANIM_FRAME_BUDGET_US 3000 // CPU time a frame may use
+#define ANIM_MAX_DIGITS 8         // digits animated at the same time
+#define ANIM_DIGIT_COLUMNS 8      // widest digit
+#define ANIM_EFFECT anim_rollup   // effect used for the clock
+
+// The transition effects
+typedef enum {
+  anim_rollup,    // old digit moves up. New one comes from below
+  anim_wipe,      // new digit is wiped in from left to right
+  anim_dissolve,  // dots change one by one in a fixed random order
+} display_anim_effect_t;
+
+// One digit. Characters are from the font. Digits with the same old and
+// new character are left alone.
+typedef struct {
+  int position;          // first column on the display
+  char old_char;
+  char new_char;
+} display_anim_digit_t;
+
+// Frame timing of the animations. Times in microseconds.
+typedef struct {
+  uint32_t animations;      // transitions started
+  uint32_t frames;          // frames drawn
+  uint32_t frames_dropped;  // timer ticks without a frame. Busy or over budget
+  uint32_t over_budget;     // frames which used more than ANIM_FRAME_BUDGET_US
+  uint32_t frame_us_last;   // CPU time to draw and send a frame
+  uint32_t frame_us_max;
+  uint32_t frame_us_avg;    // running average over the last frames
+} display_anim_stats_t;
+
+// Start the transition of the changed digits. The display buffer must
+// hold the old frame. Returns ESP_ERR_NOT_FOUND when no digit changed.
+esp_err_t display_anim_start(const display_anim_digit_t *digits, int count,
+                             display_anim_effect_t effect);
+
+// Draw the frame for the current time and send it to the display. Called
+// by the display task on the anim_frame signal. Returns false when the
+// animation is finished. The final frame is then drawn by the caller.
+bool display_anim_frame(void);
+
+// Stop the animation
+void display_anim_stop(void);
+
+// True while an animation runs
+bool display_anim_active(void);
+
+// Copy of the animation timing counters
+void display_anim_get_stats(display_anim_stats_t *stats);
+
+#endif
@@ -0,0 +1,160 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Display brightness following the daylight. See display_brightness.h
+#include <math.h>
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+
+// Own files to include
+#include "display_brightness.h"
+#include "display_functions.h"
+#include "max7219.h"
+#include "time_task.h"
+
+// Set logging tag per module
+static const char *TAG = "Brightness";
+
+#ifndef BRIGHT_SUN_CALC
+// Average sun up and down hours for each month. Without daylight saving.
+// Needs adapting to your location. This is in The Netherlands
+static const brightness_sun_t sun_updown_month[12] = {
+    {9 * 60, 17 * 60},  // januari is 0 in tm struct
+    {8 * 60, 18 * 60}, {7 * 60, 18 * 60}, {6 * 60, 19 * 60}, {6 * 60, 20 * 60},
+    {5 * 60, 21 * 60}, {5 * 60, 21 * 60}, {6 * 60, 20 * 60}, {6 * 60, 19 * 60},
+    {7 * 60, 18 * 60}, {8 * 60, 17 * 60}, {9 * 60, 17 * 60}};
+#endif
+
+static TimerHandle_t ramp_timer = NULL;
+// Brightness on the display. Only changed by the timer after the start
+static int ramp_current = 0;
+static uint32_t ramp_steps = 0;
+
+void brightness_sun(int yday, brightness_sun_t *sun) {
+#ifdef BRIGHT_SUN_CALC
+  // NOAA approximation. Good to a few minutes
+  const float deg = (float)M_PI / 180.0f;
+  float gamma = 2.0f * (float)M_PI * yday / 365.0f;
+  float decl = 0.006918f - 0.399912f * cosf(gamma) + 0.070257f * sinf(gamma) -
+               0.006758f * cosf(2 * gamma) + 0.000907f * sinf(2 * gamma) -
+               0.002697f * cosf(3 * gamma) + 0.00148f * sinf(3 * gamma);
+  float eqtime = 229.18f * (0.000075f + 0.001868f * cosf(gamma) - 0.032077f * sinf(gamma) -
+                            0.014615f * cosf(2 * gamma) - 0.040849f * sinf(2 * gamma));
+  float cos_ha = (cosf(90.833f * deg) / (cosf(BRIGHT_LATITUDE * deg) * cosf(decl))) -
+                 (tanf(BRIGHT_LATITUDE * deg) * tanf(decl));
+  // No sun up or down near the poles
+  float ha = acosf(MAX(-1.0f, MIN(1.0f, cos_ha))) / deg;
+  sun->sun_up = (int)(720.0f - 4.0f * (BRIGHT_LONGITUDE + ha) - eqtime) + BRIGHT_UTC_OFFSET;
+  sun->sun_down = (int)(720.0f - 4.0f * (BRIGHT_LONGITUDE - ha) - eqtime) + BRIGHT_UTC_OFFSET;
+#else
+  // Table times are for the middle of the month. Interpolate between them
+  // so the times change a little each day.
+  int month;
+  int next;
+  int part;
+  int day = yday - 15;
+  if (day < 0) {
+    day += 365;
+  }
+  month = (day * 12) / 365;
+  next = (month + 1) % 12;
+  // Part of the way to the next month. 0 - 365
+  part = (day * 12) % 365;
+  sun->sun_up = sun_updown_month[month].sun_up +
+                ((sun_updown_month[next].sun_up - sun_updown_month[month].sun_up) * part) / 365;
+  sun->sun_down =
+      sun_updown_month[month].sun_down +
+      ((sun_updown_month[next].sun_down - sun_updown_month[month].sun_down) * part) / 365;
+#endif
+}
+
+int brightness_target(int yday, int minute) {
+  brightness_sun_t sun;
+  int day_level = clock_settings.brightness;
+  int night_level;
+  int bright_adjust = clock_settings.brightness / 3;
+  int daylight;
+  int morning;
+  int evening;
+  if (bright_adjust < 1) {
+    bright_adjust = 1;
+  }
+  // Same depth as before. 2 adjustments down during the night
+  night_level = MAX(0, day_level - (2 * bright_adjust));
+  brightness_sun(yday, &sun);
+  // Daylight 0 - 256. Twilight is centered on sun up and sun down
+  morning = ((minute - sun.sun_up) * 256) / BRIGHT_TWILIGHT_MIN + 128;
+  evening = ((sun.sun_down - minute) * 256) / BRIGHT_TWILIGHT_MIN + 128;
+  daylight = MAX(0, MIN(256, MIN(morning, evening)));
+  return night_level + (((day_level - night_level) * daylight) + 128) / 256;
+}
+
+int brightness_curve(int yday, int step_minutes, int *levels, int max_levels) {
+  int count = 0;
+  int minute;
+  if (step_minutes <= 0) {
+    return 0;
+  }
+  for (minute = 0; (minute < 24 * 60) && (count < max_levels); minute += step_minutes) {
+    levels[count++] = brightness_target(yday, minute);
+  }
+  return count;
+}
+
+// Runs in the timer task. Not on the minute tick of the display task.
+// Moves the brightness 1 step to the target for the current time. Must not
+// wait for the SPI bus. That would hold up the menu and button timers.
+static void brightness_ramp_step(TimerHandle_t timer) {
+  int minute;
+  int target;
+  // Curve is in standard time
+  minute = (current_timeinfo.tm_hour * 60) + current_timeinfo.tm_min;
+  if (current_timeinfo.tm_isdst > 0) {
+    minute -= 60;
+    if (minute < 0) {
+      minute += 24 * 60;
+    }
+  }
+  target = MIN(MAXBRIGHT, brightness_target(current_timeinfo.tm_yday, minute));
+  if (target == ramp_current) {
+    return;
+  }
+  if (target > ramp_current) {
+    ramp_current++;
+  } else {
+    ramp_current--;
+  }
+  ramp_steps++;
+  ESP_LOGD(TAG, "Brightness %d. Target %d", ramp_current, target);
+  // 1 register write for all chips. Done by the flush task
+  max7219_post_brightness(ramp_current);
+}
+
+void brightness_ramp_start(int brightness) {
+  ramp_current = brightness;
+  max7219_set_brightness(ramp_current);
+  if (ramp_timer == NULL) {
+    ramp_timer = xTimerCreate("BrightRamp", BRIGHT_STEP_MS / portTICK_PERIOD_MS, pdTRUE, 0,
+                              brightness_ramp_step);
+    if ((ramp_timer == NULL) || (xTimerStart(ramp_timer, 5) != pdPASS)) {
+      ESP_LOGE(TAG, "Could not start the brightness ramp timer");
+    }
+  }
+}
+
+int brightness_ramp_current(void) {
+  return ramp_current;
+}
+
+uint32_t brightness_ramp_steps(void) {
+  return ramp_steps;
+}
@@ -0,0 +1,58 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef DISPLAY_BRIGHTNESS_H_
+#define DISPLAY_BRIGHTNESS_H_
+
+// Display brightness following the daylight. The target brightness is a
+// continuous curve over the day. The brightness setting during the day.
+// Lower during the night. In between it follows the twilight around sun
+// up and sun down. A timer moves the max7219 brightness 1 step at a time
+// to the target. So there are no visible jumps.
+
+#include <stdint.h>
+#include <time.h>
+
+#define BRIGHT_STEP_MS 250       // timer period. At most 1 step each period
+#define BRIGHT_TWILIGHT_MIN 120  // minutes to go from day to night level
+//
+//Sun up and down are taken from a table with the average times of each
+//month in The Netherlands. Interpolated between the months. Define below
+//to calculate them for the location instead.
+//#define BRIGHT_SUN_CALC
+#define BRIGHT_LATITUDE 52.1   // degrees north
+#define BRIGHT_LONGITUDE 5.1   // degrees east
+#define BRIGHT_UTC_OFFSET 60   // minutes. Standard time without daylight saving
+
+#define BRIGHT_CURVE_MAX_POINTS 288  // curve for a day in steps of 5 minutes
+
+// Sun up and down in minutes after midnight. Standard time.
+typedef struct {
+  int sun_up;
+  int sun_down;
+} brightness_sun_t;
+
+// Set the brightness and start ramping from there
+void brightness_ramp_start(int brightness);
+
+// Brightness the display has now
+int brightness_ramp_current(void);
+
+// Steps taken by the ramp since the start
+uint32_t brightness_ramp_steps(void);
+
+// Sun up and down for a day of the year (0 - 365)
+void brightness_sun(int yday, brightness_sun_t *sun);
+
+// Target brightness for a day of the year and minute of the day in
+// standard time. Uses the brightness setting.
+int brightness_target(int yday, int minute);
+
+// Fill levels with the target brightness over a day. One level each
+// step_minutes from midnight. Returns the amount of levels.
+int brightness_curve(int yday, int step_minutes, int *levels, int max_levels);
+
+#endif
@@ -6,20 +6,26 @@
 
 // Display and encoder
 //
+#include <stdbool.h>
 #include <sys/types.h>
 
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "sdkconfig.h"
 #include "string.h"
 
 // Own files to include
+#include "alarm_schedule.h"
 #include "app_queue.h"
 #include "defaults_globals.h"
+#include "display_anim.h"
+#include "display_brightness.h"
 #include "display_clock.h"
 #include "display_functions.h"
+#include "display_scroll.h"
 #include "max7219.h"
 #include "networkstartstop.h"
 #include "nvramfunctions.h"
@@ -41,8 +47,15 @@ enum display_state_t {
   sleeptime,
   brightness,
   openwifiap,
-  openwifiappressed
+  openwifiappressed,
+  infoscroll
 } display_state;
+// amount of states above
+#define DISPLAY_SCREENS (infoscroll + 1)
+
+static display_screen_stats_t screen_stats[DISPLAY_SCREENS];
+static display_event_stats_t event_stats;
+static display_latency_stats_t latency_stats[DISP_TASK_SIGNALS];
 
 //Clock_sttings holds all the clock settings(not networking) and is stored
 //in NVRAM after not being changed for a while. 
@@ -60,6 +73,437 @@ clock_settings_t clock_settings = {
                        .is_alarm = 1,
                        .soundfile = "bird1"}};
 
+//Display_settings describes the chain of max7219s. Stored in NVRAM with
+//the JSON API. Only read during startup because buffers are allocated then.
+max7219_config_t display_settings = {
+    // default values from max7219.h
+    .count = MAX7219_COUNT,
+#ifdef MAX7219_ROTATE90
+    .rotate90 = true,
+#else
+    .rotate90 = false,
+#endif
+    .reverse = false,
+    .font = ""};
+
+// Keep the time it took to draw a screen
+static void display_clock_screen_time(int state, uint32_t draw_us) {
+  display_screen_stats_t* stats;
+  if ((state < 0) || (state >= DISPLAY_SCREENS)) {
+    return;
+  }
+  stats = &screen_stats[state];
+  stats->draws++;
+  stats->us_last = draw_us;
+  if (draw_us > stats->us_max) {
+    stats->us_max = draw_us;
+  }
+  if (stats->us_avg == 0) {
+    stats->us_avg = draw_us;
+  } else {
+    stats->us_avg = ((stats->us_avg * 7) + draw_us) / 8;
+  }
+}
+
+// Keep the time from sending to handling of an event
+static void display_clock_latency(const disp_task_queue_item_t* item, int64_t now) {
+  display_latency_stats_t* stats;
+  uint32_t latency_us;
+  int bucket = 0;
+  if (((int)item->disp_task_signal < 0) || (item->disp_task_signal >= DISP_TASK_SIGNALS)) {
+    return;
+  }
+  // Producers which did not fill in a time count as zero
+  latency_us = ((item->time > 0) && (now > item->time)) ? (uint32_t)(now - item->time) : 0;
+  while ((bucket < DISPLAY_LATENCY_BUCKETS - 1) &&
+         (latency_us >= DISPLAY_LATENCY_BUCKET_US(bucket))) {
+    bucket++;
+  }
+  stats = &latency_stats[item->disp_task_signal];
+  stats->count++;
+  stats->us_last = latency_us;
+  if (latency_us > stats->us_max) {
+    stats->us_max = latency_us;
+  }
+  stats->buckets[bucket]++;
+}
+
+int display_clock_get_latency_stats(display_latency_stats_t* stats, int max_signals) {
+  int signal;
+  for (signal = 0; (signal < DISP_TASK_SIGNALS) && (signal < max_signals); signal++) {
+    stats[signal] = latency_stats[signal];
+    stats[signal].name = disp_task_signal_name(signal);
+  }
+  return signal;
+}
+
+// Take all encoder turns waiting in the queue behind the first one and
+// add their steps to it. Stops at the first other event. That one stays
+// in the queue. The first item keeps its time. It waited longest.
+static void display_clock_coalesce(QueueHandle_t queue, disp_task_queue_item_t* first,
+                                   int64_t now) {
+  disp_task_queue_item_t next_item;
+  uint32_t batch = 1;
+  // Only this task takes items from the queue. A peeked item stays the next.
+  while (xQueuePeek(queue, &next_item, 0) == pdTRUE) {
+    if ((next_item.disp_task_signal != encoder_up) &&
+        (next_item.disp_task_signal != encoder_down)) {
+      break;
+    }
+    xQueueReceive(queue, &next_item, 0);
+    display_clock_latency(&next_item, now);
+    first->payload.delta += next_item.payload.delta;
+    batch++;
+  }
+  event_stats.events += batch - 1;
+  event_stats.batches++;
+  event_stats.merged += batch - 1;
+  if (batch > event_stats.max_batch) {
+    event_stats.max_batch = batch;
+  }
+  // The merged signal follows the direction of the sum
+  if (first->payload.delta > 0) {
+    first->disp_task_signal = encoder_up;
+  } else if (first->payload.delta < 0) {
+    first->disp_task_signal = encoder_down;
+  } else {
+    first->disp_task_signal = noop;
+  }
+}
+
+void display_clock_get_event_stats(display_event_stats_t* stats) {
+  *stats = event_stats;
+}
+
+// Recent transitions. For debugging the menu.
+typedef struct {
+  int64_t time;
+  u_int8_t signal;
+  u_int8_t from;
+  u_int8_t to;
+} display_trace_entry_t;
+static display_trace_entry_t trace[DISPLAY_TRACE_LENGTH];
+static uint32_t trace_count = 0;
+
+static void display_clock_trace(disp_task_signal_t signal, enum display_state_t from,
+                                enum display_state_t to) {
+  display_trace_entry_t* entry = &trace[trace_count % DISPLAY_TRACE_LENGTH];
+  entry->time = esp_timer_get_time();
+  entry->signal = signal;
+  entry->from = from;
+  entry->to = to;
+  trace_count++;
+}
+
+// Actions of the transitions below. They run before the state changes.
+// Returning false does not take the transition. The transition for all
+// states is tried next.
+static bool action_alarm_onoff(const disp_task_queue_item_t* item) {
+  ESP_LOGI(TAG, "Toggle alarm on/off");
+  alarm_onoff();
+  return true;
+}
+
+static bool action_alarm_sleep(const disp_task_queue_item_t* item) {
+  // switch off alarm sound immediatly
+  stop_alarm();
+  // add sleep immediatly. This disables rearming in in same minute
+  alarm_add_sleep();
+  return true;
+}
+
+static bool action_alarm_adjust(const disp_task_queue_item_t* item) {
+  alarm_set_time(item->payload.delta);
+  return true;
+}
+
+static bool action_sleep_adjust(const disp_task_queue_item_t* item) {
+  sleep_set_time(item->payload.delta);
+  return true;
+}
+
+static bool action_brightness_adjust(const disp_task_queue_item_t* item) {
+  brightness_set(item->payload.delta);
+  return true;
+}
+
+static bool action_info_scroll(const disp_task_queue_item_t* item) {
+  // Turning on the clock display shows network and alarm info
+  info_scroll_start();
+  return true;
+}
+
+static bool action_alarm_timeout(const disp_task_queue_item_t* item) {
+  // should only happen when alarm sounds more than 1 hour
+  stop_alarm();
+  alarm_off();
+  return true;
+}
+
+static bool action_alarm_long_press(const disp_task_queue_item_t* item) {
+  // alarm went off. And we pressed switch. Lets look if long enough
+  if (rotary_encoder_get_button() != 0) {
+    // we only sleep
+    return false;
+  }
+  // we still press the switch. Disable alarm and show it
+  alarm_off();
+  return true;
+}
+
+static bool action_wifi_long_press(const disp_task_queue_item_t* item) {
+  // We are on the WIFI open AP display. Lets look if long enough
+  // to open the wifi
+  if (rotary_encoder_get_button() == 0) {
+    // we still press the switch.
+    ESP_LOGI(TAG, "Long keypress. Open AP");
+    open_wifi_ap();
+  }
+  return true;
+}
+
+static bool action_minute(const disp_task_queue_item_t* item) {
+  bool alarm;
+  ESP_LOGI(TAG, "30 or 60 seconds passed. The time %d:%d:%d", current_timeinfo.tm_hour,
+           current_timeinfo.tm_min, current_timeinfo.tm_sec);
+  // Check for alarm or a timed sound and play this. Mostly the alarm
+  // timer did this already at the start of the minute.
+  alarm = check_for_alarm(&current_timeinfo);
+  // Settings or the schedule may have changed
+  alarm_timer_arm();
+  // check if we need to store new settings
+  clock_store_nvram(-1);
+  // alarm found for this minute and hour. Optional specific for this day
+  return alarm;
+}
+
+static bool action_alarm_due(const disp_task_queue_item_t* item) {
+  // alarm found for this second. Or the timer is set again
+  return alarm_timer_expired();
+}
+
+// Screens drawn after the event is handled. Per display state.
+static void draw_time(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  time_sendto_display();
+}
+
+static void draw_clock(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  if (item->disp_task_signal == anim_frame) {
+    // Next frame of the changing digits. Full time when finished
+    if (!display_anim_frame()) {
+      time_sendto_display();
+    }
+  } else if ((item->disp_task_signal == minute_passed) && (previous == clockdisplay)) {
+    ESP_LOGI(TAG, "Clock display");
+    time_animate_to_display();
+  } else {
+    ESP_LOGI(TAG, "Clock display");
+    time_sendto_display();
+  }
+}
+
+static void draw_alarm(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  // short display. If we press fast enough go to other settings
+  // else go to setting the the alarm
+  max7219_fill_display_buffer("Alarm", MAX7219_ALIGN_MIDDLE);
+  max7219_send_display();
+}
+
+static void draw_alarm_set(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  // Display alarm time. And if alarm is armed
+  alarm_sendto_display();
+}
+
+static void draw_sleep(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  sleep_sendto_display();
+}
+
+static void draw_brightness(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  brightness_sendto_display();
+}
+
+static void draw_alarm_off(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  // short display to display alarm is off
+  max7219_fill_display_buffer("Off", MAX7219_ALIGN_MIDDLE);
+  max7219_send_display();
+}
+
+static void draw_wifi(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  max7219_fill_display_buffer("Wifi AP", MAX7219_ALIGN_LEFT);
+  max7219_send_display();
+}
+
+static void draw_info_scroll(const disp_task_queue_item_t* item, enum display_state_t previous) {
+  // Next frame of the scrolling text. Back to clock when finished
+  if (!display_scroll_frame()) {
+    display_clock_trace(item->disp_task_signal, display_state, clockdisplay);
+    display_state = clockdisplay;
+    time_sendto_display();
+  }
+}
+
+// Per display state its name and how it is drawn. No draw keeps the
+// display as it is.
+typedef struct {
+  const char* name;
+  void (*draw)(const disp_task_queue_item_t* item, enum display_state_t previous);
+} display_screen_t;
+
+static const display_screen_t display_screens[DISPLAY_SCREENS] = {
+    [clockdisplay] = {"clockdisplay", draw_clock},
+    [alarmdisplay] = {"alarmdisplay", draw_alarm},
+    [alarmset] = {"alarmset", draw_alarm_set},
+    [alarmgoing] = {"alarmgoing", draw_time},
+    [alarmgoingpressed] = {"alarmgoingpressed", draw_time},
+    [alarmgoingoff] = {"alarmgoingoff", draw_alarm_off},
+    [sleeptime] = {"sleeptime", draw_sleep},
+    [brightness] = {"brightness", draw_brightness},
+    [openwifiap] = {"openwifiap", draw_wifi},
+    [openwifiappressed] = {"openwifiappressed", NULL},
+    [infoscroll] = {"infoscroll", draw_info_scroll}};
+
+int display_clock_get_screen_stats(display_screen_stats_t* stats, int max_screens) {
+  int state;
+  for (state = 0; (state < DISPLAY_SCREENS) && (state < max_screens); state++) {
+    stats[state] = screen_stats[state];
+    stats[state].name = display_screens[state].name;
+  }
+  return state;
+}
+
+// What an event does in a display state. The action runs first. Then
+// the state changes to next. A timeout starts the menu timer. It sends
+// timer_expired when it runs out. Empty entries do nothing.
+typedef struct {
+  bool used;
+  bool (*action)(const disp_task_queue_item_t* item);
+  enum display_state_t next;
+  u_int timeout;  // milliseconds. 0 leaves the menu timer alone
+} display_transition_t;
+
+#define TRANSITION(action, next, timeout) {true, action, next, timeout}
+
+// The menu. Per state and event.
+static const display_transition_t transitions[DISPLAY_SCREENS][DISP_TASK_SIGNALS] = {
+    [clockdisplay] =
+        {
+            [encoder_press] = TRANSITION(NULL, alarmdisplay, MENU_TIMEOUT_SHORT),
+            [encoder_up] = TRANSITION(action_info_scroll, infoscroll, 0),
+            [encoder_down] = TRANSITION(action_info_scroll, infoscroll, 0),
+        },
+    [alarmdisplay] =
+        {
+            [encoder_press] = TRANSITION(NULL, sleeptime, MENU_TIMOUT),
+            // We did not press a switch fast enough. Go to setting the alarm
+            [timer_expired] = TRANSITION(NULL, alarmset, MENU_TIMOUT),
+        },
+    [alarmset] =
+        {
+            // Only exit from this menu is timeout
+            [encoder_press] = TRANSITION(action_alarm_onoff, alarmset, MENU_TIMOUT),
+            [encoder_up] = TRANSITION(action_alarm_adjust, alarmset, MENU_TIMOUT),
+            [encoder_down] = TRANSITION(action_alarm_adjust, alarmset, MENU_TIMOUT),
+        },
+    [alarmgoing] =
+        {
+            // lets look how long we hold the button down
+            [encoder_press] = TRANSITION(action_alarm_sleep, alarmgoingpressed, ALARM_LONG_PRESS),
+            [timer_expired] = TRANSITION(action_alarm_timeout, clockdisplay, 0),
+        },
+    [alarmgoingpressed] =
+        {
+            // show alarm off for two seconds
+            [timer_expired] = TRANSITION(action_alarm_long_press, alarmgoingoff, 2000),
+        },
+    [sleeptime] =
+        {
+            [encoder_press] = TRANSITION(NULL, brightness, MENU_TIMOUT),
+            [encoder_up] = TRANSITION(action_sleep_adjust, sleeptime, MENU_TIMOUT),
+            [encoder_down] = TRANSITION(action_sleep_adjust, sleeptime, MENU_TIMOUT),
+        },
+    [brightness] =
+        {
+            [encoder_press] = TRANSITION(NULL, openwifiap, MENU_TIMOUT),
+            [encoder_up] = TRANSITION(action_brightness_adjust, brightness, MENU_TIMOUT),
+            [encoder_down] = TRANSITION(action_brightness_adjust, brightness, MENU_TIMOUT),
+        },
+    [openwifiap] =
+        {
+            // lets look how long we hold the button down. Long timeout or another press
+            [encoder_press] = TRANSITION(NULL, openwifiappressed, WIFIOPENAP_LONG_PRESS),
+        },
+    [openwifiappressed] =
+        {
+            [encoder_press] = TRANSITION(NULL, clockdisplay, 0),
+            [encoder_press_released] = TRANSITION(NULL, clockdisplay, 0),
+            [timer_expired] = TRANSITION(action_wifi_long_press, clockdisplay, 0),
+        },
+    [infoscroll] =
+        {
+            [encoder_press] = TRANSITION(NULL, clockdisplay, 0),
+        },
+};
+
+// Events handled the same in all states. Tried when the state has no
+// entry or its action did not take the transition.
+static const display_transition_t transitions_all[DISP_TASK_SIGNALS] = {
+    // max time alarm is sounding is one hour
+    [minute_passed] = TRANSITION(action_minute, alarmgoing, 3600000),
+    [alarm_due] = TRANSITION(action_alarm_due, alarmgoing, 3600000),
+    [timer_expired] = TRANSITION(NULL, clockdisplay, 0),
+};
+
+int display_clock_get_trace(display_trace_t* entries, int max_entries) {
+  int amount = (trace_count < DISPLAY_TRACE_LENGTH) ? trace_count : DISPLAY_TRACE_LENGTH;
+  uint32_t first = trace_count - amount;
+  display_trace_entry_t* entry;
+  int x;
+  if (amount > max_entries) {
+    // Newest ones
+    first += amount - max_entries;
+    amount = max_entries;
+  }
+  // Oldest first
+  for (x = 0; x < amount; x++) {
+    entry = &trace[(first + x) % DISPLAY_TRACE_LENGTH];
+    entries[x].time = entry->time;
+    entries[x].signal = disp_task_signal_name(entry->signal);
+    entries[x].from = display_screens[entry->from].name;
+    entries[x].to = display_screens[entry->to].name;
+  }
+  return amount;
+}
+
+// Look up what the event does in the current state and do it.
+static void display_clock_handle(const disp_task_queue_item_t* item) {
+  const display_transition_t* candidates[2];
+  const display_transition_t* transition;
+  int x;
+  if (((int)item->disp_task_signal < 0) || (item->disp_task_signal >= DISP_TASK_SIGNALS)) {
+    ESP_LOGI(TAG, "ClockDisplay:Received invalid signal from queue %d", item->disp_task_signal);
+    return;
+  }
+  candidates[0] = &transitions[display_state][item->disp_task_signal];
+  candidates[1] = &transitions_all[item->disp_task_signal];
+  for (x = 0; x < 2; x++) {
+    transition = candidates[x];
+    if (!transition->used) {
+      continue;
+    }
+    if ((transition->action != NULL) && !transition->action(item)) {
+      continue;
+    }
+    ESP_LOGI(TAG, "%s: %s to %s", disp_task_signal_name(item->disp_task_signal),
+             display_screens[display_state].name, display_screens[transition->next].name);
+    display_clock_trace(item->disp_task_signal, display_state, transition->next);
+    display_state = transition->next;
+    if (transition->timeout > 0) {
+      menu_timer(transition->timeout);
+    }
+    return;
+  }
+}
+
 //This is the main task for the clock display. Waits for events. Processes
 //them and loops to wait for new events. It is started as a FreeRTOS task.
 void display_clock() {
@@ -67,14 +511,22 @@ void display_clock() {
   ESP_LOGI(TAG, "Start display and buttons");
   // starting display
   ESP_LOGI(TAG, "Reseting SPI and MAX7219");
-  max7219_init_spi();
-  max7219_set_brightness(2);
+  if (read_nvram(&display_settings, sizeof(max7219_config_t), NVFLASH_DISPLAYBLOB) != ESP_OK) {
+    ESP_LOGI(TAG, "No display settings found in NVRAM. Using default.");
+  }
+  max7219_init_spi(&display_settings);
+  // Brightness follows the daylight from here
+  brightness_ramp_start(2);
   max7219_fill_display_buffer("Clock", MAX7219_ALIGN_MIDDLE);
   max7219_send_display();
 
   if (read_nvram(&clock_settings, sizeof(clock_settings_t), NVFLASH_CLOCKBLOB) != ESP_OK) {
     ESP_LOGE(TAG, "No clock settings found in NVRAM. Using default.");
   }
+  // Settings stored before there was a cron get one from the old fields
+  alarm_schedule_migrate();
+  // Work out when the alarm and sounds go off on the first check
+  alarm_schedule_changed();
 
   // create queue and get handle
   static QueueHandle_t disp_queue;
@@ -86,6 +538,13 @@ void display_clock() {
 
   // create var for receiving queue signals
   static disp_task_queue_item_t queue_item;
+  // state before the event. Digits are only animated on the clock display
+  static enum display_state_t previous_state;
+  // state drawn and the time it took
+  static enum display_state_t drawn_state;
+  static int64_t draw_start;
+  // time the event was taken from the queue
+  static int64_t received;
 
   // On boot, display clock
   display_state = clockdisplay;
@@ -104,232 +563,46 @@ void display_clock() {
       // we have waited for 70 seconds on items in queue. Should get 1 every 30secs
       ESP_LOGE(TAG, "Error: No display events received for 70 seconds");
     }
-    // we now should have a valid event type in queue_item
-    switch (queue_item.disp_task_signal) {
-      // What happens on an encoder switch press. Where do we go next.
-      case encoder_press:
-        ESP_LOGI(TAG, "Encoder Press event received");
-        // from current to new display state
-        switch (display_state) {
-          case clockdisplay:
-            ESP_LOGI(TAG, "Switching from clock to alarm display");
-            display_state = alarmdisplay;
-            menu_timer(MENU_TIMEOUT_SHORT);
-            break;
-          case alarmdisplay:
-            ESP_LOGI(TAG, "Switching from alarmdisplay to sleeptime");
-            display_state = sleeptime;
-            menu_timer(MENU_TIMOUT);
-            break;
-          case alarmset:
-            ESP_LOGI(TAG, "Toggle alarm on/off");
-            alarm_onoff();
-            menu_timer(MENU_TIMOUT);
-            break;
-          case sleeptime:
-            ESP_LOGI(TAG, "Switching from sleeptime to brightness display");
-            display_state = brightness;
-            menu_timer(MENU_TIMOUT);
-            break;
-          case brightness:
-            ESP_LOGI(TAG, "Switching from brightness to Wifi AP display");
-            display_state = openwifiap;
-            menu_timer(MENU_TIMOUT);
-            break;
-          case alarmgoing:
-            // key is pressed when alarm goes off.
-            ESP_LOGI(TAG, "Alarm is going and key is pressed");
-            // switch off alarm sound immediatly
-            stop_alarm();
-            // add sleep immediatly. This disables rearming in in same minute
-            alarm_add_sleep();
-            // lets look how long we hold the button down
-            display_state = alarmgoingpressed;
-            menu_timer(ALARM_LONG_PRESS);
-            break;
-          case openwifiap:
-            ESP_LOGI(TAG, "Wifi open ap display keypress");
-            // lets look how long we hold the button down
-            display_state = openwifiappressed;
-            menu_timer(WIFIOPENAP_LONG_PRESS);
-            // Long timeout or another press
-            break;
-          case openwifiappressed:
-            ESP_LOGI(TAG, "Switching to clock display from Wifi open AP");
-            display_state = clockdisplay;
-            break;
-          default:
-            break;
-        }
-        break;
-      case encoder_press_released:
-        ESP_LOGI(TAG, "Key released");
-        switch (display_state) {
-          case openwifiappressed:
-            ESP_LOGI(TAG, "Switching to clock display from Wifi open AP");
-            display_state = clockdisplay;
-            break;
-          default:
-            break;
-        }
-        break;
-      case minute_passed:
-        ESP_LOGI(TAG, "30 or 60 seconds passed. The time %d:%d:%d", current_timeinfo.tm_hour,
-                 current_timeinfo.tm_min, current_timeinfo.tm_sec);
-        // Check for alarm or a timed sound and play this.
-        if (check_for_alarm()) {
-          // we have found an alarm set for this minute and hour. Optional specific for this day
-          display_state = alarmgoing;
-          // max time alarm is sounding is one hour
-          menu_timer(3600000);
-        }
-        // make sure we check for automatic brightness
-        // zero dims during the night
-        brightness_set(0);
-        // check if we need to store new settings
-        clock_store_nvram(-1);
-        break;
-      // encoder is being turned
-      case encoder_up:
-        ESP_LOGI(TAG, "Received Encoder up");
-        switch (display_state) {
-          case alarmset:
-            alarm_set_time(1);
-            menu_timer(MENU_TIMOUT);
-            break;
-          case sleeptime:
-            sleep_set_time(1);
-            menu_timer(MENU_TIMOUT);
-            break;
-          case brightness:
-            brightness_set(1);
-            menu_timer(MENU_TIMOUT);
-            break;
-          default:
-            break;
-        }
-        break;
-      // encoder is being turned
-      case encoder_down:
-        ESP_LOGI(TAG, "Received Encoder down");
-        switch (display_state) {
-          case alarmset:
-            alarm_set_time(-1);
-            menu_timer(MENU_TIMOUT);
-            break;
-          case sleeptime:
-            sleep_set_time(-1);
-            menu_timer(MENU_TIMOUT);
-            break;
-          case brightness:
-            brightness_set(-1);
-            menu_timer(MENU_TIMOUT);
-            break;
-          default:
-            break;
-        }
-        break;
-      case timer_expired:
-        ESP_LOGI(TAG, "Received timer expired");
-        // The timer we set before expired.
-        switch (display_state) {
-          case alarmdisplay:
-              // We did not press a switch fast enough
-              // got to setting the alarm
-            display_state = alarmset;
-            menu_timer(MENU_TIMOUT);
-            break;
-          case alarmgoing:
-            // should only happen when alarm sounds more than 1 hour
-            stop_alarm();
-            alarm_off();
-            display_state = clockdisplay;
-            break;
-          case alarmgoingpressed:
-            // alarm went off. And we pressed switch. Lets look if long enough
-            if (rotary_encoder_get_button() == 0) {
-              // we still press the switch. Disable alarm and show it
-              alarm_off();
-              display_state = alarmgoingoff;
-              // show it for two seconds
-              menu_timer(2000);
-            } else {
-              // we only sleep
-              display_state = clockdisplay;
-            }
-            break;
-          case openwifiappressed:
-            // We are on the WIFI open AP display. Lets look if long enough
-            // to open the wifi
-            if (rotary_encoder_get_button() == 0) {
-              // we still press the switch.
-              ESP_LOGI(TAG, "Long keypress. Open AP");
-              open_wifi_ap();
-            }
-            display_state = clockdisplay;
-            break;
-          default:
-            display_state = clockdisplay;
-            break;
-        }
-        break;
-      default:
-        ESP_LOGI(TAG, "ClockDisplay:Received invalid signal from queue %d",
-                 queue_item.disp_task_signal);
-        break;
+    received = esp_timer_get_time();
+    event_stats.events++;
+    display_clock_latency(&queue_item, received);
+    // The received event is not counted as waiting
+    if (uxQueueMessagesWaiting(disp_queue) + 1 > event_stats.queue_peak) {
+      event_stats.queue_peak = uxQueueMessagesWaiting(disp_queue) + 1;
+    }
+    // A fast spin fills the queue with turns. Handle them in one go with
+    // one redraw. Up and down in the same batch cancel out.
+    if ((queue_item.disp_task_signal == encoder_up) ||
+        (queue_item.disp_task_signal == encoder_down)) {
+      display_clock_coalesce(disp_queue, &queue_item, received);
+    }
+    // The next frame sent is the answer to an encoder event. Measure the
+    // time until it is on the display. See max7219 flush stats.
+    if ((queue_item.disp_task_signal == encoder_up) ||
+        (queue_item.disp_task_signal == encoder_down) ||
+        (queue_item.disp_task_signal == encoder_press)) {
+      max7219_mark_event(queue_item.time);
+    }
+    previous_state = display_state;
+    // What the event does depends on the state we are in
+    display_clock_handle(&queue_item);
+    // Scrolling only runs in its own display state
+    if ((display_state != infoscroll) && display_scroll_active()) {
+      display_scroll_stop();
+    }
+    // Digit animations only on the clock display
+    if ((display_state != clockdisplay) && display_anim_active()) {
+      display_anim_stop();
     }
 
     // now display the various displays. Above we listen to event queue
     // So display updates always happen in reaction to events
-    switch (display_state) {
-      case clockdisplay:
-        ESP_LOGI(TAG, "Clock display");
-        time_sendto_display();
-        break;
-      case alarmdisplay:
-        // short display. If we press fast enough go to other settings
-        // else go to setting the the alarm
-        ESP_LOGI(TAG, "Alarmdisplay");
-        max7219_fill_display_buffer("Alarm", MAX7219_ALIGN_MIDDLE);
-        max7219_send_display();
-        break;
-      case alarmset:
-        // Only exit from this menu is timeout
-        /////// Display alarm time. And if alarm is armed
-        ESP_LOGI(TAG, "Alarmset");
-        alarm_sendto_display();
-        break;
-      case sleeptime:
-        // display alarm sleep time
-        ESP_LOGI(TAG, "Sleeptime");
-        sleep_sendto_display();
-        break;
-      case brightness:
-        ESP_LOGI(TAG, "Brightness");
-        brightness_sendto_display();
-        break;
-      case alarmgoing:
-        ESP_LOGI(TAG, "Alarm going display");
-        time_sendto_display();
-        break;
-      case alarmgoingpressed:
-        ESP_LOGI(TAG, "Alarm pressed display");
-        time_sendto_display();
-        break;
-      case alarmgoingoff:
-        // short display to display alarm is off
-        ESP_LOGI(TAG, "Alarm switched off display");
-        max7219_fill_display_buffer("Off", MAX7219_ALIGN_MIDDLE);
-        max7219_send_display();
-        break;
-      case openwifiap:
-        ESP_LOGI(TAG, "Open WIFI AP");
-        max7219_fill_display_buffer("Wifi AP", MAX7219_ALIGN_LEFT);
-        max7219_send_display();
-        break;
-      default:
-        break;
+    drawn_state = display_state;
+    draw_start = esp_timer_get_time();
+    if (display_screens[display_state].draw != NULL) {
+      display_screens[display_state].draw(&queue_item, previous_state);
     }
+    display_clock_screen_time(drawn_state, (uint32_t)(esp_timer_get_time() - draw_start));
   }
 }
 
@@ -7,6 +7,8 @@
 #ifndef DISPLAY_TASK_H_
 #define DISPLAY_TASK_H_
 
+#include <stdint.h>
+
 #define MENU_TIMOUT 8000
 #define MENU_TIMEOUT_SHORT 1200
 // alarm times is adjusted by 5 minutes interval steps.
@@ -20,6 +22,60 @@
 //The name of the NVRAM var with the CLOCK settings
 #define NVFLASH_CLOCKBLOB "clock"
 
+// CPU time of the display task to draw a screen and hand it to the
+// display. In microseconds.
+typedef struct {
+  const char *name;  // display state
+  uint32_t draws;
+  uint32_t us_last;
+  uint32_t us_avg;   // running average over the last draws
+  uint32_t us_max;
+} display_screen_stats_t;
+
+// Counters of the display task queue. Encoder turns waiting in the queue
+// are merged into one step count and one redraw.
+typedef struct {
+  uint32_t events;      // events taken from the queue
+  uint32_t batches;     // encoder turns handled. Each a merge of 1 or more events
+  uint32_t merged;      // encoder events merged into an earlier one
+  uint32_t max_batch;   // most encoder events merged at once
+  uint32_t queue_peak;  // most events waiting in the queue
+} display_event_stats_t;
+
+// Time from the producer sending an event to the display task taking it.
+// Histogram per signal. Bucket b counts latencies below
+// DISPLAY_LATENCY_BUCKET_US(b). The last bucket counts everything above.
+#define DISPLAY_LATENCY_BUCKETS 8
+#define DISPLAY_LATENCY_BUCKET_US(b) (64UL << (2 * (b)))
+typedef struct {
+  const char *name;  // signal
+  uint32_t count;
+  uint32_t us_last;
+  uint32_t us_max;
+  uint32_t buckets[DISPLAY_LATENCY_BUCKETS];
+} display_latency_stats_t;
+
+// Recent changes of the display state. For debugging the menu.
+#define DISPLAY_TRACE_LENGTH 32
+typedef struct {
+  int64_t time;        // esp_timer_get_time() of the change
+  const char *signal;  // event that caused it
+  const char *from;    // display state before
+  const char *to;      // display state after. Can be the same
+} display_trace_t;
+
 void start_display_clock_task();
 
+// Copy the draw timing of each screen. Returns the amount of screens.
+int display_clock_get_screen_stats(display_screen_stats_t *stats, int max_screens);
+
+// Copy of the queue counters
+void display_clock_get_event_stats(display_event_stats_t *stats);
+
+// Copy the latency histogram of each signal. Returns the amount of signals.
+int display_clock_get_latency_stats(display_latency_stats_t *stats, int max_signals);
+
+// Copy the recent state changes. Oldest first. Returns the amount.
+int display_clock_get_trace(display_trace_t *entries, int max_entries);
+
 #endif
@@ -14,6 +14,7 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/portmacro.h"
 #include "freertos/task.h"
@@ -24,13 +25,19 @@
 
 // Own files to include
 #include "64bitpatch_localtime.h"
+#include "alarm_schedule.h"
 #include "app_queue.h"
 #include "defaults_globals.h"
+#include "display_anim.h"
 #include "display_clock.h"
 #include "display_functions.h"
+#include "display_scroll.h"
+#include "ds3231.h"
 #include "max7219.h"
+#include "networkstartstop.h"
 #include "nvramfunctions.h"
 #include "rotary_encoder.h"
+#include "schedule_store.h"
 #include "sound.h"
 #include "time_task.h"
 
@@ -53,64 +60,125 @@ next_alarm_t next_alarm = {
     .hour = 99  // If we restart and never get to alarmtime the alarm would go at 00:00
 };
 
-typedef struct {
-  int sun_up_hour;
-  int sun_down_hour;
-} sun_updown_t;
-
-// Below struct is for adjusting brightness during the night
-// Needs adapting to your location. This is in The Netherlands
-// These are average sun up down times for each month. Without
-// daylight saving.
-const sun_updown_t sun_updown_month[12] = {{9, 17},  // januari is 0 in tm struct
-                                           {8, 18}, {7, 18}, {6, 19}, {6, 20}, {5, 21}, {5, 21},
-                                           {6, 20}, {6, 19}, {7, 18}, {8, 17}, {9, 17}};
+// One shot timer for the second the next alarm or sound goes off. The
+// minute tick of the time task checks too. Each minute is checked once.
+static esp_timer_handle_t alarm_timer = NULL;
+static uint32_t alarm_timer_minute = SCHEDULE_NEVER;  // local minute the timer is set for
+static uint32_t alarm_checked_minute = 0;
+// Check started by the timer. For the onset stats
+static bool alarm_timer_check = false;
+static alarm_onset_stats_t onset_stats[2];  // alarm and sound
+
+// The screens below are laid out for MAX7219_TOT_COLUMNS columns.
+// On a longer chain they are shifted to the middle of the display.
+static int screen_pos(int position) {
+  int width = max7219_get_width();
+  if (width > MAX7219_TOT_COLUMNS) {
+    return position + ((width - MAX7219_TOT_COLUMNS) / 2);
+  }
+  return position;
+}
+
+// Digits of the last time drawn. Empty before the first time is drawn.
+static char time_digits[4];
+
+// The 4 digits of the current time. Font ascii from 10 tot 19 are clock
+// fonts with fixed font pitch
+static void time_get_digits(char *digits) {
+  digits[0] = (current_timeinfo.tm_hour / 10) + 10;
+  digits[1] = (current_timeinfo.tm_hour % 10) + 10;
+  digits[2] = (current_timeinfo.tm_min / 10) + 10;
+  digits[3] = (current_timeinfo.tm_min % 10) + 10;
+}
+
+void time_animate_to_display(void) {
+  char digits[4];
+  display_anim_digit_t anim_digits[4];
+  const int positions[4] = {3, 9, 18, 24};
+  int x;
+  time_get_digits(digits);
+  if (display_anim_active()) {
+    // Frames of the running animation come with the anim_frame signal
+    return;
+  }
+  if (time_digits[0] == 0) {
+    // Nothing to animate from
+    time_sendto_display();
+    return;
+  }
+  for (x = 0; x < 4; x++) {
+    anim_digits[x].position = screen_pos(positions[x]);
+    anim_digits[x].old_char = time_digits[x];
+    anim_digits[x].new_char = digits[x];
+  }
+  // The display buffer still has the old time. Only changed digits move.
+  if (display_anim_start(anim_digits, 4, ANIM_EFFECT) != ESP_OK) {
+    time_sendto_display();
+  }
+}
 
 void time_sendto_display(void) {
   // strings are send to the display
   // local time is converted to chars
+  display_anim_stop();
+  time_get_digits(time_digits);
   max7219_empty_display_buffer();
   // font ascii from 10 tot 19 are clock fonts
   // with fixed font pitch
   tempdisp[0] = ((current_timeinfo.tm_hour / 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 7);
-  max7219_sprite_fill_buffer(tempdisp, 3);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(3));
   tempdisp[0] = ((current_timeinfo.tm_hour % 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 13);
-  max7219_sprite_fill_buffer(tempdisp, 9);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(9));
   // double dot
   tempdisp[0] = 20;
   // max7219_sprite_fill_buffer(tempdisp, 19);
-  max7219_sprite_fill_buffer(tempdisp, 15);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(15));
   tempdisp[0] = ((current_timeinfo.tm_min / 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 22);
-  max7219_sprite_fill_buffer(tempdisp, 18);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(18));
   tempdisp[0] = ((current_timeinfo.tm_min % 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 28);
-  max7219_sprite_fill_buffer(tempdisp, 24);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(24));
+#if defined(MAX7219_GRAYSCALE) && defined(CLOCK_COLON_LEVEL)
+  // Digits at full level. The colon dimmed over it. When the display
+  // can not do grayscale the normal frame with the full colon is shown.
+  u_int8_t colon[MAX7219_COLUMNS];
+  int colon_length;
+  max7219_gray_from_display();
+  tempdisp[0] = 20;
+  colon_length = max7219_render_columns(tempdisp, colon, MAX7219_COLUMNS);
+  max7219_gray_fill_columns(colon, screen_pos(15), colon_length, CLOCK_COLON_LEVEL);
+  if (max7219_gray_show() == ESP_OK) {
+    return;
+  }
+#endif
   // display time
   max7219_send_display();
 }
 
 void alarm_sendto_display(void) {
+  // The cron of the alarm can have more times. Show the next one
+  alarm_time_from_cron();
   // strings are send to the display
   max7219_empty_display_buffer();
   tempdisp[0] = ((clock_settings.alarmsounds[0].hour / 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 2);
-  max7219_sprite_fill_buffer(tempdisp, 1);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(1));
   tempdisp[0] = ((clock_settings.alarmsounds[0].hour % 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 8);
-  max7219_sprite_fill_buffer(tempdisp, 7);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(7));
   // double dot
   tempdisp[0] = 20;
   // max7219_sprite_fill_buffer(tempdisp, 14);
-  max7219_sprite_fill_buffer(tempdisp, 13);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(13));
   tempdisp[0] = ((clock_settings.alarmsounds[0].minute / 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 17);
-  max7219_sprite_fill_buffer(tempdisp, 16);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(16));
   tempdisp[0] = ((clock_settings.alarmsounds[0].minute % 10) + 10);
   // max7219_sprite_fill_buffer(tempdisp, 23);
-  max7219_sprite_fill_buffer(tempdisp, 22);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(22));
   // Alarm fonts chars are 30 and 31. 31 with dash. 30 without
   if (clock_settings.alarm_onoff == true) {
     tempdisp[0] = 31;
@@ -118,7 +186,7 @@ void alarm_sendto_display(void) {
     tempdisp[0] = 30;
   }
   // max7219_sprite_fill_buffer(tempdisp, 37);
-  max7219_sprite_fill_buffer(tempdisp, 28);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(28));
   max7219_send_display();
 }
 
@@ -126,16 +194,16 @@ void sleep_sendto_display(void) {
   // strings are send to the display
   max7219_empty_display_buffer();
   tempdisp[0] = 'S';
-  max7219_sprite_fill_buffer(tempdisp, 0);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(0));
   tempdisp[0] = 'l';
-  max7219_sprite_fill_buffer(tempdisp, 6);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(6));
   tempdisp[0] = 'p';
-  max7219_sprite_fill_buffer(tempdisp, 9);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(9));
   // Display timeout minutes
   tempdisp[0] = ((clock_settings.sleep_minutes / 10) + 10);
-  max7219_sprite_fill_buffer(tempdisp, 21);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(21));
   tempdisp[0] = ((clock_settings.sleep_minutes % 10) + 10);
-  max7219_sprite_fill_buffer(tempdisp, 27);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(27));
   max7219_send_display();
 }
 
@@ -143,19 +211,41 @@ void brightness_sendto_display(void) {
   // strings are send to the display
   max7219_empty_display_buffer();
   tempdisp[0] = 'B';
-  max7219_sprite_fill_buffer(tempdisp, 0);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(0));
   tempdisp[0] = 'r';
-  max7219_sprite_fill_buffer(tempdisp, 6);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(6));
   tempdisp[0] = 'i';
-  max7219_sprite_fill_buffer(tempdisp, 12);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(12));
   // Display timeout minutes
   tempdisp[0] = ((clock_settings.brightness / 10) + 10);
-  max7219_sprite_fill_buffer(tempdisp, 21);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(21));
   tempdisp[0] = ((clock_settings.brightness % 10) + 10);
-  max7219_sprite_fill_buffer(tempdisp, 27);
+  max7219_sprite_fill_buffer(tempdisp, screen_pos(27));
   max7219_send_display();
 }
 
+// Scroll IP address, temperature inside the clock and the alarm over the
+// display. Text does not fit on the display.
+void info_scroll_start(void) {
+  char info_text[SCROLL_MAX_TEXT];
+  char ip_text[16];
+  float temp_ds3231;
+  int length;
+  network_get_ip(ip_text, sizeof(ip_text));
+  if (ip_text[0] == 0) {
+    strcpy(ip_text, "none");
+  }
+  length = snprintf(info_text, sizeof(info_text), "IP %s", ip_text);
+  if (ds3231_get_temp_float(&temp_ds3231) == ESP_OK) {
+    length += snprintf(&info_text[length], sizeof(info_text) - length, "  Temp %.1f\u00b0C",
+                       temp_ds3231);
+  }
+  snprintf(&info_text[length], sizeof(info_text) - length, "  Alarm %02d:%02d %s",
+           clock_settings.alarmsounds[0].hour, clock_settings.alarmsounds[0].minute,
+           clock_settings.alarmsounds[0].soundfile);
+  display_scroll_start(info_text, SCROLL_SPEED);
+}
+
 // function to be called with 1 when making settings
 // and -1 when called by clock_display clock-tick.
 // Called with -1 one or two times a minute to
@@ -217,6 +307,7 @@ void alarm_add_sleep() {
       next_alarm.hour = 0;
     }
   }
+  alarm_timer_arm();
 }
 
 void stop_alarm(void) {
@@ -224,96 +315,99 @@ void stop_alarm(void) {
   stop_sound();
 }
 
-// Turning the encoder on the alarm display
+void alarm_time_from_cron(void) {
+  struct tm next;
+  uint32_t minute = alarm_schedule_cron_next(&clock_settings.cron[0],
+                                             alarm_schedule_minute(&current_timeinfo));
+  if (minute == SCHEDULE_NEVER) {
+    return;
+  }
+  alarm_schedule_to_tm(minute, &next);
+  clock_settings.alarmsounds[0].hour = next.tm_hour;
+  clock_settings.alarmsounds[0].minute = next.tm_min;
+}
+
+// Turning the encoder on the alarm display. Adjustment is the amount of
+// encoder steps. Negative is down.
 void alarm_set_time(int adjustment) {
-  if (adjustment > 0) {
-    // adjust time up
-    clock_settings.alarmsounds[0].minute += ALARM_ADJUST;
-    if (clock_settings.alarmsounds[0].minute > 59) {
-      clock_settings.alarmsounds[0].minute -= 60;
-      clock_settings.alarmsounds[0].hour += 1;
-      if (clock_settings.alarmsounds[0].hour > 23) {
-        clock_settings.alarmsounds[0].hour = 0;
-      }
-    }
-  } else {
-    // adjust time down
-    clock_settings.alarmsounds[0].minute -= ALARM_ADJUST;
-    if (clock_settings.alarmsounds[0].minute < 0) {
-      clock_settings.alarmsounds[0].minute += 60;
-      clock_settings.alarmsounds[0].hour -= 1;
-      if (clock_settings.alarmsounds[0].hour < 0) {
-        clock_settings.alarmsounds[0].hour = 23;
-      }
-    }
+  int alarm_minutes;
+  if (adjustment == 0) {
+    return;
+  }
+  // The encoder sets one time. A cron with more times is only set by the
+  // web page. Not thrown away by turning the encoder
+  if ((__builtin_popcountll(clock_settings.cron[0].minutes) != 1) ||
+      (__builtin_popcount(clock_settings.cron[0].hours) != 1)) {
+    ESP_LOGW(TAG, "Alarm has more times. Not changed by the encoder");
+    return;
   }
+  // Minutes in the day. Wraps around midnight
+  alarm_minutes = (clock_settings.alarmsounds[0].hour * 60) + clock_settings.alarmsounds[0].minute +
+                  (adjustment * ALARM_ADJUST);
+  alarm_minutes %= 24 * 60;
+  if (alarm_minutes < 0) {
+    alarm_minutes += 24 * 60;
+  }
+  clock_settings.alarmsounds[0].hour = alarm_minutes / 60;
+  clock_settings.alarmsounds[0].minute = alarm_minutes % 60;
+  // Only the time changes. The alarm keeps going off on the same days
+  clock_settings.cron[0].minutes = 1ULL << clock_settings.alarmsounds[0].minute;
+  clock_settings.cron[0].hours = 1UL << clock_settings.alarmsounds[0].hour;
+  alarm_schedule_changed();
   clock_store_nvram(1);
 }
 
-// turning the encoder on the set sleep timeout display
 void sleep_set_time(int adjustment) {
-  if (adjustment > 0) {
-    // adjust sleeptime up
-    if (clock_settings.sleep_minutes < 59) {
-      clock_settings.sleep_minutes += 1;
-    }
-  } else {
-    // adjust time down
-    if (clock_settings.sleep_minutes > 1) {
-      clock_settings.sleep_minutes -= 1;
-    }
+  int sleep_minutes = clock_settings.sleep_minutes + adjustment;
+  // sleeptime between 1 and 59 minutes
+  sleep_minutes = MAX(1, MIN(59, sleep_minutes));
+  if (sleep_minutes != clock_settings.sleep_minutes) {
+    clock_settings.sleep_minutes = sleep_minutes;
+    clock_store_nvram(1);
   }
-  clock_store_nvram(1);
 }
 
-//When called with 0 just adjust display brightness to evening or daytime
-//When called with positive or negative number adjust brightness setting
+//Adjust the brightness setting up or down. The display brightness follows
+//it with the daylight. See display_brightness.c
 void brightness_set(int adjustment) {
-  if (adjustment > 0) {
-    // adjust brightness up
-    if (clock_settings.brightness < MAXBRIGHT) {
-      clock_settings.brightness += 1;
-      clock_store_nvram(1);
-    }
+  int brightness = clock_settings.brightness + adjustment;
+  brightness = MAX(0, MIN(MAXBRIGHT, brightness));
+  if (brightness != clock_settings.brightness) {
+    clock_settings.brightness = brightness;
+    clock_store_nvram(1);
   }
-  if (adjustment < 0) {
-    // adjust brightness down
-    if (clock_settings.brightness > 0) {
-      clock_settings.brightness -= 1;
-      clock_store_nvram(1);
-    }
+}
+
+// Offset of local time to UTC in seconds. From the last time the time
+// task made current_timeinfo. So no time zone is needed here.
+static int64_t local_offset(void) {
+  return ((int64_t)alarm_schedule_minute(&current_timeinfo) * 60) + current_timeinfo.tm_sec -
+         current_time;
+}
+
+// Time from the start of the minute to now. Just before playing
+static void alarm_onset(alarm_onset_stats_t *stats) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  uint32_t onset_us = (((now.tv_sec + local_offset()) % 60) * 1000000) + now.tv_usec;
+  stats->count++;
+  if (alarm_timer_check) {
+    stats->timer++;
+  }
+  stats->us_last = onset_us;
+  if (stats->us_avg == 0) {
+    stats->us_avg = onset_us;
+  } else {
+    stats->us_avg = ((stats->us_avg * 7) + onset_us) / 8;
   }
-  // adjust brightness when it is getting darker
-  int tmp_hour;
-  int tmp_brightness;
-  int bright_adjust = clock_settings.brightness / 3;
-  if (bright_adjust < 1) {
-    bright_adjust = 1;
-  }
-  tmp_hour = current_timeinfo.tm_hour;
-  if (current_timeinfo.tm_isdst) {
-    tmp_hour--;
-  }
-  tmp_brightness = clock_settings.brightness;
-  if ((tmp_hour <= (sun_updown_month[current_timeinfo.tm_mon].sun_down_hour + 1)) ||
-      (tmp_hour >= (sun_updown_month[current_timeinfo.tm_mon].sun_up_hour - 1))) {
-    // We are in the twilight. adjust brightness -1
-    tmp_brightness -= bright_adjust;
-  }
-  if ((tmp_hour <= sun_updown_month[current_timeinfo.tm_mon].sun_down_hour) ||
-      (tmp_hour >= sun_updown_month[current_timeinfo.tm_mon].sun_up_hour)) {
-    // We are in the dark. adjust brightness -2. So an extra -1.
-    tmp_brightness -= bright_adjust;
-  }
-  // Do not try to set a negative brightness
-  if (tmp_brightness < 0) {
-    tmp_brightness = 0;
-  }
-  max7219_set_brightness(tmp_brightness);
+  if (onset_us > stats->us_max) {
+    stats->us_max = onset_us;
+  }
+  ESP_LOGI(TAG, "Sound starts %d us after the minute", onset_us);
 }
 
 //Check for sounds or alarms to play
-int check_for_alarm(void) {
+int check_for_alarm(const struct tm *now) {
   // we check if we need to make a sound
   // we have the option to play sounds on certain times
   // return 1 if we sounded the alarm instead of just a sound
@@ -321,99 +415,183 @@ int check_for_alarm(void) {
   //
   // We only check and play sounds at the start of the minute.
   // Below is just an extra check on this. Should not be needed.
-  if (current_timeinfo.tm_sec > 9) {
+  if (now->tm_sec > 9) {
     return 0;
   }
-  //
-  int alarm_found = 0;
+  // The timer and the minute tick both check. The first one plays
+  uint32_t minute = alarm_schedule_minute(now);
+  if (minute == alarm_checked_minute) {
+    return 0;
+  }
+  alarm_checked_minute = minute;
+  // The schedule knows which slots go off this minute. Mostly none
+  uint32_t due = alarm_schedule_due(now);
   int sound_to_play = -1;
   int x;
-  for (x = 0; x < MAX_SOUNDFILES; x++) {
-    // loop through the clocksettings and try to find a matching time
-    // the first entry in the clock_settings.alarmsound array is the
-    // default with the alarm times.
-    //////ESP_LOGI(TAG, "X is %d. alarm_found = %d , soundtoplay = %d", x, alarm_found,
-    /// sound_to_play);
-    if ((current_timeinfo.tm_hour == clock_settings.alarmsounds[x].hour) &&
-        (current_timeinfo.tm_min == clock_settings.alarmsounds[x].minute)) {
-      // we found a matching time
-      ESP_LOGI(TAG, "Slot is %d. alarm_found = %d , soundtoplay = %d", x, alarm_found,
-               sound_to_play);
-      if (x == 0) {
-        // This is the alarm and not another sound.
-        alarm_found = 1;
-        next_alarm.hour = current_timeinfo.tm_hour;
-        next_alarm.minute = current_timeinfo.tm_min;
-        next_alarm.soundfile_nr = x;  // This can later be overriden.
-        // next_alarm.sleeping = 0;
-        ESP_LOGI(TAG, "Check Alarm time found default Alarm.");
-      } else {
-        ESP_LOGI(TAG, "X achter else is %d.", x);
-        if ((alarm_found == 0) && (clock_settings.alarmsounds[x].is_alarm == false)) {
-          ESP_LOGI(TAG, "Check Alarm time found default sound.");
-          // Found a sound to play and not an alarm. And it is not the alarm time.
-          // Checking for certain days of the week
-          if ((current_timeinfo.tm_wday + 1) == clock_settings.alarmsounds[x].weekday) {
-            // We need to add 1 to tm_wday because it starts at 0. 0 is sunday
-            // Found a weekday sound for this hour
-            sound_to_play = x;
-            ESP_LOGI(TAG, "Check Alarm time found sound for specific weekday.");
-          } else if ((clock_settings.alarmsounds[x].month == (current_timeinfo.tm_mon + 1)) &&
-                     (clock_settings.alarmsounds[x].day == current_timeinfo.tm_mday)) {
-            // just checked if the month, day and time are specific
-            sound_to_play = x;
-            ESP_LOGI(TAG, "Check Alarm time found sound for specific date.");
-          }
-          if ((sound_to_play == -1) && (clock_settings.alarmsounds[x].weekday == 0) &&
-              (clock_settings.alarmsounds[x].month == 0)) {
-            // Sound for certain time. And not for a certain weekday or date
-            // We do not allow playing a sound at 00:00 and always.
-            if ((clock_settings.alarmsounds[x].hour != 0) &&
-                (clock_settings.alarmsounds[x].minute != 0)) {
-              sound_to_play = x;
-              ESP_LOGI(TAG, "Check Alarm time found sound for certain time and for all days.");
-            }
-          }
-        }
-      }
-    }
+  // The large table of sounds in spiffs. Also checked when a slot goes off
+  // to keep it up to date.
+  char table_sound[MAX_SOUNDFILE_LENGTH];
+  bool table_due = schedule_store_due(now, table_sound, sizeof(table_sound));
+  if ((due & 1) && !clock_settings.alarm_onoff) {
+    // The alarm is off. Nothing is kept for sleep. It would ring again at
+    // this time every day. Also on days the slot does not go off
+    ESP_LOGI(TAG, "Check Alarm time found default Alarm. Alarm is off.");
+  } else if (due & 1) {
+    // This is the alarm and not another sound. No other sounds now
+    next_alarm.hour = now->tm_hour;
+    next_alarm.minute = now->tm_min;
+    next_alarm.soundfile_nr = 0;
+    ESP_LOGI(TAG, "Check Alarm time found default Alarm.");
     // Now lets check if there is a special alarm for this day or weekday
     // Walk through all alarm sound and check for weekdays or dates
     // Do not check on time. This allows for special alarm sound for certain
     // days in the week or special dates. Like christmas or weekend days
-    if ((alarm_found > 0) && (clock_settings.alarmsounds[x].is_alarm == true)) {
-      // check for weekday or day/month
-      if ((current_timeinfo.tm_wday + 1) == clock_settings.alarmsounds[x].weekday) {
-        // We need to add 1 to tm_wday because it starts at 0. 0 is sunday
-        // Found a weekday set
+    for (x = 0; x < MAX_SOUNDFILES; x++) {
+      if ((clock_settings.alarmsounds[x].is_alarm == true) &&
+          !schedule_cron_every_day(&clock_settings.cron[x]) &&
+          schedule_cron_day_match(&clock_settings.cron[x], now->tm_mon + 1, now->tm_mday,
+                                  now->tm_wday)) {
         next_alarm.soundfile_nr = x;
-        ESP_LOGI(TAG, "Check Alarm time found alarm for specific weekday.");
-      } else if ((clock_settings.alarmsounds[x].month == (current_timeinfo.tm_mon + 1)) &&
-                 (clock_settings.alarmsounds[x].day == current_timeinfo.tm_mday)) {
-        // just checked if the month, day and time are specific
-        next_alarm.soundfile_nr = x;
-        ESP_LOGI(TAG, "Check Alarm time found alarm for specific date.");
+        ESP_LOGI(TAG, "Check Alarm time found alarm %d for specific weekday or date.", x);
       }
     }
-  }  // End of looping through alarmsounds.
+  } else {
+    // Sounds going off this minute. A sound for certain weekdays or dates
+    // wins from a sound for all days. The last one found wins.
+    for (x = 1; (x < MAX_SOUNDFILES) && (due >> x); x++) {
+      if (!(due & (1UL << x))) {
+        continue;
+      }
+      if (!schedule_cron_every_day(&clock_settings.cron[x])) {
+        sound_to_play = x;
+        ESP_LOGI(TAG, "Check Alarm time found sound %d for specific weekday or date.", x);
+      } else if (sound_to_play == -1) {
+        sound_to_play = x;
+        ESP_LOGI(TAG, "Check Alarm time found sound %d for certain time and for all days.", x);
+      }
+    }
+  }
   //
   // now we check if there is an alarm to play
-  if ((current_timeinfo.tm_hour == next_alarm.hour) &&
-      (current_timeinfo.tm_min == next_alarm.minute) && (clock_settings.alarm_onoff)) {
+  if ((now->tm_hour == next_alarm.hour) && (now->tm_min == next_alarm.minute) &&
+      (clock_settings.alarm_onoff)) {
     ESP_LOGI(TAG, "Alarm is sounding");
+    alarm_onset(&onset_stats[0]);
     play_wav(clock_settings.alarmsounds[next_alarm.soundfile_nr].soundfile, 1);
     return 1;
   }
   if (sound_to_play > 0) {
+    alarm_onset(&onset_stats[1]);
     play_wav(clock_settings.alarmsounds[sound_to_play].soundfile, 0);
+  } else if (table_due && !(due & 1)) {
+    alarm_onset(&onset_stats[1]);
+    play_wav(table_sound, 0);
   }
   return 0;
 }
 
+static void alarm_timer_send(void *arg) {
+  QueueHandle_t send_queue = display_task_queue();
+  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = alarm_due,
+                                                 .time = esp_timer_get_time()};
+  if (send_queue != 0) {
+    // we do not check if the queue is full
+    xQueueSendToBack(send_queue, &signal_to_send, 0);
+  }
+}
+
+void alarm_timer_arm(void) {
+  struct timeval now;
+  schedule_entry_t entry;
+  uint32_t when;
+  int index;
+  uint32_t next = SCHEDULE_NEVER;
+  uint32_t snooze;
+  int64_t offset = local_offset();
+  int64_t delay_us;
+  if (alarm_timer == NULL) {
+    const esp_timer_create_args_t timer_args = {.callback = &alarm_timer_send,
+                                                .name = "alarm"};
+    if (esp_timer_create(&timer_args, &alarm_timer) != ESP_OK) {
+      ESP_LOGE(TAG, "Error in creating alarm timer");
+      alarm_timer = NULL;
+      return;
+    }
+  }
+  // Not running is fine
+  esp_timer_stop(alarm_timer);
+  gettimeofday(&now, NULL);
+  uint32_t minute = (now.tv_sec + offset) / 60;
+  // This minute can still go off when not checked and in its first 10 seconds
+  uint32_t first = minute + 1;
+  if ((minute > alarm_checked_minute) && (((now.tv_sec + offset) % 60) <= 9)) {
+    first = minute;
+  }
+  alarm_schedule_refresh(first);
+  schedule_store_refresh(first);
+  // First of the alarm slots, the sounds table and the alarm after sleep
+  if (alarm_schedule_next(&entry)) {
+    next = entry.when;
+  }
+  if (schedule_store_next(&when, &index) && (when < next)) {
+    next = when;
+  }
+  if (clock_settings.alarm_onoff && (next_alarm.hour < 24)) {
+    snooze = ((minute / (24 * 60)) * 24 * 60) + (next_alarm.hour * 60) + next_alarm.minute;
+    while (snooze < first) {
+      snooze += 24 * 60;
+    }
+    if (snooze < next) {
+      next = snooze;
+    }
+  }
+  if (next == SCHEDULE_NEVER) {
+    alarm_timer_minute = SCHEDULE_NEVER;
+    return;
+  }
+  if (next < first) {
+    // Missed. Not moved on yet. The next check does it
+    next = first;
+  }
+  alarm_timer_minute = next;
+  delay_us = ((((int64_t)next * 60) - offset - now.tv_sec) * 1000000) - now.tv_usec;
+  if (delay_us < 0) {
+    // The minute started already. Check straight away
+    delay_us = 0;
+  }
+  esp_timer_start_once(alarm_timer, delay_us);
+  ESP_LOGI(TAG, "Alarm timer set for %lld us", delay_us);
+}
+
+int alarm_timer_expired(void) {
+  struct timeval now;
+  struct tm now_tm;
+  int alarm = 0;
+  gettimeofday(&now, NULL);
+  // Not local_offset(). A change to or from summer time can be after the
+  // last minute tick.
+  localtime_patch(&now.tv_sec, &now_tm);
+  if ((alarm_timer_minute != SCHEDULE_NEVER) &&
+      (alarm_schedule_minute(&now_tm) >= alarm_timer_minute)) {
+    // Not early. Not moved back by a time correction
+    alarm_timer_check = true;
+    alarm = check_for_alarm(&now_tm);
+    alarm_timer_check = false;
+  }
+  alarm_timer_arm();
+  return alarm;
+}
+
+void alarm_get_onset_stats(alarm_onset_stats_t *alarm, alarm_onset_stats_t *sound) {
+  *alarm = onset_stats[0];
+  *sound = onset_stats[1];
+}
+
 void menu_noop(void) {
   // Sometimes we need to advance display event loop when nothing is in queue
   QueueHandle_t send_queue = display_task_queue();
-  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = noop};
+  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = noop,
+                                                 .time = esp_timer_get_time()};
   if (send_queue != 0) {
     // we do not check if the queue is full
     xQueueSendToBack(send_queue, &signal_to_send, 0);
@@ -425,7 +603,8 @@ void menu_timer_queue_send(TimerHandle_t notused) {
   // get queue for sending timer end signal
   QueueHandle_t send_queue = display_task_queue();
   // create event to send
-  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = timer_expired};
+  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = timer_expired,
+                                                 .time = esp_timer_get_time()};
   if (send_queue != 0) {
     // send event
     // we do not check if the queue is full
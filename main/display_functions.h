@@ -13,9 +13,17 @@
 #include "time.h"
 #include <sys/types.h>
 #include "freertos/timers.h"
+#include "max7219.h"
+#include "schedule_cron.h"
 
 #define MAX_SOUNDFILE_LENGTH 20  // max length of total string for file naam
 #define MAX_SOUNDFILES 20        // amount of filenames and date times allowed.
+// Level of the colon between hours and minutes with the grayscale display.
+// 1 is dimmed. Comment out for a colon as bright as the digits.
+#define CLOCK_COLON_LEVEL 1
+// Version of the recurrence below. 0 is settings stored before there
+// was a recurrence. Those are converted from the old fields.
+#define CLOCK_CRON_VERSION 1
 // Below is the name of the NVRAM var with the CLOCK settings
 #define NVFLASH_CLOCKBLOB "clock"
 
@@ -38,18 +46,31 @@ typedef struct {
   bool default_on;
   alarmsounds_t
       alarmsounds[MAX_SOUNDFILES];  // room for storing 20 sounds. We use [0] as default alarm
+  // When each alarmsounds entry goes off. At the end so settings stored
+  // before still load. The fields month, day and weekday above are only
+  // kept for the JSON API.
+  uint8_t cron_version;
+  schedule_cron_t cron[MAX_SOUNDFILES];
 } clock_settings_t;
 
 extern clock_settings_t clock_settings;
 
+// Settings of the chain of max7219s. Used on startup.
+extern max7219_config_t display_settings;
+
 // display the time on the display
 void time_sendto_display(void);
+// animate the changed digits from the time on the display to the current time.
+// Only when the time is on the display.
+void time_animate_to_display(void);
 // display the alarm time and setting on the display
 void alarm_sendto_display(void);
 // display the sleep timeout for adjusting
 void sleep_sendto_display(void);
 // display the current brightness setting for adjusting
 void brightness_sendto_display(void);
+// start scrolling IP address, temperature and alarm over the display
+void info_scroll_start(void);
 // Store settings to nvram. We do not store the settings straight away
 // This function should be called regulary
 void clock_store_nvram(int x);
@@ -61,7 +82,11 @@ void alarm_off(void);
 void alarm_add_sleep();
 // Is called to switch off alarm 
 void stop_alarm(void);
-// Below three functions adjust the settings
+// Set hour and minute of the alarm to the next time its cron goes off.
+// They stay when it never goes off.
+void alarm_time_from_cron(void);
+// Below three functions adjust the settings. By a signed amount of
+// encoder steps.
 void alarm_set_time(int adjustment);
 void sleep_set_time(int adjustment);
 void brightness_set(int adjustment);
@@ -71,6 +96,23 @@ void menu_noop(void);
 void menu_timer_queue_send(TimerHandle_t notused);
 // start timer 
 void menu_timer(u_int timer_timeout);
-// called each minute to check for alarm
-int check_for_alarm(void);
+// called each minute to check for alarm. With the local time to check
+int check_for_alarm(const struct tm *now);
+
+// Time from the start of the minute to the start of the sound
+typedef struct {
+  uint32_t count;
+  uint32_t timer;  // started by the alarm timer. Others by the minute tick
+  uint32_t us_last;
+  uint32_t us_avg;
+  uint32_t us_max;
+} alarm_onset_stats_t;
+
+// Set the one shot alarm timer for the second the next alarm or sound
+// goes off. After each check and after the clock is corrected.
+void alarm_timer_arm(void);
+// The alarm timer went off or the clock was corrected. Checks for alarm
+// when the time has come. Sets the timer again.
+int alarm_timer_expired(void);
+void alarm_get_onset_stats(alarm_onset_stats_t *alarm, alarm_onset_stats_t *sound);
 #endif
@@ -0,0 +1,146 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Scroll text smoothly over the display. See display_scroll.h
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Own files to include
+#include "app_queue.h"
+#include "display_scroll.h"
+#include "max7219.h"
+
+// Set logging tag per module
+static const char *TAG = "DisplayScroll";
+
+// Strip with the rendered text. 1 byte per column.
+static u_int8_t *strip = NULL;
+static int strip_length = 0;
+static int scroll_speed = SCROLL_SPEED;
+static int64_t scroll_start_us = 0;
+static esp_timer_handle_t scroll_timer = NULL;
+// Set by the timer. Cleared when the display task draws the frame
+static volatile bool frame_pending = false;
+static display_scroll_stats_t scroll_stats;
+
+// Runs in the esp_timer task. Only one frame signal is in the queue at a
+// time. Ticks while the display task did not draw the last frame are dropped.
+static void display_scroll_tick(void *arg) {
+  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = scroll_frame,
+                                                 .time = esp_timer_get_time()};
+  if (frame_pending) {
+    scroll_stats.frames_dropped++;
+    return;
+  }
+  frame_pending = true;
+  if (xQueueSendToBack(display_task_queue(), &signal_to_send, 0) != pdTRUE) {
+    frame_pending = false;
+    scroll_stats.frames_dropped++;
+  }
+}
+
+esp_err_t display_scroll_start(char *text, int cols_per_sec) {
+  int64_t render_start = esp_timer_get_time();
+  int length;
+  if ((cols_per_sec <= 0) || (cols_per_sec > SCROLL_MAX_SPEED)) {
+    ESP_LOGE(TAG, "Invalid scroll speed %d", cols_per_sec);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (strlen(text) > SCROLL_MAX_TEXT) {
+    ESP_LOGE(TAG, "Text too long to scroll");
+    return ESP_ERR_INVALID_ARG;
+  }
+  display_scroll_stop();
+  length = max7219_sprite_get_length(text);
+  if (length <= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  strip = malloc(length);
+  if (strip == NULL) {
+    ESP_LOGE(TAG, "No memory for scroll strip");
+    return ESP_ERR_NO_MEM;
+  }
+  // Only place where the font is used. Frames only copy columns.
+  strip_length = max7219_render_columns(text, strip, length);
+  scroll_speed = cols_per_sec;
+
+  if (scroll_timer == NULL) {
+    const esp_timer_create_args_t timer_args = {.callback = &display_scroll_tick,
+                                                .name = "scroll"};
+    if (esp_timer_create(&timer_args, &scroll_timer) != ESP_OK) {
+      ESP_LOGE(TAG, "Error in creating scroll timer");
+      display_scroll_stop();
+      return ESP_FAIL;
+    }
+  }
+  frame_pending = false;
+  scroll_start_us = esp_timer_get_time();
+  scroll_stats.scrolls++;
+  scroll_stats.render_us_last = (uint32_t)(scroll_start_us - render_start);
+  ESP_LOGI(TAG, "Scrolling %d columns at %d columns per second", strip_length, scroll_speed);
+  // One timer tick for each column
+  return esp_timer_start_periodic(scroll_timer, 1000000 / scroll_speed);
+}
+
+bool display_scroll_frame(void) {
+  int64_t frame_start = esp_timer_get_time();
+  uint32_t frame_us;
+  int width = max7219_get_width();
+  int offset;
+  frame_pending = false;
+  if (strip == NULL) {
+    return false;
+  }
+  // Columns scrolled since the start. Follows the clock.
+  offset = (int)(((frame_start - scroll_start_us) * scroll_speed) / 1000000);
+  if (offset > width + strip_length) {
+    display_scroll_stop();
+    return false;
+  }
+  max7219_empty_display_buffer();
+  max7219_sprite_fill_columns(strip, width - offset, strip_length);
+  max7219_send_display();
+
+  frame_us = (uint32_t)(esp_timer_get_time() - frame_start);
+  scroll_stats.frames++;
+  scroll_stats.frame_us_last = frame_us;
+  if (frame_us > scroll_stats.frame_us_max) {
+    scroll_stats.frame_us_max = frame_us;
+  }
+  if (scroll_stats.frame_us_avg == 0) {
+    scroll_stats.frame_us_avg = frame_us;
+  } else {
+    scroll_stats.frame_us_avg = ((scroll_stats.frame_us_avg * 7) + frame_us) / 8;
+  }
+  return true;
+}
+
+void display_scroll_stop(void) {
+  if (scroll_timer != NULL) {
+    esp_timer_stop(scroll_timer);
+  }
+  if (strip != NULL) {
+    free(strip);
+    strip = NULL;
+  }
+  strip_length = 0;
+}
+
+bool display_scroll_active(void) {
+  return (strip != NULL);
+}
+
+void display_scroll_get_stats(display_scroll_stats_t *stats) {
+  *stats = scroll_stats;
+}
@@ -0,0 +1,53 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef DISPLAY_SCROLL_H_
+#define DISPLAY_SCROLL_H_
+
+// Smooth scrolling of text over the display. The text is rendered once
+// into a strip of columns. An esp_timer asks the display task for a new
+// frame. Each frame only copies a window of the strip into the display
+// buffer. The position follows the time, not the amount of frames. So a
+// late frame skips columns and the speed stays the same.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SCROLL_SPEED 24          // default columns per second
+#define SCROLL_MAX_SPEED 200     // timer period not below 5ms
+#define SCROLL_MAX_TEXT 160      // max length of the text to scroll
+
+// Frame timing of the scroller. Times in microseconds.
+typedef struct {
+  uint32_t scrolls;         // texts scrolled
+  uint32_t frames;          // frames drawn
+  uint32_t frames_dropped;  // timer ticks without a frame. Display task was busy
+  uint32_t frame_us_last;   // CPU time to draw and send a frame
+  uint32_t frame_us_max;
+  uint32_t frame_us_avg;    // running average over the last frames
+  uint32_t render_us_last;  // time to render the text into the strip
+} display_scroll_stats_t;
+
+// Render the text and start scrolling it from the right side of the display
+// into the left side. Speed in columns per second.
+esp_err_t display_scroll_start(char *text, int cols_per_sec);
+
+// Draw the frame for the current time and send it to the display. Called
+// by the display task on the scroll_frame signal. Returns false when the
+// text has left the display and the scroll is finished.
+bool display_scroll_frame(void);
+
+// Stop scrolling and release the strip
+void display_scroll_stop(void);
+
+// True while a text is being scrolled
+bool display_scroll_active(void);
+
+// Copy of the scroll timing counters
+void display_scroll_get_stats(display_scroll_stats_t *stats);
+
+#endif
@@ -0,0 +1,84 @@
+// 8x8 bitmap glyphs above ASCII. Same layout as font_terminal.h
+// First byte is width used in bitmap. Remaining is bitmap. Each byte is
+// one column. Bit 0 is the top row. The unicode code point of each glyph
+// is in the comment as U+XXXX. Glyphs must be sorted on code point.
+// Added to all fonts by tools/fontgen.py
+#include <sys/types.h>
+
+const u_int8_t font_8x8_extra[][9] = {
+    {0x01, 0x7D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00A1 inverted exclamation
+    {0x05, 0x48, 0x7E, 0x49, 0x49, 0x62, 0x00, 0x00, 0x00}, // U+00A3 pound
+    {0x05, 0x10, 0x28, 0x54, 0x28, 0x44, 0x00, 0x00, 0x00}, // U+00AB left guillemet
+    {0x04, 0x06, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00, 0x00}, // U+00B0 degree
+    {0x05, 0x44, 0x44, 0x5F, 0x44, 0x44, 0x00, 0x00, 0x00}, // U+00B1 plus minus
+    {0x03, 0x09, 0x0D, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00B2 superscript two
+    {0x03, 0x09, 0x0B, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00B3 superscript three
+    {0x04, 0xFC, 0x40, 0x40, 0x3C, 0x00, 0x00, 0x00, 0x00}, // U+00B5 micro
+    {0x01, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00B7 middle dot
+    {0x05, 0x44, 0x28, 0x54, 0x28, 0x10, 0x00, 0x00, 0x00}, // U+00BB right guillemet
+    {0x05, 0x30, 0x48, 0x4D, 0x40, 0x20, 0x00, 0x00, 0x00}, // U+00BF inverted question
+    {0x05, 0xF8, 0x25, 0x26, 0x24, 0xF8, 0x00, 0x00, 0x00}, // U+00C0 A grave
+    {0x05, 0xF8, 0x24, 0x26, 0x25, 0xF8, 0x00, 0x00, 0x00}, // U+00C1 A acute
+    {0x05, 0xF8, 0x26, 0x25, 0x26, 0xF8, 0x00, 0x00, 0x00}, // U+00C2 A circ
+    {0x05, 0xFA, 0x25, 0x26, 0x25, 0xF8, 0x00, 0x00, 0x00}, // U+00C3 A tilde
+    {0x05, 0xF9, 0x24, 0x24, 0x24, 0xF9, 0x00, 0x00, 0x00}, // U+00C4 A diaer
+    {0x05, 0xF8, 0x27, 0x25, 0x27, 0xF8, 0x00, 0x00, 0x00}, // U+00C5 A ring
+    {0x05, 0x3E, 0x41, 0xC1, 0x41, 0x22, 0x00, 0x00, 0x00}, // U+00C7 C cedilla
+    {0x05, 0xFC, 0xA5, 0xA6, 0xA4, 0x84, 0x00, 0x00, 0x00}, // U+00C8 E grave
+    {0x05, 0xFC, 0xA4, 0xA6, 0xA5, 0x84, 0x00, 0x00, 0x00}, // U+00C9 E acute
+    {0x05, 0xFC, 0xA6, 0xA5, 0xA6, 0x84, 0x00, 0x00, 0x00}, // U+00CA E circ
+    {0x05, 0xFD, 0xA4, 0xA4, 0xA4, 0x85, 0x00, 0x00, 0x00}, // U+00CB E diaer
+    {0x03, 0x85, 0xFE, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00CC I grave
+    {0x03, 0x84, 0xFE, 0x85, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00CD I acute
+    {0x03, 0x86, 0xFD, 0x86, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00CE I circ
+    {0x03, 0x85, 0xFC, 0x85, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00CF I diaer
+    {0x05, 0xFE, 0x09, 0x12, 0x21, 0xFC, 0x00, 0x00, 0x00}, // U+00D1 N tilde
+    {0x05, 0x78, 0x85, 0x86, 0x84, 0x78, 0x00, 0x00, 0x00}, // U+00D2 O grave
+    {0x05, 0x78, 0x84, 0x86, 0x85, 0x78, 0x00, 0x00, 0x00}, // U+00D3 O acute
+    {0x05, 0x78, 0x86, 0x85, 0x86, 0x78, 0x00, 0x00, 0x00}, // U+00D4 O circ
+    {0x05, 0x7A, 0x85, 0x86, 0x85, 0x78, 0x00, 0x00, 0x00}, // U+00D5 O tilde
+    {0x05, 0x79, 0x84, 0x84, 0x84, 0x79, 0x00, 0x00, 0x00}, // U+00D6 O diaer
+    {0x05, 0x22, 0x14, 0x08, 0x14, 0x22, 0x00, 0x00, 0x00}, // U+00D7 multiplication
+    {0x05, 0x7E, 0x71, 0x49, 0x47, 0x3F, 0x00, 0x00, 0x00}, // U+00D8 O stroke
+    {0x05, 0x7C, 0x81, 0x82, 0x80, 0x7C, 0x00, 0x00, 0x00}, // U+00D9 U grave
+    {0x05, 0x7C, 0x80, 0x82, 0x81, 0x7C, 0x00, 0x00, 0x00}, // U+00DA U acute
+    {0x05, 0x7C, 0x82, 0x81, 0x82, 0x7C, 0x00, 0x00, 0x00}, // U+00DB U circ
+    {0x05, 0x7D, 0x80, 0x80, 0x80, 0x7D, 0x00, 0x00, 0x00}, // U+00DC U diaer
+    {0x05, 0x1C, 0x20, 0xC2, 0x21, 0x1C, 0x00, 0x00, 0x00}, // U+00DD Y acute
+    {0x04, 0x7E, 0x01, 0x4D, 0x3A, 0x00, 0x00, 0x00, 0x00}, // U+00DF sharp s
+    {0x05, 0x20, 0x55, 0x56, 0x54, 0x78, 0x00, 0x00, 0x00}, // U+00E0 a grave
+    {0x05, 0x20, 0x54, 0x56, 0x55, 0x78, 0x00, 0x00, 0x00}, // U+00E1 a acute
+    {0x05, 0x20, 0x56, 0x55, 0x56, 0x78, 0x00, 0x00, 0x00}, // U+00E2 a circ
+    {0x05, 0x22, 0x55, 0x56, 0x55, 0x78, 0x00, 0x00, 0x00}, // U+00E3 a tilde
+    {0x05, 0x21, 0x54, 0x54, 0x54, 0x79, 0x00, 0x00, 0x00}, // U+00E4 a diaer
+    {0x05, 0x20, 0x57, 0x55, 0x57, 0x78, 0x00, 0x00, 0x00}, // U+00E5 a ring
+    {0x05, 0x38, 0x44, 0xC4, 0x44, 0x28, 0x00, 0x00, 0x00}, // U+00E7 c cedilla
+    {0x04, 0x39, 0x56, 0x54, 0x54, 0x00, 0x00, 0x00, 0x00}, // U+00E8 e grave
+    {0x04, 0x38, 0x56, 0x55, 0x54, 0x00, 0x00, 0x00, 0x00}, // U+00E9 e acute
+    {0x04, 0x3A, 0x55, 0x56, 0x54, 0x00, 0x00, 0x00, 0x00}, // U+00EA e circ
+    {0x04, 0x39, 0x54, 0x54, 0x55, 0x00, 0x00, 0x00, 0x00}, // U+00EB e diaer
+    {0x03, 0x01, 0x7E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00EC i grave
+    {0x03, 0x00, 0x7E, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00ED i acute
+    {0x03, 0x02, 0x7D, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00EE i circ
+    {0x03, 0x01, 0x7C, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}, // U+00EF i diaer
+    {0x04, 0x7E, 0x05, 0x06, 0x79, 0x00, 0x00, 0x00, 0x00}, // U+00F1 n tilde
+    {0x05, 0x38, 0x45, 0x46, 0x44, 0x38, 0x00, 0x00, 0x00}, // U+00F2 o grave
+    {0x05, 0x38, 0x44, 0x46, 0x45, 0x38, 0x00, 0x00, 0x00}, // U+00F3 o acute
+    {0x05, 0x38, 0x46, 0x45, 0x46, 0x38, 0x00, 0x00, 0x00}, // U+00F4 o circ
+    {0x05, 0x3A, 0x45, 0x46, 0x45, 0x38, 0x00, 0x00, 0x00}, // U+00F5 o tilde
+    {0x05, 0x39, 0x44, 0x44, 0x44, 0x39, 0x00, 0x00, 0x00}, // U+00F6 o diaer
+    {0x05, 0x08, 0x08, 0x2A, 0x08, 0x08, 0x00, 0x00, 0x00}, // U+00F7 division
+    {0x05, 0x78, 0x64, 0x54, 0x4C, 0x3C, 0x00, 0x00, 0x00}, // U+00F8 o stroke
+    {0x04, 0x3D, 0x42, 0x40, 0x7C, 0x00, 0x00, 0x00, 0x00}, // U+00F9 u grave
+    {0x04, 0x3C, 0x42, 0x41, 0x7C, 0x00, 0x00, 0x00, 0x00}, // U+00FA u acute
+    {0x04, 0x3E, 0x41, 0x42, 0x7C, 0x00, 0x00, 0x00, 0x00}, // U+00FB u circ
+    {0x04, 0x3D, 0x40, 0x40, 0x7D, 0x00, 0x00, 0x00, 0x00}, // U+00FC u diaer
+    {0x04, 0x9C, 0xA2, 0x61, 0x3C, 0x00, 0x00, 0x00, 0x00}, // U+00FD y acute
+    {0x04, 0x9D, 0xA0, 0x60, 0x3D, 0x00, 0x00, 0x00, 0x00}, // U+00FF y diaeresis
+    {0x05, 0x14, 0x3E, 0x55, 0x55, 0x41, 0x00, 0x00, 0x00}, // U+20AC euro
+    {0x05, 0x08, 0x1C, 0x2A, 0x08, 0x08, 0x00, 0x00, 0x00}, // U+2190 arrow left
+    {0x05, 0x04, 0x02, 0x7F, 0x02, 0x04, 0x00, 0x00, 0x00}, // U+2191 arrow up
+    {0x05, 0x08, 0x08, 0x2A, 0x1C, 0x08, 0x00, 0x00, 0x00}, // U+2192 arrow right
+    {0x05, 0x10, 0x20, 0x7F, 0x20, 0x10, 0x00, 0x00, 0x00}, // U+2193 arrow down
+    {0x05, 0x7D, 0x7E, 0x2E, 0x76, 0x79, 0x00, 0x00, 0x00}, // U+FFFD replacement
+};
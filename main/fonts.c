@@ -0,0 +1,147 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Packed fonts and font selection. See fonts.h
+#include <string.h>
+#include <sys/types.h>
+
+#include "esp_log.h"
+
+// Own files to include
+#include "fonts.h"
+// Generated at build time by tools/fontgen.py from font_terminal.h and
+// font_noto.h
+#include "font_terminal_packed.h"
+#include "font_noto_packed.h"
+
+// Set logging tag per module
+static const char *TAG = "Fonts";
+
+// All fonts which can be selected. The first one is the default
+static const font_t *const fonts[] = {&font_terminal, &font_noto};
+static const font_t *font = &font_terminal;
+static int font_nr = 0;
+
+int fonts_select(int font_select) {
+  if ((font_select < 0) || (font_select >= fonts_count())) {
+    ESP_LOGE(TAG, "Font %d does not exist", font_select);
+    return -1;
+  }
+  font_nr = font_select;
+  font = fonts[font_nr];
+  ESP_LOGI(TAG, "Font %s selected", font->name);
+  return font_nr;
+}
+
+int fonts_selected(void) {
+  return font_nr;
+}
+
+int fonts_find(const char *name) {
+  int x;
+  for (x = 0; x < fonts_count(); x++) {
+    if (strcmp(fonts[x]->name, name) == 0) {
+      return x;
+    }
+  }
+  return -1;
+}
+
+int fonts_count(void) {
+  return sizeof(fonts) / sizeof(fonts[0]);
+}
+
+const font_t *fonts_get(int font_get) {
+  if ((font_get < 0) || (font_get >= fonts_count())) {
+    return NULL;
+  }
+  return fonts[font_get];
+}
+
+int fonts_glyph(uint32_t character, const u_int8_t **columns) {
+  uint16_t entry;
+  int low;
+  int high;
+  int middle;
+  if (character < font->count) {
+    // ASCII. Direct from the index
+    entry = font->index[character];
+  } else {
+    // Binary search in the sorted code points of the extra glyphs
+    low = 0;
+    high = font->extra_count - 1;
+    while (low <= high) {
+      middle = (low + high) / 2;
+      if (font->codepoints[middle] < character) {
+        low = middle + 1;
+      } else if (font->codepoints[middle] > character) {
+        high = middle - 1;
+      } else {
+        break;
+      }
+    }
+    if (low > high) {
+      return -1;
+    }
+    entry = font->index[font->count + middle];
+  }
+  *columns = &font->columns[FONT_GLYPH_OFFSET(entry)];
+  return FONT_GLYPH_WIDTH(entry);
+}
+
+uint32_t fonts_utf8_next(const char **text) {
+  const uint8_t *next = (const uint8_t *)*text;
+  uint32_t character;
+  uint8_t low = 0x80;
+  uint8_t high = 0xBF;
+  int follow;
+  int x;
+  // Most strings are ASCII
+  if (next[0] < 0x80) {
+    *text += 1;
+    return next[0];
+  }
+  // C0 and C1 only start overlong sequences. Above F4 is above U+10FFFF.
+  // The range of the second byte leaves out overlong sequences and the
+  // UTF-16 surrogates U+D800 to U+DFFF.
+  if ((next[0] >= 0xC2) && (next[0] <= 0xDF)) {
+    character = next[0] & 0x1F;
+    follow = 1;
+  } else if ((next[0] >= 0xE0) && (next[0] <= 0xEF)) {
+    character = next[0] & 0x0F;
+    follow = 2;
+    if (next[0] == 0xE0) {
+      low = 0xA0;
+    } else if (next[0] == 0xED) {
+      high = 0x9F;
+    }
+  } else if ((next[0] >= 0xF0) && (next[0] <= 0xF4)) {
+    character = next[0] & 0x07;
+    follow = 3;
+    if (next[0] == 0xF0) {
+      low = 0x90;
+    } else if (next[0] == 0xF4) {
+      high = 0x8F;
+    }
+  } else {
+    // Not a start byte
+    *text += 1;
+    return FONTS_INVALID_CHAR;
+  }
+  for (x = 1; x <= follow; x++) {
+    if ((next[x] < low) || (next[x] > high)) {
+      // Sequence cut short. Also stops on the end of the string. The wrong
+      // byte starts the next character.
+      *text += x;
+      return FONTS_INVALID_CHAR;
+    }
+    character = (character << 6) | (next[x] & 0x3F);
+    low = 0x80;
+    high = 0xBF;
+  }
+  *text += follow + 1;
+  return character;
+}
@@ -0,0 +1,65 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef FONTS_H_
+#define FONTS_H_
+
+// Access to the packed fonts. The packed fonts are generated at build time
+// by tools/fontgen.py from the font header files. Each glyph is a number
+// of columns. 1 byte per column. Bit 0 is the top row.
+// Strings are UTF-8. ASCII glyphs are looked up directly. The glyphs above
+// ASCII (font_extra.h) are found with a binary search on their code point.
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define FONTS_NAME_LENGTH 16  // longest font name + 1
+
+// Packed font. Index entry per glyph is offset << 4 | width.
+// The first count entries are ASCII. Then extra_count entries with their
+// code point in the sorted codepoints table.
+typedef struct {
+  const char *name;
+  uint16_t count;           // ASCII glyphs in the index
+  const u_int8_t *columns;  // columns of all glyphs
+  const uint16_t *index;
+  uint16_t extra_count;     // glyphs above ASCII
+  const uint16_t *codepoints;
+  uint16_t packed_bytes;    // flash used by columns and index
+  uint16_t table_bytes;     // flash the old font_8x8[][9] table used
+} font_t;
+
+#define FONT_GLYPH_WIDTH(entry) ((entry) & 0x0f)
+#define FONT_GLYPH_OFFSET(entry) ((entry) >> 4)
+
+// Select the font used for drawing. Returns -1 when the font does not exist
+int fonts_select(int font);
+
+// Number of the selected font
+int fonts_selected(void);
+
+// Number of the font with this name. -1 when not found
+int fonts_find(const char *name);
+
+// Amount of fonts available
+int fonts_count(void);
+
+// The font. NULL when it does not exist. For names and the flash report
+const font_t *fonts_get(int font);
+
+// Get the columns of a glyph of the selected font. Returns the width.
+// Returns -1 when the font has no glyph for the character.
+int fonts_glyph(uint32_t character, const u_int8_t **columns);
+
+// Decode the next character of an UTF-8 string and advance the string
+// pointer. Returns the unicode code point. Invalid UTF-8 returns
+// FONTS_INVALID_CHAR for each wrong byte. Also overlong sequences and
+// the UTF-16 surrogates. All fonts have a glyph for it.
+uint32_t fonts_utf8_next(const char **text);
+
+#define FONTS_INVALID_CHAR 0xFFFD
+
+#endif
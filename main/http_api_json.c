@@ -22,9 +22,13 @@
 #include "defaults_globals.h"
 #include "http_api_json.h"
 #include "http_post.h"
+#include "json_brightness.h"
 #include "json_clock.h"
+#include "json_display.h"
 #include "json_files.h"
+#include "json_metrics.h"
 #include "json_network.h"
+#include "json_schedule.h"
 #include "json_wavs.h"
 #include "json_time.h"
 #include "webserver.h"
@@ -154,6 +158,33 @@ esp_err_t json_api_post_handler(httpd_req_t *req) {
       ESP_LOGI(TAG, "HTTP POST request ClockSet");
       error_to_return = json_clock_set(receive_json, return_json);
     }
+
+    // Brightness curve read
+    if (strcmp(request_type->valuestring, "BrightnessRead") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request BrightnessRead");
+      error_to_return = json_brightness_read(receive_json, return_json);
+    }
+
+    // Display settings read
+    if (strcmp(request_type->valuestring, "DisplayRead") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request DisplayRead");
+      error_to_return = json_display_read(receive_json, return_json);
+    }
+    // Display settings set
+    if (strcmp(request_type->valuestring, "DisplaySet") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request DisplaySet");
+      error_to_return = json_display_set(receive_json, return_json);
+    }
+    // Image on the display
+    if (strcmp(request_type->valuestring, "DisplayImage") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request DisplayImage");
+      error_to_return = json_display_image(receive_json, return_json);
+    }
+    // Recent display state changes
+    if (strcmp(request_type->valuestring, "DisplayTrace") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request DisplayTrace");
+      error_to_return = json_display_trace(receive_json, return_json);
+    }
     
     // Time read
     if (strcmp(request_type->valuestring, "TimeRead") == 0) {
@@ -166,6 +197,16 @@ esp_err_t json_api_post_handler(httpd_req_t *req) {
       error_to_return = json_time_set(receive_json, return_json);
     }
 
+    // Sounds table. Paged
+    if (strcmp(request_type->valuestring, "ScheduleRead") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request ScheduleRead");
+      error_to_return = json_schedule_read(receive_json, return_json);
+    }
+    if (strcmp(request_type->valuestring, "ScheduleWrite") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request ScheduleWrite");
+      error_to_return = json_schedule_write(receive_json, return_json);
+    }
+
     // Directory listing
     if (strcmp(request_type->valuestring, "FileList") == 0) {
       ESP_LOGI(TAG, "HTTP POST request FileList");
@@ -184,6 +225,12 @@ esp_err_t json_api_post_handler(httpd_req_t *req) {
       error_to_return = json_file_delete(receive_json, return_json);
     }
 
+    // Performance counters read
+    if (strcmp(request_type->valuestring, "MetricsRead") == 0) {
+      ESP_LOGI(TAG, "HTTP POST request MetricsRead");
+      error_to_return = json_metrics_read(receive_json, return_json);
+    }
+
     // If error to return is still -1 than no valid subroutine is found
     if (error_to_return == -1) {
       error_to_return = 400;
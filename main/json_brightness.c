@@ -0,0 +1,76 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// For reading the brightness curve as json.
+#include <string.h>
+#include <sys/param.h>
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "sdkconfig.h"
+
+// Own header files
+#include "display_brightness.h"
+#include "display_functions.h"
+#include "http_api_json.h"
+#include "json_brightness.h"
+#include "time_task.h"
+
+// Set logging tag per module
+static const char *TAG = "JsonBrightness";
+
+int json_brightness_read(cJSON *receive_json, cJSON *return_json) {
+  int yday = current_timeinfo.tm_yday;
+  int step_minutes = 15;
+  int levels[BRIGHT_CURVE_MAX_POINTS];
+  int count;
+  int x;
+  brightness_sun_t sun;
+  cJSON *temp_object = NULL;
+  cJSON *curve = NULL;
+  ESP_LOGI(TAG, "JSON Brightness Read start");
+  // Both settings are optional
+  temp_object = cJSON_GetObjectItemCaseSensitive(receive_json, "yday");
+  if ((temp_object != NULL) && cJSON_IsNumber(temp_object)) {
+    if ((temp_object->valueint >= 0) && (temp_object->valueint <= 365)) {
+      yday = temp_object->valueint;
+    } else {
+      ESP_LOGE(TAG, "JSON invalid yday");
+      return 400;
+    }
+  }
+  temp_object = cJSON_GetObjectItemCaseSensitive(receive_json, "step_minutes");
+  if ((temp_object != NULL) && cJSON_IsNumber(temp_object)) {
+    if ((temp_object->valueint >= (24 * 60) / BRIGHT_CURVE_MAX_POINTS) &&
+        (temp_object->valueint <= 24 * 60)) {
+      step_minutes = temp_object->valueint;
+    } else {
+      ESP_LOGE(TAG, "JSON invalid step_minutes");
+      return 400;
+    }
+  }
+  brightness_sun(yday, &sun);
+  cJSON_AddNumberToObject(return_json, "setting", clock_settings.brightness);
+  cJSON_AddNumberToObject(return_json, "current", brightness_ramp_current());
+  cJSON_AddNumberToObject(return_json, "ramp_steps", brightness_ramp_steps());
+  cJSON_AddNumberToObject(return_json, "yday", yday);
+  // Minutes after midnight. Standard time
+  cJSON_AddNumberToObject(return_json, "sun_up", sun.sun_up);
+  cJSON_AddNumberToObject(return_json, "sun_down", sun.sun_down);
+  cJSON_AddNumberToObject(return_json, "step_minutes", step_minutes);
+  curve = cJSON_AddArrayToObject(return_json, "curve");
+  if (curve == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  count = brightness_curve(yday, step_minutes, levels, BRIGHT_CURVE_MAX_POINTS);
+  for (x = 0; x < count; x++) {
+    cJSON_AddItemToArray(curve, cJSON_CreateNumber(levels[x]));
+  }
+  return 0;
+}
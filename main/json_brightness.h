@@ -0,0 +1,17 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef JSON_BRIGHTNESS_H_
+#define JSON_BRIGHTNESS_H_
+
+#include "cJSON.h"
+
+// Returns the brightness curve for a day in JSON. With sun up, sun down
+// and the brightness the display has now. Optional "yday" (day of the
+// year, 0 is januari 1st. Default today) and "step_minutes" (default 15).
+int json_brightness_read(cJSON *receive_json, cJSON *return_json);
+
+#endif
@@ -15,10 +15,12 @@
 #include "sdkconfig.h"
 
 // Own header files
+#include "alarm_schedule.h"
 #include "defaults_globals.h"
 #include "display_functions.h"
 #include "http_api_json.h"
 #include "max7219.h"  //needed for max brightness
+#include "schedule_cron.h"
 
 // Set logging tag per module
 static const char *TAG = "JsonClockSet";
@@ -31,6 +33,9 @@ int json_clock_set(cJSON *receive_json, cJSON *return_json) {
   memcpy(temp_settings, &clock_settings, sizeof(clock_settings_t));
   // next var is used to count the correct number of good values received
   int return_count = 0;
+  // Alarms with a cron text. The others get it from the old fields
+  bool cron_given[MAX_SOUNDFILES] = {false};
+  bool cron_error = false;
   // Start parsing the JSON object with the clock settings
   // First var
   cJSON *temp_object = NULL;
@@ -183,15 +188,37 @@ int json_clock_set(cJSON *receive_json, cJSON *return_json) {
         }
       }
 
+      // Optional. When the alarm goes off as cron text. Not counted
+      temp_object = NULL;
+      temp_object = cJSON_GetObjectItemCaseSensitive(alarm_item, "cron");
+      if ((temp_object != NULL) && cJSON_IsString(temp_object)) {
+        if (schedule_cron_parse(temp_object->valuestring, &temp_settings->cron[x]) == ESP_OK) {
+          cron_given[x] = true;
+        } else {
+          ESP_LOGE(TAG, "JSON invalid array item cron %s", temp_object->valuestring);
+          cron_error = true;
+        }
+      }
+
       // advance one array up in the clock settings struct
       x++;
     }
   }
 
   // We counted the amount of JSON objects returned. Check if correct
-  if (return_count == 4 + (7 * MAX_SOUNDFILES)) {
+  if ((return_count == 4 + (7 * MAX_SOUNDFILES)) && !cron_error) {
     ESP_LOGI(TAG, "Storing %d returned items ", return_count);
     memcpy(&clock_settings, temp_settings, sizeof(clock_settings_t));
+    for (int x = 0; x < MAX_SOUNDFILES; x++) {
+      if (!cron_given[x]) {
+        alarm_schedule_from_fields(x);
+      }
+    }
+    // The alarm display shows the old fields
+    if (cron_given[0]) {
+      alarm_time_from_cron();
+    }
+    alarm_schedule_changed();
     // store in nvram after a short while
     clock_store_nvram(1);
     free(temp_settings);
@@ -229,6 +256,7 @@ int json_clock_read(cJSON *receive_json, cJSON *return_json) {
   }
   int x = 0;
   cJSON *alarm_item;
+  char cron_text[CRON_TEXT_LENGTH];
   for (x = 0; x < MAX_SOUNDFILES; x++) {
     // create internal placeholder for alarm object
     alarm_item = NULL;
@@ -250,8 +278,28 @@ int json_clock_read(cJSON *receive_json, cJSON *return_json) {
       cJSON_AddBoolToObject(alarm_item, "is_alarm", 0);
     }
     cJSON_AddStringToObject(alarm_item, "sound", clock_settings.alarmsounds[x].soundfile);
+    // When it goes off
+    schedule_cron_format(&clock_settings.cron[x], cron_text, sizeof(cron_text));
+    cJSON_AddStringToObject(alarm_item, "cron", cron_text);
     // We created the fields in this array item. Add array item to array
     cJSON_AddItemToArray(alarms, alarm_item);
   }
+  // The first alarm or sound to go off. Local time
+  schedule_entry_t next;
+  struct tm next_tm;
+  char next_text[20];
+  if (alarm_schedule_next(&next)) {
+    cJSON *next_item = cJSON_AddObjectToObject(return_json, "next_event");
+    if (next_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 400;
+    }
+    alarm_schedule_to_tm(next.when, &next_tm);
+    strftime(next_text, sizeof(next_text), "%Y-%m-%d %H:%M", &next_tm);
+    cJSON_AddStringToObject(next_item, "time", next_text);
+    cJSON_AddNumberToObject(next_item, "slot", next.slot);
+    cJSON_AddStringToObject(next_item, "sound", clock_settings.alarmsounds[next.slot].soundfile);
+    cJSON_AddBoolToObject(next_item, "is_alarm", next.slot == 0);
+  }
   return 0;
 }
@@ -0,0 +1,239 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// For moving the display chain settings to and from json.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+// Own header files
+#include "defaults_globals.h"
+#include "display_clock.h"
+#include "display_functions.h"
+#include "fonts.h"
+#include "http_api_json.h"
+#include "json_display.h"
+#include "max7219.h"
+#include "nvramfunctions.h"
+
+// Set logging tag per module
+static const char *TAG = "JsonDisplay";
+
+int json_display_set(cJSON *receive_json, cJSON *return_json) {
+  // Make a copy of display_settings to store all new settings temporary
+  max7219_config_t temp_settings;
+  memcpy(&temp_settings, &display_settings, sizeof(max7219_config_t));
+  // next var is used to count the correct number of good values received
+  int return_count = 0;
+  cJSON *temp_object = NULL;
+  temp_object = cJSON_GetObjectItemCaseSensitive(receive_json, "count");
+  if ((temp_object != NULL) && cJSON_IsNumber(temp_object)) {
+    // Found JSON object
+    if ((temp_object->valueint > 0) && (temp_object->valueint <= MAX7219_MAX_COUNT)) {
+      temp_settings.count = temp_object->valueint;
+      return_count++;
+    } else {
+      ESP_LOGE(TAG, "JSON invalid count");
+    }
+  }
+  // next-var
+  temp_object = NULL;
+  temp_object = cJSON_GetObjectItemCaseSensitive(receive_json, "rotate90");
+  if ((temp_object != NULL) && cJSON_IsBool(temp_object)) {
+    temp_settings.rotate90 = cJSON_IsTrue(temp_object);
+    return_count++;
+  } else {
+    ESP_LOGE(TAG, "JSON invalid rotate90");
+  }
+  // next-var
+  temp_object = NULL;
+  temp_object = cJSON_GetObjectItemCaseSensitive(receive_json, "reverse");
+  if ((temp_object != NULL) && cJSON_IsBool(temp_object)) {
+    temp_settings.reverse = cJSON_IsTrue(temp_object);
+    return_count++;
+  } else {
+    ESP_LOGE(TAG, "JSON invalid reverse");
+  }
+
+  // next-var. The font is optional and used straight away
+  int font = -1;
+  temp_object = NULL;
+  temp_object = cJSON_GetObjectItemCaseSensitive(receive_json, "font");
+  if (temp_object != NULL) {
+    if (cJSON_IsString(temp_object) && (strlen(temp_object->valuestring) < FONTS_NAME_LENGTH)) {
+      font = fonts_find(temp_object->valuestring);
+    }
+    if (font < 0) {
+      ESP_LOGE(TAG, "JSON invalid font");
+      return 400;
+    }
+    strcpy(temp_settings.font, temp_object->valuestring);
+  }
+
+  // We counted the amount of JSON objects returned. Check if correct
+  if (return_count == 3) {
+    ESP_LOGI(TAG, "Storing display settings. Used after restart");
+    memcpy(&display_settings, &temp_settings, sizeof(max7219_config_t));
+    if (font >= 0) {
+      fonts_select(font);
+    }
+    write_nvram(&display_settings, sizeof(max7219_config_t), NVFLASH_DISPLAYBLOB);
+    cJSON_AddStringToObject(return_json, "message", "Display settings are used after a restart");
+    return 0;
+  }
+  ESP_LOGI(TAG, "Return items %d do not match", return_count);
+  return 400;
+}
+
+int json_display_read(cJSON *receive_json, cJSON *return_json) {
+  // we do not use the received json object. Only
+  // put values in the return JSON
+  max7219_config_t active;
+  const font_t *font;
+  cJSON *fonts = NULL;
+  cJSON *font_item = NULL;
+  int x;
+  ESP_LOGI(TAG, "JSON Display Read settings start");
+  cJSON_AddNumberToObject(return_json, "count", display_settings.count);
+  cJSON_AddBoolToObject(return_json, "rotate90", display_settings.rotate90);
+  cJSON_AddBoolToObject(return_json, "reverse", display_settings.reverse);
+  cJSON_AddNumberToObject(return_json, "max_count", MAX7219_MAX_COUNT);
+  // Settings can differ from the ones in use until a restart
+  max7219_get_config(&active);
+  cJSON_AddNumberToObject(return_json, "active_count", active.count);
+  cJSON_AddNumberToObject(return_json, "active_columns", max7219_get_width());
+  // Fonts to choose from. With the flash they use
+  cJSON_AddStringToObject(return_json, "font", fonts_get(fonts_selected())->name);
+  fonts = cJSON_AddArrayToObject(return_json, "fonts");
+  if (fonts == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  for (x = 0; x < fonts_count(); x++) {
+    font = fonts_get(x);
+    font_item = cJSON_CreateObject();
+    if (font_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 400;
+    }
+    cJSON_AddStringToObject(font_item, "name", font->name);
+    cJSON_AddNumberToObject(font_item, "glyphs", font->count + font->extra_count);
+    cJSON_AddNumberToObject(font_item, "packed_bytes", font->packed_bytes);
+    cJSON_AddNumberToObject(font_item, "table_bytes", font->table_bytes);
+    cJSON_AddItemToArray(fonts, font_item);
+  }
+  return 0;
+}
+
+int json_display_image(cJSON *receive_json, cJSON *return_json) {
+  // we do not use the received json object. Only
+  // put values in the return JSON
+  int width = max7219_get_width();
+  u_int8_t *image = NULL;
+  u_int8_t *buffer = NULL;
+  char *text = NULL;
+  cJSON *rows = NULL;
+  int pbm_length;
+  int length;
+  int row;
+  int x;
+  int ret = 0;
+  ESP_LOGI(TAG, "JSON Display Image start");
+  image = malloc(width);
+  buffer = malloc(width);
+  // PBM header, and each row with a newline
+  pbm_length = 16 + (MAX7219_COLUMNS * (width + 1));
+  text = malloc(pbm_length);
+  if ((image == NULL) || (buffer == NULL) || (text == NULL)) {
+    ESP_LOGE(TAG, "No memory for the display image");
+    ret = 400;
+  } else if (max7219_get_image(image) != ESP_OK) {
+    ESP_LOGE(TAG, "Nothing on the display yet. Or a grayscale frame");
+    ret = 400;
+  } else {
+    cJSON_AddNumberToObject(return_json, "width", width);
+    cJSON_AddNumberToObject(return_json, "height", MAX7219_COLUMNS);
+    // The drawn frame should be on the display
+    max7219_get_columns(buffer);
+    cJSON_AddBoolToObject(return_json, "buffer_match", memcmp(image, buffer, width) == 0);
+    rows = cJSON_AddArrayToObject(return_json, "rows");
+    if (rows == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      ret = 400;
+    } else {
+      // Bit 0 of each column is the top row
+      for (row = 0; row < MAX7219_COLUMNS; row++) {
+        for (x = 0; x < width; x++) {
+          text[x] = (image[x] & (1 << row)) ? '#' : '.';
+        }
+        text[width] = 0;
+        cJSON_AddItemToArray(rows, cJSON_CreateString(text));
+      }
+      length = snprintf(text, pbm_length, "P1\n%d %d\n", width, MAX7219_COLUMNS);
+      for (row = 0; row < MAX7219_COLUMNS; row++) {
+        for (x = 0; x < width; x++) {
+          text[length++] = (image[x] & (1 << row)) ? '1' : '0';
+        }
+        text[length++] = '\n';
+      }
+      text[length] = 0;
+      cJSON_AddStringToObject(return_json, "pbm", text);
+    }
+  }
+  free(image);
+  free(buffer);
+  free(text);
+  return ret;
+}
+
+int json_display_trace(cJSON *receive_json, cJSON *return_json) {
+  // we do not use the received json object. Only
+  // put values in the return JSON
+  display_trace_t *entries = NULL;
+  cJSON *trace = NULL;
+  cJSON *trace_item = NULL;
+  int amount;
+  int x;
+  int ret = 0;
+  ESP_LOGI(TAG, "JSON Display Trace start");
+  // Too big for the stack of the http server
+  entries = malloc(DISPLAY_TRACE_LENGTH * sizeof(display_trace_t));
+  if (entries == NULL) {
+    ESP_LOGE(TAG, "No memory for the display trace");
+    return 400;
+  }
+  amount = display_clock_get_trace(entries, DISPLAY_TRACE_LENGTH);
+  // Times in the trace are relative to this
+  cJSON_AddNumberToObject(return_json, "now_us", esp_timer_get_time());
+  trace = cJSON_AddArrayToObject(return_json, "trace");
+  if (trace == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    ret = 400;
+  }
+  for (x = 0; (x < amount) && (ret == 0); x++) {
+    trace_item = cJSON_CreateObject();
+    if (trace_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      ret = 400;
+      break;
+    }
+    cJSON_AddNumberToObject(trace_item, "time_us", entries[x].time);
+    cJSON_AddStringToObject(trace_item, "signal", entries[x].signal);
+    cJSON_AddStringToObject(trace_item, "from", entries[x].from);
+    cJSON_AddStringToObject(trace_item, "to", entries[x].to);
+    cJSON_AddItemToArray(trace, trace_item);
+  }
+  free(entries);
+  return ret;
+}
@@ -0,0 +1,27 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef JSON_DISPLAY_H_
+#define JSON_DISPLAY_H_
+
+#include "cJSON.h"
+
+// Returns the display chain settings in JSON. Stored and in use.
+int json_display_read(cJSON *receive_json, cJSON *return_json);
+
+// Convert the received JSON with the display chain settings and store
+// them in NVRAM. The buffers are allocated on startup so the new
+// settings are used after a restart. Except the font. It is used straight away.
+int json_display_set(cJSON *receive_json, cJSON *return_json);
+
+// Returns the image on the display decoded from the max7219 registers.
+// As rows of '#' and '.' characters and as a plain PBM (P1) image.
+int json_display_image(cJSON *receive_json, cJSON *return_json);
+
+// Returns the recent changes of the display state. Oldest first.
+int json_display_trace(cJSON *receive_json, cJSON *return_json);
+
+#endif
@@ -0,0 +1,249 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// For reading the performance counters as json.
+#include <string.h>
+#include <sys/param.h>
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "sdkconfig.h"
+
+// Own header files
+#include "app_queue.h"
+#include "display_anim.h"
+#include "display_clock.h"
+#include "display_functions.h"
+#include "display_scroll.h"
+#include "http_api_json.h"
+#include "json_metrics.h"
+#include "max7219.h"
+#include "rotary_encoder.h"
+
+// Set logging tag per module
+static const char *TAG = "JsonMetrics";
+
+int json_metrics_read(cJSON *receive_json, cJSON *return_json) {
+  // we do not use the received json object. Only
+  // put values in the return JSON
+  max7219_flush_stats_t flush_stats;
+  max7219_cache_stats_t cache_stats;
+  display_scroll_stats_t scroll_stats;
+  display_anim_stats_t anim_stats;
+  display_screen_stats_t screen_stats[16];
+  int screens;
+  int x;
+  cJSON *screen_item = NULL;
+  display_event_stats_t event_stats;
+  uint32_t encoder_events;
+  uint32_t encoder_dropped;
+  rotary_encoder_accel_stats_t accel_stats;
+  rotary_encoder_backend_stats_t backend_stats;
+  display_latency_stats_t latency_stats[DISP_TASK_SIGNALS];
+  int signals;
+  int bucket;
+  cJSON *bucket_array = NULL;
+  cJSON *latency_item = NULL;
+  alarm_onset_stats_t onset_stats[2];
+  const char *onset_names[2] = {"alarm", "sound"};
+#ifdef MAX7219_GRAYSCALE
+  max7219_gray_stats_t gray_stats;
+#endif
+  cJSON *metrics_item = NULL;
+  ESP_LOGI(TAG, "JSON Metrics Read start");
+
+  // Display flushes
+  max7219_get_flush_stats(&flush_stats);
+  metrics_item = cJSON_AddObjectToObject(return_json, "display");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  cJSON_AddNumberToObject(metrics_item, "flush_count", flush_stats.flush_count);
+  cJSON_AddNumberToObject(metrics_item, "flush_us_last", flush_stats.flush_us_last);
+  cJSON_AddNumberToObject(metrics_item, "flush_us_avg", flush_stats.flush_us_avg);
+  cJSON_AddNumberToObject(metrics_item, "flush_us_max", flush_stats.flush_us_max);
+  cJSON_AddNumberToObject(metrics_item, "call_us_last", flush_stats.call_us_last);
+  cJSON_AddNumberToObject(metrics_item, "call_us_max", flush_stats.call_us_max);
+  cJSON_AddNumberToObject(metrics_item, "rows_sent", flush_stats.rows_sent);
+  cJSON_AddNumberToObject(metrics_item, "rows_skipped", flush_stats.rows_skipped);
+  cJSON_AddNumberToObject(metrics_item, "frames_dropped", flush_stats.frames_dropped);
+  cJSON_AddNumberToObject(metrics_item, "latency_count", flush_stats.latency_count);
+  cJSON_AddNumberToObject(metrics_item, "latency_us_last", flush_stats.latency_us_last);
+  cJSON_AddNumberToObject(metrics_item, "latency_us_avg", flush_stats.latency_us_avg);
+  cJSON_AddNumberToObject(metrics_item, "latency_us_max", flush_stats.latency_us_max);
+  cJSON_AddNumberToObject(metrics_item, "commands", flush_stats.commands);
+  cJSON_AddNumberToObject(metrics_item, "command_us_last", flush_stats.command_us_last);
+  cJSON_AddNumberToObject(metrics_item, "command_us_max", flush_stats.command_us_max);
+
+  // Rendered string cache
+  max7219_get_cache_stats(&cache_stats);
+  metrics_item = cJSON_AddObjectToObject(return_json, "cache");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  cJSON_AddNumberToObject(metrics_item, "hits", cache_stats.hits);
+  cJSON_AddNumberToObject(metrics_item, "misses", cache_stats.misses);
+  cJSON_AddNumberToObject(metrics_item, "uncached", cache_stats.uncached);
+
+  // Smooth scroller
+  display_scroll_get_stats(&scroll_stats);
+  metrics_item = cJSON_AddObjectToObject(return_json, "scroll");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  cJSON_AddNumberToObject(metrics_item, "scrolls", scroll_stats.scrolls);
+  cJSON_AddNumberToObject(metrics_item, "frames", scroll_stats.frames);
+  cJSON_AddNumberToObject(metrics_item, "frames_dropped", scroll_stats.frames_dropped);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_last", scroll_stats.frame_us_last);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_avg", scroll_stats.frame_us_avg);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_max", scroll_stats.frame_us_max);
+  cJSON_AddNumberToObject(metrics_item, "render_us_last", scroll_stats.render_us_last);
+
+  // Digit animations
+  display_anim_get_stats(&anim_stats);
+  metrics_item = cJSON_AddObjectToObject(return_json, "anim");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  cJSON_AddNumberToObject(metrics_item, "animations", anim_stats.animations);
+  cJSON_AddNumberToObject(metrics_item, "frames", anim_stats.frames);
+  cJSON_AddNumberToObject(metrics_item, "frames_dropped", anim_stats.frames_dropped);
+  cJSON_AddNumberToObject(metrics_item, "over_budget", anim_stats.over_budget);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_last", anim_stats.frame_us_last);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_avg", anim_stats.frame_us_avg);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_max", anim_stats.frame_us_max);
+
+  // Display task queue. Encoder turns merged and events lost
+  display_clock_get_event_stats(&event_stats);
+  rotary_encoder_get_counts(&encoder_events, &encoder_dropped);
+  rotary_encoder_get_accel_stats(&accel_stats);
+  rotary_encoder_get_backend_stats(&backend_stats);
+  metrics_item = cJSON_AddObjectToObject(return_json, "events");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  cJSON_AddNumberToObject(metrics_item, "events", event_stats.events);
+  cJSON_AddNumberToObject(metrics_item, "encoder_batches", event_stats.batches);
+  cJSON_AddNumberToObject(metrics_item, "encoder_merged", event_stats.merged);
+  cJSON_AddNumberToObject(metrics_item, "encoder_max_batch", event_stats.max_batch);
+  cJSON_AddNumberToObject(metrics_item, "queue_peak", event_stats.queue_peak);
+  cJSON_AddNumberToObject(metrics_item, "encoder_events", encoder_events);
+  cJSON_AddNumberToObject(metrics_item, "encoder_dropped", encoder_dropped);
+  // Steps per detent grow with the speed of turning
+  cJSON_AddNumberToObject(metrics_item, "encoder_steps", accel_stats.steps);
+  cJSON_AddNumberToObject(metrics_item, "encoder_velocity", accel_stats.velocity);
+  cJSON_AddNumberToObject(metrics_item, "encoder_velocity_max", accel_stats.velocity_max);
+  // Edge interrupts or pulse counter polls. And the CPU time they took
+  cJSON_AddStringToObject(metrics_item, "encoder_backend", backend_stats.backend);
+  cJSON_AddNumberToObject(metrics_item, "encoder_calls", backend_stats.calls);
+  cJSON_AddNumberToObject(metrics_item, "encoder_us_total", backend_stats.us_total);
+  cJSON_AddNumberToObject(metrics_item, "encoder_us_max", backend_stats.us_max);
+
+  // Time from the start of the minute to the start of an alarm or a
+  // sound. Mostly started by the alarm timer.
+  alarm_get_onset_stats(&onset_stats[0], &onset_stats[1]);
+  metrics_item = cJSON_AddObjectToObject(return_json, "onset");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  for (x = 0; x < 2; x++) {
+    latency_item = cJSON_AddObjectToObject(metrics_item, onset_names[x]);
+    if (latency_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 400;
+    }
+    cJSON_AddNumberToObject(latency_item, "count", onset_stats[x].count);
+    cJSON_AddNumberToObject(latency_item, "timer", onset_stats[x].timer);
+    cJSON_AddNumberToObject(latency_item, "us_last", onset_stats[x].us_last);
+    cJSON_AddNumberToObject(latency_item, "us_avg", onset_stats[x].us_avg);
+    cJSON_AddNumberToObject(latency_item, "us_max", onset_stats[x].us_max);
+  }
+
+  // Time to draw each screen by the display task
+  screens = display_clock_get_screen_stats(screen_stats, 16);
+  metrics_item = cJSON_AddArrayToObject(return_json, "screens");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  for (x = 0; x < screens; x++) {
+    screen_item = cJSON_CreateObject();
+    if (screen_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 400;
+    }
+    cJSON_AddStringToObject(screen_item, "name", screen_stats[x].name);
+    cJSON_AddNumberToObject(screen_item, "draws", screen_stats[x].draws);
+    cJSON_AddNumberToObject(screen_item, "us_last", screen_stats[x].us_last);
+    cJSON_AddNumberToObject(screen_item, "us_avg", screen_stats[x].us_avg);
+    cJSON_AddNumberToObject(screen_item, "us_max", screen_stats[x].us_max);
+    cJSON_AddItemToArray(metrics_item, screen_item);
+  }
+
+  // Time from sending to handling of display task events. Histogram per
+  // signal. Bucket upper limits in microseconds. The last is open.
+  signals = display_clock_get_latency_stats(latency_stats, DISP_TASK_SIGNALS);
+  bucket_array = cJSON_AddArrayToObject(return_json, "latency_bucket_us");
+  metrics_item = cJSON_AddArrayToObject(return_json, "latency");
+  if ((bucket_array == NULL) || (metrics_item == NULL)) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  for (bucket = 0; bucket < DISPLAY_LATENCY_BUCKETS - 1; bucket++) {
+    cJSON_AddItemToArray(bucket_array, cJSON_CreateNumber(DISPLAY_LATENCY_BUCKET_US(bucket)));
+  }
+  for (x = 0; x < signals; x++) {
+    latency_item = cJSON_CreateObject();
+    if (latency_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 400;
+    }
+    cJSON_AddStringToObject(latency_item, "name", latency_stats[x].name);
+    cJSON_AddNumberToObject(latency_item, "count", latency_stats[x].count);
+    cJSON_AddNumberToObject(latency_item, "us_last", latency_stats[x].us_last);
+    cJSON_AddNumberToObject(latency_item, "us_max", latency_stats[x].us_max);
+    bucket_array = cJSON_AddArrayToObject(latency_item, "buckets");
+    if (bucket_array == NULL) {
+      cJSON_Delete(latency_item);
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 400;
+    }
+    for (bucket = 0; bucket < DISPLAY_LATENCY_BUCKETS; bucket++) {
+      cJSON_AddItemToArray(bucket_array, cJSON_CreateNumber(latency_stats[x].buckets[bucket]));
+    }
+    cJSON_AddItemToArray(metrics_item, latency_item);
+  }
+
+#ifdef MAX7219_GRAYSCALE
+  // Grayscale planes. Refresh in full cycles per second
+  max7219_get_gray_stats(&gray_stats);
+  metrics_item = cJSON_AddObjectToObject(return_json, "gray");
+  if (metrics_item == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    return 400;
+  }
+  cJSON_AddBoolToObject(metrics_item, "showing", max7219_gray_showing());
+  cJSON_AddNumberToObject(metrics_item, "tick_us", gray_stats.tick_us);
+  cJSON_AddNumberToObject(metrics_item, "frame_us_estimate", gray_stats.frame_us_estimate);
+  cJSON_AddNumberToObject(metrics_item, "max_hz", gray_stats.max_hz);
+  cJSON_AddNumberToObject(metrics_item, "cycles", gray_stats.cycles);
+  cJSON_AddNumberToObject(metrics_item, "cycle_us_last", gray_stats.cycle_us_last);
+  cJSON_AddNumberToObject(metrics_item, "cycle_us_max", gray_stats.cycle_us_max);
+  cJSON_AddNumberToObject(metrics_item, "refresh_hz",
+                          gray_stats.cycle_us_last ? 1000000 / gray_stats.cycle_us_last : 0);
+  cJSON_AddNumberToObject(metrics_item, "planes_sent", gray_stats.planes_sent);
+  cJSON_AddNumberToObject(metrics_item, "planes_late", gray_stats.planes_late);
+#endif
+  return 0;
+}
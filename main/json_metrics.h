@@ -0,0 +1,16 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef JSON_METRICS_H_
+#define JSON_METRICS_H_
+
+#include "cJSON.h"
+
+// Returns the performance counters of the clock in JSON. Display flushes,
+// scrolling and the string cache.
+int json_metrics_read(cJSON *receive_json, cJSON *return_json);
+
+#endif
@@ -0,0 +1,181 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// JSON read and write of the sounds table in spiffs. Paged.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+// Own header files
+#include "alarm_schedule.h"
+#include "json_schedule.h"
+#include "schedule_cron.h"
+#include "schedule_store.h"
+
+// Set logging tag per module
+static const char *TAG = "JsonSchedule";
+
+// A number in the JSON. Or the default when it is not there
+static int json_number(cJSON *json, const char *name, int default_value) {
+  cJSON *temp_object = cJSON_GetObjectItemCaseSensitive(json, name);
+  if ((temp_object != NULL) && cJSON_IsNumber(temp_object)) {
+    return temp_object->valueint;
+  }
+  return default_value;
+}
+
+int json_schedule_read(cJSON *receive_json, cJSON *return_json) {
+  int offset = json_number(receive_json, "offset", 0);
+  int count = json_number(receive_json, "count", JSON_SCHEDULE_PAGE);
+  if ((offset < 0) || (count <= 0) || (count > JSON_SCHEDULE_PAGE)) {
+    ESP_LOGE(TAG, "JSON invalid offset %d or count %d", offset, count);
+    return 400;
+  }
+  schedule_record_t *records = malloc(count * sizeof(schedule_record_t));
+  if (records == NULL) {
+    ESP_LOGE(TAG, "No memory for %d records", count);
+    return 500;
+  }
+  count = schedule_store_read(offset, records, count);
+  cJSON_AddNumberToObject(return_json, "size", schedule_store_count());
+  cJSON_AddNumberToObject(return_json, "max", SCHEDULE_STORE_MAX);
+  cJSON_AddNumberToObject(return_json, "offset", offset);
+  cJSON_AddNumberToObject(return_json, "count", count);
+  cJSON *records_json = cJSON_AddArrayToObject(return_json, "records");
+  if (records_json == NULL) {
+    ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+    free(records);
+    return 500;
+  }
+  char cron_text[CRON_TEXT_LENGTH];
+  for (int x = 0; x < count; x++) {
+    if (!(records[x].flags & SCHEDULE_RECORD_USED)) {
+      continue;
+    }
+    cJSON *record_item = cJSON_CreateObject();
+    if (record_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      free(records);
+      return 500;
+    }
+    cJSON_AddNumberToObject(record_item, "index", offset + x);
+    schedule_cron_format(&records[x].cron, cron_text, sizeof(cron_text));
+    cJSON_AddStringToObject(record_item, "cron", cron_text);
+    cJSON_AddStringToObject(record_item, "sound", records[x].soundfile);
+    cJSON_AddItemToArray(records_json, record_item);
+  }
+  free(records);
+  // The first record to go off. Local time
+  uint32_t when;
+  int index;
+  struct tm next_tm;
+  char next_text[20];
+  if (schedule_store_next(&when, &index)) {
+    cJSON *next_item = cJSON_AddObjectToObject(return_json, "next_event");
+    if (next_item == NULL) {
+      ESP_LOGE(TAG, "Error on creating JSON structure. Memory?");
+      return 500;
+    }
+    alarm_schedule_to_tm(when, &next_tm);
+    strftime(next_text, sizeof(next_text), "%Y-%m-%d %H:%M", &next_tm);
+    cJSON_AddStringToObject(next_item, "time", next_text);
+    cJSON_AddNumberToObject(next_item, "index", index);
+  }
+  return 0;
+}
+
+int json_schedule_write(cJSON *receive_json, cJSON *return_json) {
+  cJSON *records_json = cJSON_GetObjectItemCaseSensitive(receive_json, "records");
+  if ((records_json == NULL) || !cJSON_IsArray(records_json)) {
+    ESP_LOGE(TAG, "JSON invalid records");
+    return 400;
+  }
+  int count = cJSON_GetArraySize(records_json);
+  if ((count == 0) || (count > JSON_SCHEDULE_PAGE)) {
+    ESP_LOGE(TAG, "Schedule page has %d records. Max is %d", count, JSON_SCHEDULE_PAGE);
+    return 400;
+  }
+  schedule_record_t *records = calloc(count, sizeof(schedule_record_t));
+  int *indexes = malloc(count * sizeof(int));
+  if ((records == NULL) || (indexes == NULL)) {
+    ESP_LOGE(TAG, "No memory for %d records", count);
+    free(records);
+    free(indexes);
+    return 500;
+  }
+  // First check all records. Nothing is written when one is not valid
+  int x = 0;
+  int error_to_return = 0;
+  cJSON *record_item;
+  cJSON *temp_object;
+  cJSON_ArrayForEach(record_item, records_json) {
+    indexes[x] = json_number(record_item, "index", SCHEDULE_STORE_APPEND);
+    temp_object = cJSON_GetObjectItemCaseSensitive(record_item, "delete");
+    if ((temp_object != NULL) && cJSON_IsTrue(temp_object)) {
+      // Free place. Flags stay 0
+      if (indexes[x] == SCHEDULE_STORE_APPEND) {
+        ESP_LOGE(TAG, "JSON record %d delete without index", x);
+        error_to_return = 400;
+      }
+      x++;
+      continue;
+    }
+    temp_object = cJSON_GetObjectItemCaseSensitive(record_item, "cron");
+    if ((temp_object == NULL) || !cJSON_IsString(temp_object) ||
+        (schedule_cron_parse(temp_object->valuestring, &records[x].cron) != ESP_OK)) {
+      ESP_LOGE(TAG, "JSON invalid cron in record %d", x);
+      error_to_return = 400;
+    }
+    temp_object = cJSON_GetObjectItemCaseSensitive(record_item, "sound");
+    if ((temp_object != NULL) && cJSON_IsString(temp_object) &&
+        (strlen(temp_object->valuestring) < MAX_SOUNDFILE_LENGTH)) {
+      strcpy(records[x].soundfile, temp_object->valuestring);
+    } else {
+      ESP_LOGE(TAG, "JSON invalid sound in record %d", x);
+      error_to_return = 400;
+    }
+    records[x].flags = SCHEDULE_RECORD_USED;
+    x++;
+  }
+  // A place is in the file or just after it. Like schedule_store_write
+  // checks. The records before it make the file longer.
+  int file_count = schedule_store_count();
+  for (x = 0; (x < count) && (error_to_return == 0); x++) {
+    if (indexes[x] == SCHEDULE_STORE_APPEND) {
+      continue;
+    }
+    if ((indexes[x] < 0) || (indexes[x] >= SCHEDULE_STORE_MAX) || (indexes[x] > file_count)) {
+      ESP_LOGE(TAG, "JSON record %d index %d not in the file of %d records", x, indexes[x],
+               file_count);
+      error_to_return = 400;
+    } else if (indexes[x] == file_count) {
+      file_count++;
+    }
+  }
+  if (error_to_return == 0) {
+    cJSON *indexes_json = cJSON_AddArrayToObject(return_json, "indexes");
+    for (x = 0; x < count; x++) {
+      if (schedule_store_write(&indexes[x], &records[x]) != ESP_OK) {
+        // The filesystem failed or the file is full. Records before this
+        // one stay written
+        error_to_return = 500;
+        break;
+      }
+      if (indexes_json != NULL) {
+        cJSON_AddItemToArray(indexes_json, cJSON_CreateNumber(indexes[x]));
+      }
+    }
+    ESP_LOGI(TAG, "Stored %d of %d records", x, count);
+  }
+  free(records);
+  free(indexes);
+  return error_to_return;
+}
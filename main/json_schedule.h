@@ -0,0 +1,27 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef JSON_SCHEDULE_H_
+#define JSON_SCHEDULE_H_
+
+#include "cJSON.h"
+
+// Max records in one read or write. Keeps the JSON small
+#define JSON_SCHEDULE_PAGE 32
+
+// Returns a page of the sounds table. Optional "offset" and "count" in
+// receive_json. Free places are left out.
+int json_schedule_read(cJSON *receive_json, cJSON *return_json);
+
+// Write a page of records to the sounds table. Each with a "cron" and a
+// "sound". Without "index" the record goes in the first free place. With
+// "delete" the place at "index" is freed. Nothing is written when a record
+// or an index is not valid. An index is a place in the file or just after
+// it. When the filesystem fails or the file is full the records before
+// stay written.
+int json_schedule_write(cJSON *receive_json, cJSON *return_json);
+
+#endif
@@ -15,16 +15,27 @@
 
 #include "driver/spi_common.h"
 #include "driver/spi_master.h"
+#include "esp_attr.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 // Own file
 #include "max7219.h"
-// include one of the fonts to your liking
-#include "font_terminal.h"
-//#include "font_noto.h"
+
+#if defined(MAX7219_FLUSH_TASK) && !defined(MAX7219_QUEUED_FLUSH)
+#error "MAX7219_FLUSH_TASK needs MAX7219_QUEUED_FLUSH"
+#endif
+#if defined(MAX7219_GRAYSCALE) && !defined(MAX7219_FLUSH_TASK)
+#error "MAX7219_GRAYSCALE needs MAX7219_FLUSH_TASK"
+#endif
+// The fonts are packed at build time. Selected at runtime
+#include "fonts.h"
 
 // max7219 registers
 #define REGNOOP 0x00
@@ -56,16 +67,23 @@
 //Set logging tag per module
 static const char *TAG = "MAX7219";
 
+// Register writes sent in one batch. Each write is one chained frame
+// with the register and value for every chip.
+#define MAX7219_BATCH 16
+
 // function definitions
 void max7219_send_buffer(void);
 void max7219_send_command(u_int8_t reg_type, u_int8_t reg_value);
+static void max7219_batch_add(u_int8_t reg_type, u_int8_t reg_value);
+static esp_err_t max7219_batch_send(void);
+static void max7219_post_cb(spi_transaction_t *trans);
 
 const spi_bus_config_t max7219_bus_cfg = {.mosi_io_num = MAX7219_PIN_MOSI,
                                           .miso_io_num = -1,  // not used. Only sending to max7219
                                           .sclk_io_num = MAX7219_PIN_CLK,
                                           .quadwp_io_num = -1,
                                           .quadhd_io_num = -1,
-                                          .max_transfer_sz = 0};
+                                          .max_transfer_sz = 0};  // default with DMA
 
 const spi_device_interface_config_t max7219_dev_cfg = {.clock_speed_hz = MAX7219_SPISPEED,
                                                        .command_bits = 0,
@@ -78,28 +96,202 @@ const spi_device_interface_config_t max7219_dev_cfg = {.clock_speed_hz = MAX7219
                                                        .cs_ena_pretrans = 16,
                                                        .flags = SPI_DEVICE_NO_DUMMY,
                                                        .pre_cb = NULL,
-                                                       .post_cb = NULL,
-                                                       .queue_size = 1};
+                                                       .post_cb = max7219_post_cb,
+                                                       .queue_size = MAX7219_COLUMNS};
 
 spi_device_handle_t max7219_dev;
 
-// Buffer with data to send to the MAX7219 chips. 
+// The display chain in use. Set on init. Below are the defaults
+static max7219_config_t disp = {.count = MAX7219_COUNT,
+#ifdef MAX7219_ROTATE90
+                                .rotate90 = true,
+#else
+                                .rotate90 = false,
+#endif
+                                .reverse = false};
+// Columns of the complete display
+static int tot_columns = MAX7219_TOT_COLUMNS;
+
+// All buffers below are allocated once on init. Their size depends on the
+// amount of max7219s in the chain.
+//
+// Buffer with data to send to the MAX7219 chips.
 // This buffer is filled from the display buffer for each row
 // in the max7219. Or for commands.
-// Allocate 2 bytes, 1 voor register. 1 for data
-u_int8_t send_buffer[MAX7219_COUNT * 2]; 
+// Allocate 2 bytes per chip, 1 voor register. 1 for data
+// Long chains need DMA. So the send buffers are in DMA capable memory.
+u_int8_t *send_buffer = NULL;
 
 // We allocate 1 byte for each column. Byte is a vertical row on
 // display.
-u_int8_t display_buffer[MAX7219_TOT_COLUMNS];
+// With rotate90 the display buffer has the same size. But the
+// 8 bytes of each max7219 are rows. Bit 0 is the leftmost column. So the
+// buffer is always what is sent to the digit registers. No bit shuffling
+// is needed when sending.
+u_int8_t *display_buffer = NULL;
 
 //Connect the send buffer to an spi transaction
-spi_transaction_t max7219_trans = {
-    .length = sizeof(send_buffer) * 8, .tx_buffer = &send_buffer, .rx_buffer = NULL};
+//User field NULL marks this as a command. Frame rows have the row number + 1.
+spi_transaction_t max7219_trans = {.rx_buffer = NULL, .user = NULL};
+
+// Batch of register writes. MAX7219_BATCH frames of 2 bytes per chip.
+// The transaction is pointed at each frame in turn. With the flush task
+// the batch is only filled and sent with the SPI mutex held.
+static u_int8_t *batch_buffer = NULL;
+static int batch_count = 0;
+static spi_transaction_t batch_trans = {.rx_buffer = NULL, .user = NULL};
+
+#ifdef MAX7219_QUEUED_FLUSH
+// Ring of prebuilt transactions. One for each digit register (row) in the
+// max7219. Each row has its own buffer. So the display buffer can be changed
+// while the rows are still being sent. Always 8 transactions for a frame.
+// Longer chains only make each transaction longer.
+static u_int8_t *flush_buffer[MAX7219_COLUMNS];
+static spi_transaction_t flush_trans[MAX7219_COLUMNS];
+// Amount of queued row transactions which are not yet collected
+static int flush_in_flight = 0;
+#endif
+// Amount of rows of the current frame the SPI driver still has to send
+static volatile int flush_rows_pending = 0;
 
-esp_err_t max7219_init_spi(void) {
-  esp_err_t ret;
-  ret = spi_bus_initialize(MAX7219_SPIPORT, &max7219_bus_cfg, 0);  // do not use DMA
+// Shadow copy of what is in the digit registers of each chip. Used to
+// only send changed rows. Chips with unchanged data in a sent row get a
+// no-op. Not valid after init. Then all rows are sent.
+static u_int8_t *shadow_buffer[MAX7219_COLUMNS];
+static int shadow_valid = 0;
+static int flushes_to_refresh = 0;
+
+#ifdef MAX7219_FLUSH_TASK
+// Front buffer. This is the frame the flush task sends. The display buffer
+// is the back buffer. Both are swapped by max7219_send_display.
+static u_int8_t *front_buffer = NULL;
+// Frame mutex guards the swap and the reading of the front buffer.
+// SPI mutex is held by the flush task while a frame is sent. Commands take
+// it too. Polling and queued transactions can not be mixed.
+static SemaphoreHandle_t frame_mutex = NULL;
+static SemaphoreHandle_t spi_mutex = NULL;
+static TaskHandle_t flush_task = NULL;
+static bool frame_ready = false;
+// Event time belonging to the frame in the front buffer
+static int64_t frame_event_us = 0;
+#endif
+// Brightness set by max7219_post_brightness. Not written yet. -1 is none
+static volatile int brightness_posted = -1;
+// Event time waiting for the next frame. And of the frame being flushed.
+static int64_t next_event_us = 0;
+static int64_t flush_event_us = 0;
+
+#ifdef MAX7219_GRAYSCALE
+// Bit planes of the grayscale frame. Bit n of the level of a dot is in
+// plane n. Drawing is done in the draw planes. These are columns like
+// max7219_get_columns. max7219_gray_show copies them into the planes
+// sent by the flush task. Those have the layout of the display buffer.
+static u_int8_t *gray_draw[MAX7219_GRAY_BITS];
+static u_int8_t *gray_planes[MAX7219_GRAY_BITS];
+static esp_timer_handle_t gray_timer = NULL;
+static bool gray_showing_planes = false;
+// Counted by the plane timer. Only the flush task reads it
+static volatile uint32_t gray_ticks = 0;
+// Plane on the display. -1 is none
+static int gray_plane_shown = -1;
+static int64_t gray_cycle_start = 0;
+static max7219_gray_stats_t gray_stats;
+#endif
+
+#ifdef MAX7219_STRIP_CACHE
+// Rendered string. For rotated displays each 8 columns of the strip are
+// stored as rows. Ready for the display buffer.
+typedef struct {
+  uint32_t hash;
+  uint32_t last_used;  // 0 is an empty entry
+  int font;            // rendered with this font
+  int length;          // columns
+  char text[MAX7219_STRIP_CACHE_TEXT + 1];
+  u_int8_t strip[MAX7219_STRIP_CACHE_COLUMNS];
+} strip_cache_entry_t;
+static strip_cache_entry_t strip_cache[MAX7219_STRIP_CACHE];
+static uint32_t strip_cache_clock = 0;
+#endif
+static max7219_cache_stats_t cache_stats;
+
+// Flush timing. Updated from the SPI interrupt with the queued flush
+static int64_t flush_start;
+static max7219_flush_stats_t flush_stats;
+static void (*flush_done)(void) = NULL;
+
+#ifdef MAX7219_FLUSH_TASK
+static void max7219_flush_task(void *args);
+#endif
+#ifdef MAX7219_GRAYSCALE
+static esp_err_t max7219_gray_init(void);
+static void max7219_gray_hide(void);
+#endif
+static void max7219_collect_rows(void);
+
+esp_err_t max7219_init_spi(const max7219_config_t *config) {
+  esp_err_t ret = ESP_OK;
+  int row;
+  // Only init once. Buffers are never freed
+  if (display_buffer != NULL) {
+    ESP_LOGE(TAG, "Display already initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (config != NULL) {
+    if ((config->count > 0) && (config->count <= MAX7219_MAX_COUNT)) {
+      disp = *config;
+    } else {
+      ESP_LOGE(TAG, "Invalid amount of max7219s %d. Using default", config->count);
+    }
+  }
+  tot_columns = disp.count * MAX7219_COLUMNS;
+  if ((disp.font[0] != 0) && (fonts_select(fonts_find(disp.font)) < 0)) {
+    ESP_LOGE(TAG, "Font %s not found. Using default", disp.font);
+  }
+  ESP_LOGI(TAG, "Display with %d max7219s. Rotate %d. Reverse %d", disp.count, disp.rotate90,
+           disp.reverse);
+
+  // Allocate all buffers
+  display_buffer = calloc(tot_columns, 1);
+  send_buffer = heap_caps_calloc(disp.count * 2, 1, MALLOC_CAP_DMA);
+  batch_buffer = heap_caps_calloc(MAX7219_BATCH * disp.count * 2, 1, MALLOC_CAP_DMA);
+  if ((display_buffer == NULL) || (send_buffer == NULL) || (batch_buffer == NULL)) {
+    ret = ESP_ERR_NO_MEM;
+  }
+#ifdef MAX7219_FLUSH_TASK
+  front_buffer = calloc(tot_columns, 1);
+  frame_mutex = xSemaphoreCreateMutex();
+  spi_mutex = xSemaphoreCreateMutex();
+  if ((front_buffer == NULL) || (frame_mutex == NULL) || (spi_mutex == NULL)) {
+    ret = ESP_ERR_NO_MEM;
+  }
+#endif
+  max7219_trans.length = disp.count * 2 * 8;
+  max7219_trans.tx_buffer = send_buffer;
+  batch_trans.length = disp.count * 2 * 8;
+  for (row = 0; row < MAX7219_COLUMNS; row++) {
+    shadow_buffer[row] = calloc(disp.count, 1);
+    if (shadow_buffer[row] == NULL) {
+      ret = ESP_ERR_NO_MEM;
+    }
+#ifdef MAX7219_QUEUED_FLUSH
+    // Connect the row buffers to the transactions. This is done once.
+    flush_buffer[row] = heap_caps_calloc(disp.count * 2, 1, MALLOC_CAP_DMA);
+    if (flush_buffer[row] == NULL) {
+      ret = ESP_ERR_NO_MEM;
+    }
+    flush_trans[row].length = disp.count * 2 * 8;
+    flush_trans[row].tx_buffer = flush_buffer[row];
+    flush_trans[row].rx_buffer = NULL;
+    flush_trans[row].user = (void *)(intptr_t)(row + 1);
+#endif
+  }
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "No memory for display buffers");
+    return ret;
+  }
+
+  // Up to 32 max7219s fit in the SPI fifo. Longer chains need DMA
+  ret = spi_bus_initialize(MAX7219_SPIPORT, &max7219_bus_cfg, MAX7219_DMA_CHAN);
   if (ret == ESP_OK) {
     ESP_LOGI(TAG, "SPI bus for max7219 initalized");
     ret = spi_bus_add_device(MAX7219_SPIPORT, &max7219_dev_cfg, &max7219_dev);
@@ -113,29 +305,62 @@ esp_err_t max7219_init_spi(void) {
   }
 
   // SPI should be correctly set. Reset max7219
+  // All chips get each register in one frame. 1 transaction per register
   if (ret == ESP_OK) {
-    max7219_send_command(REGSHUTDOWN, MODESHUTDOWN);
-    max7219_send_command(REGDIGIT0, 0x55);  // We have dot pattern on display
-    max7219_send_command(REGDIGIT1, 0x00);
-    max7219_send_command(REGDIGIT2, 0x00);
-    max7219_send_command(REGDIGIT3, 0x00);
-    max7219_send_command(REGDIGIT4, 0x00);
-    max7219_send_command(REGDIGIT5, 0x00);
-    max7219_send_command(REGDIGIT6, 0x00);
-    max7219_send_command(REGDIGIT7, 0x00);
-    max7219_send_command(REGSHUTDOWN, MODESHUTDOWN);
-    max7219_send_command(REGTEST, MODENOTEST);
-    max7219_send_command(REGSCANLIMIT, SCANLIMIT);
-    max7219_send_command(REGDECMODE, MODENODECODE);
-    max7219_send_command(REGBRIGHT, 0);
-    max7219_send_command(REGSHUTDOWN, MODENORMAL);
+#ifdef MAX7219_FLUSH_TASK
+    xSemaphoreTake(spi_mutex, portMAX_DELAY);
+#endif
+    max7219_batch_add(REGSHUTDOWN, MODESHUTDOWN);
+    max7219_batch_add(REGDIGIT0, 0x55);  // We have dot pattern on display
+    max7219_batch_add(REGDIGIT1, 0x00);
+    max7219_batch_add(REGDIGIT2, 0x00);
+    max7219_batch_add(REGDIGIT3, 0x00);
+    max7219_batch_add(REGDIGIT4, 0x00);
+    max7219_batch_add(REGDIGIT5, 0x00);
+    max7219_batch_add(REGDIGIT6, 0x00);
+    max7219_batch_add(REGDIGIT7, 0x00);
+    max7219_batch_add(REGTEST, MODENOTEST);
+    max7219_batch_add(REGSCANLIMIT, SCANLIMIT);
+    max7219_batch_add(REGDECMODE, MODENODECODE);
+    max7219_batch_add(REGBRIGHT, 0);
+    max7219_batch_add(REGSHUTDOWN, MODENORMAL);
+    ret = max7219_batch_send();
+#ifdef MAX7219_FLUSH_TASK
+    xSemaphoreGive(spi_mutex);
+#endif
+    ESP_LOGI(TAG, "Display reset in %d us", flush_stats.command_us_last);
   }
+  // Digit registers are overwritten above. Next flush sends all rows.
+  shadow_valid = 0;
+#ifdef MAX7219_FLUSH_TASK
+  if (ret == ESP_OK) {
+    if (xTaskCreatePinnedToCore(&max7219_flush_task, "DispFlush", 2048, NULL,
+                                MAX7219_FLUSH_TASK_PRIO, &flush_task,
+                                MAX7219_FLUSH_TASK_CORE) != pdPASS) {
+      ESP_LOGE(TAG, "Could not start display flush task");
+      ret = ESP_FAIL;
+    }
+  }
+#endif
+#ifdef MAX7219_GRAYSCALE
+  if (ret == ESP_OK) {
+    ret = max7219_gray_init();
+  }
+#endif
   return ret;
 }
 
 void max7219_empty_display_buffer(void) {
   // ESP_LOGI(TAG, "Clearing display buffer");
-  max7219_sprite_clear_buffer(0, MAX7219_TOT_COLUMNS);
+  max7219_sprite_clear_buffer(0, tot_columns);
+}
+
+void max7219_get_config(max7219_config_t *config) {
+  *config = disp;
+}
+
+int max7219_get_width(void) {
+  return tot_columns;
 }
 
 // Send 1 line of data to all MAX7219 chips. 1 unique byte for each chip
@@ -143,32 +368,42 @@ void max7219_empty_display_buffer(void) {
 // each chip side by side. So daisy chained MAX7219 chips can have there output
 // and input connected. See datasheet. 
 // Buffer filled with sequences of max7219 register and the value.
-// Amount of data is low. No need for DMA
 void max7219_send_buffer(void) {
+#ifdef MAX7219_FLUSH_TASK
+  xSemaphoreTake(spi_mutex, portMAX_DELAY);
+#endif
+  // Polling and queued transactions can not be mixed. Let the frame finish.
+  max7219_collect_rows();
   if (spi_device_polling_transmit(max7219_dev, &max7219_trans) != ESP_OK) {
     ESP_LOGE(TAG, "Error in sending SPI data");
   }
+#ifdef MAX7219_FLUSH_TASK
+  xSemaphoreGive(spi_mutex);
+#endif
 }
 
 // Sometimes it is is nice to know the length of the string to display
 // Handy for calculation of placement, blanking, moving the contents
 int max7219_sprite_get_length(char *buf_to_send) {
-  int tot_chars = strlen(buf_to_send);
   // Determine length of display needed.
   // Add intercharacter spacing after. Except for last char.
   int cols = 0;
-  int i;
-  uint8_t char_value;
-  for (i = 0; i < tot_chars; i++) {
-    char_value = (uint8_t)buf_to_send[i];
-    if (char_value > 127) {
-      ESP_LOGE(TAG, "Only supporting first 127 chars (Ascii) of UTF8");
+  const char *next = buf_to_send;
+  uint32_t char_value;
+  int width;
+  const u_int8_t *glyph;
+  while (*next) {
+    // UTF8. next is moved to the next character
+    char_value = fonts_utf8_next(&next);
+    width = fonts_glyph(char_value, &glyph);
+    if (width < 0) {
+      ESP_LOGE(TAG, "No glyph for character U+%04X", char_value);
       return 0;
     } else {
-      cols += font_8x8[char_value][0];
+      cols += width;
       // check if we are on the last character
       // add extra column for intercharater spacing
-      if (i < (tot_chars - 1)) {
+      if (*next) {
         cols++;
       }
     }
@@ -184,8 +419,8 @@ void max7219_sprite_clear_buffer(int offset, uint length) {
   int end;
   // check if we do not cross displaybuffer ends
   end = offset + length;
-  if (end > MAX7219_TOT_COLUMNS) {
-    end = MAX7219_TOT_COLUMNS;
+  if (end > tot_columns) {
+    end = tot_columns;
   }
   if (end < 0) {
     ESP_LOGE(TAG, "Clear buffer parameters wrong");
@@ -198,57 +433,352 @@ void max7219_sprite_clear_buffer(int offset, uint length) {
     offset = 0;
   }
 
-  for (; offset < end; offset++) {
-    // ESP_LOGI(TAG, "clearing display buffer %d", offset);
-    display_buffer[offset] = 0x00;
+  int module;
+  int row;
+  u_int8_t mask;
+  if (!disp.rotate90) {
+    for (; offset < end; offset++) {
+      // ESP_LOGI(TAG, "clearing display buffer %d", offset);
+      display_buffer[offset] = 0x00;
+    }
+    return;
+  }
+  // Rotated display. Clear the bits of the columns in each row of the max7219s
+  while (offset < end) {
+    module = offset / MAX7219_COLUMNS;
+    mask = 0;
+    // collect the columns to clear in this max7219
+    do {
+      mask |= 1 << (offset % MAX7219_COLUMNS);
+      offset++;
+    } while ((offset < end) && (offset % MAX7219_COLUMNS));
+    for (row = 0; row < MAX7219_COLUMNS; row++) {
+      display_buffer[(module * MAX7219_COLUMNS) + row] &= ~mask;
+    }
+  }
+}
+
+// Put 1 character from the rotated font in the display buffer. The
+// character can cross the border between 2 max7219s. Columns outside of
+// the display are left out. Only the columns of the character are changed.
+// rot_char[0] is the amount of columns. Up to 9. A character of 8 columns
+// and the empty column after it.
+static void max7219_put_rotated(const u_int8_t *rot_char, int position) {
+  int module;
+  int row;
+  u_int16_t mask;
+  u_int16_t bits;
+  if ((position + rot_char[0] <= 0) || (position >= tot_columns)) {
+    return;
+  }
+  // module of the first column. Rounded down for negative positions
+  module = ((position + MAX7219_COLUMNS) / MAX7219_COLUMNS) - 1;
+  mask = ((1 << rot_char[0]) - 1) << (position - (module * MAX7219_COLUMNS));
+  for (row = 0; row < MAX7219_COLUMNS; row++) {
+    bits = rot_char[row + 1] << (position - (module * MAX7219_COLUMNS));
+    if (module >= 0) {
+      display_buffer[(module * MAX7219_COLUMNS) + row] =
+          (display_buffer[(module * MAX7219_COLUMNS) + row] & ~mask) | bits;
+    }
+    if ((module + 1 < disp.count) && (mask >> 8)) {
+      display_buffer[((module + 1) * MAX7219_COLUMNS) + row] =
+          (display_buffer[((module + 1) * MAX7219_COLUMNS) + row] & ~(mask >> 8)) | (bits >> 8);
+    }
+  }
+}
+
+#ifdef MAX7219_STRIP_CACHE
+// FNV-1a hash of the string
+static uint32_t max7219_strip_hash(const char *text) {
+  uint32_t hash = 2166136261UL;
+  while (*text) {
+    hash ^= (uint8_t)*text++;
+    hash *= 16777619UL;
   }
+  return hash;
 }
 
-void max7219_sprite_fill_buffer(char *buf_to_send, int position) {
-  //ESP_LOGI(TAG, "Start filling Display buffer");
-  int tot_chars = strlen(buf_to_send);
-  //ESP_LOGI(TAG, "Total characters to send is %d", tot_chars);
-  int x;
+// Find the string in the cache. Not found it is rendered in the least
+// recently used entry. Returns NULL for strings which are not cached.
+static strip_cache_entry_t *max7219_strip_lookup(char *text) {
+  uint32_t hash;
+  int tot_chars = strlen(text);
+  int entry;
+  int oldest = 0;
+  const char *next;
+  const u_int8_t *glyph;
+  strip_cache_entry_t *found;
+  if (tot_chars > MAX7219_STRIP_CACHE_TEXT) {
+    cache_stats.uncached++;
+    return NULL;
+  }
+  hash = max7219_strip_hash(text);
+  for (entry = 0; entry < MAX7219_STRIP_CACHE; entry++) {
+    found = &strip_cache[entry];
+    if ((found->last_used != 0) && (found->hash == hash) && (found->font == fonts_selected()) &&
+        (strcmp(found->text, text) == 0)) {
+      found->last_used = ++strip_cache_clock;
+      cache_stats.hits++;
+      return found;
+    }
+    if (found->last_used < strip_cache[oldest].last_used) {
+      oldest = entry;
+    }
+  }
+  // Not in cache. Check if it can be rendered
+  next = text;
+  while (*next) {
+    if (fonts_glyph(fonts_utf8_next(&next), &glyph) < 0) {
+      cache_stats.uncached++;
+      return NULL;
+    }
+  }
+  if (max7219_sprite_get_length(text) > MAX7219_STRIP_CACHE_COLUMNS) {
+    cache_stats.uncached++;
+    return NULL;
+  }
+  found = &strip_cache[oldest];
+  memset(found->strip, 0, MAX7219_STRIP_CACHE_COLUMNS);
+  found->length = max7219_render_columns(text, found->strip, MAX7219_STRIP_CACHE_COLUMNS);
+  if (disp.rotate90) {
+    max7219_transpose(found->strip, MAX7219_STRIP_CACHE_COLUMNS / MAX7219_COLUMNS, true);
+  }
+  strcpy(found->text, text);
+  found->font = fonts_selected();
+  found->hash = hash;
+  found->last_used = ++strip_cache_clock;
+  cache_stats.misses++;
+  return found;
+}
+
+// Put a cached strip in the display buffer. Columns outside of the display
+// are left out.
+static void max7219_strip_put(const strip_cache_entry_t *entry, int position) {
+  int column;
+  u_int8_t rot_block[MAX7219_COLUMNS + 1];
+  if (disp.rotate90) {
+    // Each 8 columns are rows already. Put them like a character.
+    for (column = 0; column < entry->length; column += MAX7219_COLUMNS) {
+      rot_block[0] = MIN(MAX7219_COLUMNS, entry->length - column);
+      memcpy(&rot_block[1], &entry->strip[column], MAX7219_COLUMNS);
+      max7219_put_rotated(rot_block, position + column);
+    }
+    return;
+  }
+  for (column = 0; column < entry->length; column++) {
+    if ((position + column >= 0) && (position + column < tot_columns)) {
+      display_buffer[position + column] = entry->strip[column];
+    }
+  }
+}
+#endif
+
+// Put the glyphs of a string in the display buffer one by one. Without the
+// cache. The spacing between the glyphs is cleared. Like in a cached strip.
+static void max7219_glyphs_fill_buffer(char *buf_to_send, int position) {
+  const char *next = buf_to_send;
   int y;
-  uint8_t char_value;
-  for (x = 0; x < tot_chars; x++) {
-    // make the character value an int for font table lookup.
-    char_value = (uint8_t)buf_to_send[x];
-    // we only have chars of ascii below 128
-    if (char_value < 128) {
-      // Grep fontbitmap and add to each display buffer line
-      // First byte in font char bitmap array is length of char.
+  int width;
+  uint32_t char_value;
+  const u_int8_t *glyph;
+  u_int8_t rot_char[MAX7219_COLUMNS + 1];
+  while (*next) {
+    // UTF8 decoded into the code point for the font lookup.
+    char_value = fonts_utf8_next(&next);
+    width = fonts_glyph(char_value, &glyph);
+    if (width >= 0) {
+      if (disp.rotate90) {
+        // Turn the columns of the glyph into rows. Put all columns in one go
+        // The spacing column is empty. Not after the last character.
+        rot_char[0] = (*next) ? width + 1 : width;
+        memset(&rot_char[1], 0, MAX7219_COLUMNS);
+        memcpy(&rot_char[1], glyph, width);
+        max7219_transpose(&rot_char[1], 1, true);
+        max7219_put_rotated(rot_char, position);
+        position += width + 1;
+        continue;
+      }
+      // Grep font columns and add to each display buffer line
       // Start at amount of columns needed for alignment
-      for (y = 1; y <= font_8x8[char_value][0]; y++) {
+      for (y = 0; y < width; y++) {
         // testing that we not overrun display buffer
-        if ((position >= 0) & (position < MAX7219_TOT_COLUMNS)) {
-          display_buffer[position] = font_8x8[char_value][y];
+        if ((position >= 0) & (position < tot_columns)) {
+          display_buffer[position] = glyph[y];
         }
         position++;
       }  // Finished with 1 character
-      // add character spacing. This has no effect on last character
+      // add character spacing. Not after the last character
+      if ((*next) && (position >= 0) && (position < tot_columns)) {
+        display_buffer[position] = 0x00;
+      }
       position++;
     } else {
-      ESP_LOGE(TAG, "We do not support ASCII greater than 127");
+      ESP_LOGE(TAG, "No glyph for character U+%04X", char_value);
       return;
     }
   }
 }
 
+void max7219_sprite_fill_buffer(char *buf_to_send, int position) {
+  //ESP_LOGI(TAG, "Start filling Display buffer");
+#ifdef MAX7219_STRIP_CACHE
+  strip_cache_entry_t *entry = max7219_strip_lookup(buf_to_send);
+  if (entry != NULL) {
+    max7219_strip_put(entry, position);
+    return;
+  }
+#endif
+  max7219_glyphs_fill_buffer(buf_to_send, position);
+}
+
+// Transpose 8x8 bits of each max7219 in one uint64_t with 3 delta swaps.
+// Byte x of a block is column x and bit b is row b. After the swaps byte b
+// has row b with bit x for column x. The display buffer of rotated
+// displays has its rows in reverse order. (register 1 is the bottom row)
+// So the bytes are also swapped. ESP32 is little endian.
+void max7219_transpose(u_int8_t *buffer, int modules, bool to_rows) {
+  uint64_t x;
+  uint64_t t;
+  int module;
+  for (module = 0; module < modules; module++) {
+    memcpy(&x, &buffer[module * MAX7219_COLUMNS], sizeof(x));
+    if (!to_rows) {
+      x = __builtin_bswap64(x);
+    }
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    if (to_rows) {
+      x = __builtin_bswap64(x);
+    }
+    memcpy(&buffer[module * MAX7219_COLUMNS], &x, sizeof(x));
+  }
+}
+
+int max7219_render_columns(char *buf_to_send, u_int8_t *columns, int length) {
+  const char *next = buf_to_send;
+  int position = 0;
+  int next_char = 0;
+  int y;
+  int width;
+  uint32_t char_value;
+  const u_int8_t *glyph;
+  while (*next) {
+    char_value = fonts_utf8_next(&next);
+    width = fonts_glyph(char_value, &glyph);
+    if (width < 0) {
+      ESP_LOGE(TAG, "No glyph for character U+%04X", char_value);
+      break;
+    }
+    // add character spacing before all but the first character
+    if ((next_char > 0) && (position < length)) {
+      columns[position++] = 0x00;
+    }
+    for (y = 0; (y < width) && (position < length); y++) {
+      columns[position++] = glyph[y];
+    }
+    next_char++;
+  }
+  return position;
+}
+
+void max7219_get_columns(u_int8_t *columns) {
+  memcpy(columns, display_buffer, tot_columns);
+  if (disp.rotate90) {
+    max7219_transpose(columns, disp.count, false);
+  }
+}
+
+esp_err_t max7219_get_image(u_int8_t *columns) {
+  esp_err_t ret = ESP_OK;
+  int chip;
+  int module;
+  int row;
+#ifdef MAX7219_GRAYSCALE
+  // The shadow only has the bit plane sent last
+  if (max7219_gray_showing()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+#endif
+#ifdef MAX7219_FLUSH_TASK
+  // The flush task changes the shadow while it sends a frame
+  xSemaphoreTake(spi_mutex, portMAX_DELAY);
+#endif
+  if (shadow_valid) {
+    // Undo max7219_fill_row. Chip 0 gets the last data in the chain.
+    for (chip = 0; chip < disp.count; chip++) {
+      if (disp.reverse) {
+        module = chip;
+      } else {
+        module = disp.count - 1 - chip;
+      }
+      for (row = 0; row < MAX7219_COLUMNS; row++) {
+        columns[(module * MAX7219_COLUMNS) + row] = shadow_buffer[row][chip];
+      }
+    }
+  } else {
+    ret = ESP_ERR_INVALID_STATE;
+  }
+#ifdef MAX7219_FLUSH_TASK
+  xSemaphoreGive(spi_mutex);
+#endif
+  if ((ret == ESP_OK) && disp.rotate90) {
+    max7219_transpose(columns, disp.count, false);
+  }
+  return ret;
+}
+
+void max7219_sprite_fill_columns(const u_int8_t *columns, int position, int length) {
+  // Cut off the columns outside of the display buffer
+  if (position < 0) {
+    columns -= position;
+    length += position;
+    position = 0;
+  }
+  if (position + length > tot_columns) {
+    length = tot_columns - position;
+  }
+  if (length <= 0) {
+    return;
+  }
+  if (disp.rotate90) {
+    // The whole display buffer is turned into columns and back.
+    // With the transpose this is faster than setting single bits.
+    max7219_transpose(display_buffer, disp.count, false);
+    memcpy(&display_buffer[position], columns, length);
+    max7219_transpose(display_buffer, disp.count, true);
+  } else {
+    memcpy(&display_buffer[position], columns, length);
+  }
+}
+
 // ascii buffer will be displayed. This is just for easy displaying of text
 // Left, Middle or Right alignment of text is possible
 void max7219_fill_display_buffer(char *buf_to_send, int align) {
   // ESP_LOGI(TAG, "Sending string to display");
   int cols = 0;
   int shift_cols = 0;  // for calculating the amount of columns to be shifted.
+#ifdef MAX7219_STRIP_CACHE
+  // The cache knows the length. No need to walk the string again.
+  strip_cache_entry_t *entry = max7219_strip_lookup(buf_to_send);
+  if (entry != NULL) {
+    cols = entry->length;
+  } else {
+    cols = max7219_sprite_get_length(buf_to_send);
+  }
+#else
   cols = max7219_sprite_get_length(buf_to_send);
+#endif
   // we now have the amount of colums to display
   // test for alignment
-  if ((align == MAX7219_ALIGN_MIDDLE) & (cols <= MAX7219_TOT_COLUMNS)) {
-    shift_cols = (MAX7219_TOT_COLUMNS - cols) / 2;
+  if ((align == MAX7219_ALIGN_MIDDLE) & (cols <= tot_columns)) {
+    shift_cols = (tot_columns - cols) / 2;
   }
-  if ((align == MAX7219_ALIGN_RIGHT) & (cols <= MAX7219_TOT_COLUMNS)) {
-    shift_cols = (MAX7219_TOT_COLUMNS - cols);
+  if ((align == MAX7219_ALIGN_RIGHT) & (cols <= tot_columns)) {
+    shift_cols = (tot_columns - cols);
   }
 
   // We now know the length of the string in max7219 display columns.
@@ -257,7 +787,15 @@ void max7219_fill_display_buffer(char *buf_to_send, int align) {
 
   // Fill displaybuffer
   max7219_empty_display_buffer();
-  max7219_sprite_fill_buffer(buf_to_send, shift_cols);
+#ifdef MAX7219_STRIP_CACHE
+  // Looked up once. Not again in max7219_sprite_fill_buffer
+  if (entry != NULL) {
+    max7219_strip_put(entry, shift_cols);
+    max7219_send_display();
+    return;
+  }
+#endif
+  max7219_glyphs_fill_buffer(buf_to_send, shift_cols);
   max7219_send_display();
 }
 
@@ -266,75 +804,570 @@ void max7219_set_brightness(int brightness) {
     ESP_LOGD(TAG, "Error, brightness cannot be set higher than 15");
     return;
   }
+  // A posted one is older
+  brightness_posted = -1;
   max7219_send_command(REGBRIGHT, brightness);
 }
 
+void max7219_post_brightness(int brightness) {
+  if (brightness > MAXBRIGHT) {
+    ESP_LOGD(TAG, "Error, brightness cannot be set higher than 15");
+    return;
+  }
+  brightness_posted = brightness;
+#ifdef MAX7219_FLUSH_TASK
+  xTaskNotifyGive(flush_task);
+#endif
+}
+
+// Write the brightness of max7219_post_brightness. With the flush task the
+// SPI mutex must be held.
+static void max7219_brightness_write(void) {
+  int brightness = __atomic_exchange_n(&brightness_posted, -1, __ATOMIC_SEQ_CST);
+  if (brightness >= 0) {
+    max7219_batch_add(REGBRIGHT, brightness);
+    max7219_batch_send();
+  }
+}
+
+// Same value to the register of all chips. In one frame.
 void max7219_send_command(u_int8_t reg_type, u_int8_t reg_value) {
-  int module;
   // ESP_LOGI(TAG, "Send command %d to register %d", reg_value, reg_type);
-  for (module = 0; module < MAX7219_COUNT * 2; module += 2) {
-    send_buffer[module] = reg_type;
-    send_buffer[module + 1] = reg_value;
-    max7219_send_buffer();
+#ifdef MAX7219_FLUSH_TASK
+  xSemaphoreTake(spi_mutex, portMAX_DELAY);
+#endif
+  max7219_batch_add(reg_type, reg_value);
+  max7219_batch_send();
+#ifdef MAX7219_FLUSH_TASK
+  xSemaphoreGive(spi_mutex);
+#endif
+}
+
+// Add a frame with a value for the register of each chip to the batch.
+// Values are for the modules from the left side of the display. A full
+// batch is sent first. With the flush task the SPI mutex must be held.
+static void max7219_batch_add_values(u_int8_t reg_type, const u_int8_t *values) {
+  u_int8_t *frame;
+  int chip;
+  if (batch_count >= MAX7219_BATCH) {
+    max7219_batch_send();
   }
+  frame = &batch_buffer[batch_count * disp.count * 2];
+  for (chip = 0; chip < disp.count; chip++) {
+    // Same chain order as the rows. See max7219_fill_row
+    frame[chip * 2] = reg_type;
+    if (disp.reverse) {
+      frame[chip * 2 + 1] = values[chip];
+    } else {
+      frame[chip * 2 + 1] = values[disp.count - 1 - chip];
+    }
+  }
+  batch_count++;
 }
 
-// Here the bitmap from the display buffer is send
-// to the display. SPI aquire could be used here.
-// to speed up SPI
-void max7219_send_display(void) {
-  // ESP_LOGI(TAG, "Display buffer is being sent");
+// Add a frame with the same value for the register of all chips
+static void max7219_batch_add(u_int8_t reg_type, u_int8_t reg_value) {
+  u_int8_t values[MAX7219_MAX_COUNT];
+  memset(values, reg_value, disp.count);
+  max7219_batch_add_values(reg_type, values);
+}
 
-#ifdef MAX7219_ROTATE90
-  // display buffer needs 8x8 90 degree rotation.
-  // Only tested for 8x8 displays
-  ////ESP_LOGI(TAG, "Rotate display");
+// Send the frames of the batch. 1 transaction for each. With the flush
+// task the SPI mutex must be held. So the bus is taken once for the whole
+// batch.
+static esp_err_t max7219_batch_send(void) {
+  esp_err_t ret = ESP_OK;
+  int64_t command_start = esp_timer_get_time();
+  uint32_t command_us;
+  int frame;
+  // Polling and queued transactions can not be mixed. Let the frame finish.
+  max7219_collect_rows();
+  for (frame = 0; frame < batch_count; frame++) {
+    batch_trans.tx_buffer = &batch_buffer[frame * disp.count * 2];
+    if (spi_device_polling_transmit(max7219_dev, &batch_trans) != ESP_OK) {
+      ESP_LOGE(TAG, "Error in sending SPI data");
+      ret = ESP_FAIL;
+    }
+  }
+  command_us = (uint32_t)(esp_timer_get_time() - command_start);
+  flush_stats.commands += batch_count;
+  flush_stats.command_us_last = command_us;
+  if (command_us > flush_stats.command_us_max) {
+    flush_stats.command_us_max = command_us;
+  }
+  batch_count = 0;
+  return ret;
+}
+
+// Fill the buffer for 1 row (max7219 digit register) of all chips.
+// Buffer has register and value for each chip side by side.
+static void max7219_fill_row(const u_int8_t *frame, int row, u_int8_t *row_buffer) {
+  int chip;
+  int module;
+  // With rotate90 the display buffer already has rows. So
+  // both types of displays are filled the same.
+  for (chip = 0; chip < disp.count; chip++) {
+    row_buffer[chip * 2] = row + 1;  // which digit register to use
+    // The last display in the sendbuffer is the left display
+    // reverse picking the lines from display buffer.
+    // Unless the chain starts on the right side of the display.
+    if (disp.reverse) {
+      module = chip;
+    } else {
+      module = disp.count - 1 - chip;
+    }
+    row_buffer[chip * 2 + 1] = frame[(module * MAX7219_COLUMNS) + row];  // value
+  }
+}
+
+// Compare a filled row with the shadow copy of the display. Chips with
+// unchanged data get a no-op. Returns 0 when nothing changed in the row
+// and the row does not need to be sent.
+static int max7219_diff_row(int row, u_int8_t *row_buffer) {
   int chip;
-  int bitpos;
+  int changed = 0;
+  for (chip = 0; chip < disp.count; chip++) {
+    if (shadow_valid && (row_buffer[chip * 2 + 1] == shadow_buffer[row][chip])) {
+      row_buffer[chip * 2] = REGNOOP;
+      row_buffer[chip * 2 + 1] = 0x00;
+    } else {
+      shadow_buffer[row][chip] = row_buffer[chip * 2 + 1];
+      changed = 1;
+    }
+  }
+  if (changed) {
+    flush_stats.rows_sent++;
+  } else {
+    flush_stats.rows_skipped++;
+  }
+  return changed;
+}
+
+// Keep the flush timing. Can be called from the SPI interrupt.
+static void IRAM_ATTR max7219_flush_time(uint32_t flush_us) {
+  flush_stats.flush_count++;
+  flush_stats.flush_us_last = flush_us;
+  if (flush_us > flush_stats.flush_us_max) {
+    flush_stats.flush_us_max = flush_us;
+  }
+  if (flush_stats.flush_us_avg == 0) {
+    flush_stats.flush_us_avg = flush_us;
+  } else {
+    flush_stats.flush_us_avg = ((flush_stats.flush_us_avg * 7) + flush_us) / 8;
+  }
+}
+
+// Keep the event to photon time. Can be called from the SPI interrupt.
+static void IRAM_ATTR max7219_latency_time(void) {
+  uint32_t latency_us;
+  if (flush_event_us == 0) {
+    return;
+  }
+  latency_us = (uint32_t)(esp_timer_get_time() - flush_event_us);
+  flush_event_us = 0;
+  flush_stats.latency_count++;
+  flush_stats.latency_us_last = latency_us;
+  if (latency_us > flush_stats.latency_us_max) {
+    flush_stats.latency_us_max = latency_us;
+  }
+  if (flush_stats.latency_us_avg == 0) {
+    flush_stats.latency_us_avg = latency_us;
+  } else {
+    flush_stats.latency_us_avg = ((flush_stats.latency_us_avg * 7) + latency_us) / 8;
+  }
+}
+
+// A row of the frame is sent. Or could not be queued. After the last one
+// the frame is on the display. Called from the SPI interrupt and from the
+// task queueing the rows. So counted down in one go.
+static void IRAM_ATTR max7219_row_done(void) {
+  if (__atomic_sub_fetch(&flush_rows_pending, 1, __ATOMIC_SEQ_CST) == 0) {
+    max7219_flush_time((uint32_t)(esp_timer_get_time() - flush_start));
+    max7219_latency_time();
+    if (flush_done != NULL) {
+      flush_done();
+    }
+  }
+}
+
+// Called by the SPI driver from interrupt after each transaction.
+// Rows have their row number + 1 in the user field.
+static void IRAM_ATTR max7219_post_cb(spi_transaction_t *trans) {
+  if (trans->user != NULL) {
+    max7219_row_done();
+  }
+}
+
+// Collect all finished row transactions of the last frame. With the
+// flush task the SPI mutex must be held.
+static void max7219_collect_rows(void) {
+#ifdef MAX7219_QUEUED_FLUSH
+  spi_transaction_t *done_trans;
+  while (flush_in_flight > 0) {
+    if (spi_device_get_trans_result(max7219_dev, &done_trans, portMAX_DELAY) != ESP_OK) {
+      ESP_LOGE(TAG, "Error in waiting for SPI data");
+    }
+    flush_in_flight--;
+  }
+#endif
+}
+
+void max7219_wait_display(void) {
+#ifdef MAX7219_FLUSH_TASK
+  // The flush task holds the mutex until its frame is sent
+  xSemaphoreTake(spi_mutex, portMAX_DELAY);
+  max7219_collect_rows();
+  xSemaphoreGive(spi_mutex);
+#else
+  max7219_collect_rows();
+#endif
+}
+
+void max7219_mark_event(int64_t event_us) {
+  // Keep the oldest event when several come before a frame is drawn
+  if (next_event_us == 0) {
+    next_event_us = event_us;
+  }
+}
+
+void max7219_set_flush_done_cb(void (*flush_done_cb)(void)) {
+  flush_done = flush_done_cb;
+}
+
+void max7219_get_flush_stats(max7219_flush_stats_t *stats) {
+  *stats = flush_stats;
+}
+
+void max7219_get_cache_stats(max7219_cache_stats_t *stats) {
+  *stats = cache_stats;
+}
+
+#ifdef MAX7219_QUEUED_FLUSH
+// Fill the row buffers of the transactions from a frame. Only rows with
+// changes are marked in the returned bit mask. The row transactions of the
+// last frame must be collected first.
+static int max7219_build_rows(const u_int8_t *frame) {
+  int rows_to_send = 0;
+  int row;
+  // Once in a while send everything
+  if (--flushes_to_refresh <= 0) {
+    shadow_valid = 0;
+    flushes_to_refresh = MAX7219_FULL_REFRESH;
+  }
+  for (row = 0; row < MAX7219_COLUMNS; row++) {
+    max7219_fill_row(frame, row, flush_buffer[row]);
+    if (max7219_diff_row(row, flush_buffer[row])) {
+      rows_to_send |= 1 << row;
+    }
+  }
+  shadow_valid = 1;
+  return rows_to_send;
+}
+
+// Queue the changed rows in one go. The SPI interrupt counts them down.
+// All are counted before the first is queued. So the first rows sent do
+// not finish the frame.
+static void max7219_queue_rows(int rows_to_send) {
+  int row;
+  flush_start = esp_timer_get_time();
+  __atomic_store_n(&flush_rows_pending, __builtin_popcount(rows_to_send), __ATOMIC_SEQ_CST);
+  for (row = 0; row < MAX7219_COLUMNS; row++) {
+    if (rows_to_send & (1 << row)) {
+      if (spi_device_queue_trans(max7219_dev, &flush_trans[row], 0) == ESP_OK) {
+        flush_in_flight++;
+      } else {
+        ESP_LOGE(TAG, "Error in queueing SPI data");
+        max7219_row_done();
+      }
+    }
+  }
+  if (rows_to_send == 0) {
+    // Nothing changed. Display is already up to date. Nothing sent so no
+    // flush time. Counted in rows_skipped
+    max7219_latency_time();
+    if (flush_done != NULL) {
+      flush_done();
+    }
+  }
+}
+#endif
+
+#ifdef MAX7219_GRAYSCALE
+// Runs in the esp_timer task. Wakes the flush task when a plane starts.
+// Plane n starts at slot 2^n - 1 of the cycle.
+static void max7219_gray_tick(void *arg) {
+  uint32_t slot = gray_ticks % MAX7219_GRAY_MAX_LEVEL;
+  gray_ticks++;
+  if (((slot + 1) & slot) == 0) {
+    xTaskNotifyGive(flush_task);
+  }
+}
+
+// Fill the row buffers with the plane of the current slot. Called by the
+// flush task with the frame mutex. Returns the rows to send. Or -1 when
+// that plane is already on the display.
+static int max7219_gray_build_plane(void) {
+  uint32_t slot = (gray_ticks - 1) % MAX7219_GRAY_MAX_LEVEL;
+  int plane = 0;
+  int64_t now;
+  uint32_t cycle_us;
+  while ((slot + 1) >> (plane + 1)) {
+    plane++;
+  }
+  if (plane == gray_plane_shown) {
+    return -1;
+  }
+  if (((slot + 1) & slot) != 0) {
+    // Woken up after the tick the plane should have started
+    gray_stats.planes_late++;
+  }
+  if (plane == 0) {
+    now = esp_timer_get_time();
+    if (gray_cycle_start != 0) {
+      cycle_us = (uint32_t)(now - gray_cycle_start);
+      gray_stats.cycles++;
+      gray_stats.cycle_us_last = cycle_us;
+      if (cycle_us > gray_stats.cycle_us_max) {
+        gray_stats.cycle_us_max = cycle_us;
+      }
+    }
+    gray_cycle_start = now;
+  }
+  gray_plane_shown = plane;
+  gray_stats.planes_sent++;
+  return max7219_build_rows(gray_planes[plane]);
+}
+
+// Allocate the planes and estimate the refresh rate. A plane is at most 8
+// row transactions of 16 bits for each max7219.
+static esp_err_t max7219_gray_init(void) {
+  int plane;
+  const esp_timer_create_args_t timer_args = {.callback = &max7219_gray_tick,
+                                              .name = "grayplanes"};
+  for (plane = 0; plane < MAX7219_GRAY_BITS; plane++) {
+    gray_draw[plane] = calloc(tot_columns, 1);
+    gray_planes[plane] = calloc(tot_columns, 1);
+    if ((gray_draw[plane] == NULL) || (gray_planes[plane] == NULL)) {
+      ESP_LOGE(TAG, "No memory for grayscale planes");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  gray_stats.frame_us_estimate =
+      MAX7219_COLUMNS *
+      (((uint32_t)disp.count * 16 * 1000000 / MAX7219_SPISPEED) + MAX7219_GRAY_ROW_US);
+  // A quarter extra for the flush task to wake up
+  gray_stats.tick_us =
+      MAX(MAX7219_GRAY_TICK_US, gray_stats.frame_us_estimate + (gray_stats.frame_us_estimate / 4));
+  gray_stats.max_hz = 1000000 / (gray_stats.tick_us * MAX7219_GRAY_MAX_LEVEL);
+  ESP_LOGI(TAG, "Grayscale plane %dus. Tick %dus. Refresh %dHz", gray_stats.frame_us_estimate,
+           gray_stats.tick_us, gray_stats.max_hz);
+  if (esp_timer_create(&timer_args, &gray_timer) != ESP_OK) {
+    ESP_LOGE(TAG, "Error in creating grayscale timer");
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+// Stop sending the planes. The flush task goes back to normal frames
+static void max7219_gray_hide(void) {
+  if (!gray_showing_planes) {
+    return;
+  }
+  esp_timer_stop(gray_timer);
+  xSemaphoreTake(frame_mutex, portMAX_DELAY);
+  gray_showing_planes = false;
+  gray_plane_shown = -1;
+  gray_cycle_start = 0;
+  xSemaphoreGive(frame_mutex);
+  vTaskPrioritySet(flush_task, MAX7219_FLUSH_TASK_PRIO);
+}
+
+void max7219_gray_clear(void) {
+  int plane;
+  for (plane = 0; plane < MAX7219_GRAY_BITS; plane++) {
+    memset(gray_draw[plane], 0, tot_columns);
+  }
+}
+
+void max7219_gray_from_display(void) {
+  int plane;
+  max7219_get_columns(gray_draw[0]);
+  for (plane = 1; plane < MAX7219_GRAY_BITS; plane++) {
+    memcpy(gray_draw[plane], gray_draw[0], tot_columns);
+  }
+}
+
+void max7219_gray_fill_columns(const u_int8_t *columns, int position, int length, int level) {
+  int plane;
   int x;
-  u_int8_t bit_to_read = 128;  // set highest bit as starting point
-  u_int8_t bit_to_set;
-  // bitpos reads each bit in a byte from the displaybuffer
-  for (bitpos = 0; bitpos < 8; bitpos++) {
-    // For each bit position in displaybuffer array we need
-    // to read it and write it to the same max7219
-    // register. But to ascending bit positions.
-    // bit_to_read is used as mask to read correct bit from byte
-    // in displaybuffer.
-    for (chip = 0; chip < MAX7219_COUNT; chip++) {
-      // Empty sendbuffer bits and set register in buffer
-      send_buffer[chip * 2] = bitpos + 1;  // max7219 display register
-      send_buffer[chip * 2 + 1] = 0x00;    // clear value here. Less cpu
-      // loop over each bit to set in 1 max7219 display register.
-      // Rightmost max7219 display needs to be written
-      // first in send string.
-      bit_to_set = 1;
-      for (x = 0; x < 8; x++) {
-        if (display_buffer[(((MAX7219_COUNT - 1 - chip) * 8) + x)] & bit_to_read) {
-          // we have a 1 value bit in displaybuffer byte and bit
-          send_buffer[((chip * 2) + 1)] |= bit_to_set;
-        }
-        bit_to_set = bit_to_set << 1;
+  // Cut off the columns outside of the display
+  if (position < 0) {
+    columns -= position;
+    length += position;
+    position = 0;
+  }
+  if (position + length > tot_columns) {
+    length = tot_columns - position;
+  }
+  for (plane = 0; plane < MAX7219_GRAY_BITS; plane++) {
+    for (x = 0; x < length; x++) {
+      if (level & (1 << plane)) {
+        gray_draw[plane][position + x] |= columns[x];
+      } else {
+        gray_draw[plane][position + x] &= ~columns[x];
+      }
+    }
+  }
+}
+
+esp_err_t max7219_gray_show(void) {
+  int plane;
+  bool start_timer;
+  if (gray_stats.max_hz < MAX7219_GRAY_MIN_HZ) {
+    ESP_LOGD(TAG, "Grayscale refresh %dHz is too slow", gray_stats.max_hz);
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  xSemaphoreTake(frame_mutex, portMAX_DELAY);
+  for (plane = 0; plane < MAX7219_GRAY_BITS; plane++) {
+    memcpy(gray_planes[plane], gray_draw[plane], tot_columns);
+    if (disp.rotate90) {
+      max7219_transpose(gray_planes[plane], disp.count, true);
+    }
+  }
+  // Event to photon time is only kept for normal frames
+  next_event_us = 0;
+  start_timer = !gray_showing_planes;
+  gray_showing_planes = true;
+  // Send the changed plane on the next tick
+  gray_plane_shown = -1;
+  xSemaphoreGive(frame_mutex);
+  if (start_timer) {
+    // Planes must be sent on time. Above the tasks drawing the frames
+    vTaskPrioritySet(flush_task, MAX7219_GRAY_TASK_PRIO);
+    gray_ticks = 0;
+    return esp_timer_start_periodic(gray_timer, gray_stats.tick_us);
+  }
+  return ESP_OK;
+}
+
+bool max7219_gray_showing(void) {
+  return gray_showing_planes;
+}
+
+void max7219_get_gray_stats(max7219_gray_stats_t *stats) {
+  *stats = gray_stats;
+}
+#endif
+
+#ifdef MAX7219_FLUSH_TASK
+// Sends the front buffer each time it is swapped. Waits until the frame is
+// completely sent before the SPI bus is released for commands.
+static void max7219_flush_task(void *args) {
+  int rows_to_send;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xSemaphoreTake(spi_mutex, portMAX_DELAY);
+    max7219_collect_rows();
+    max7219_brightness_write();
+    // The front buffer is only read here. Swapping waits for this.
+    xSemaphoreTake(frame_mutex, portMAX_DELAY);
+#ifdef MAX7219_GRAYSCALE
+    if (gray_showing_planes) {
+      rows_to_send = max7219_gray_build_plane();
+      xSemaphoreGive(frame_mutex);
+      if (rows_to_send >= 0) {
+        max7219_queue_rows(rows_to_send);
+        max7219_collect_rows();
       }
+      xSemaphoreGive(spi_mutex);
+      continue;
+    }
+#endif
+    if (!frame_ready) {
+      // Already sent with an earlier notification
+      xSemaphoreGive(frame_mutex);
+      xSemaphoreGive(spi_mutex);
+      continue;
     }
-    max7219_send_buffer();  // send each line
-    // advance to next bit that needs reading in displaybuffer
-    bit_to_read = bit_to_read >> 1;
+    rows_to_send = max7219_build_rows(front_buffer);
+    flush_event_us = frame_event_us;
+    frame_event_us = 0;
+    frame_ready = false;
+    xSemaphoreGive(frame_mutex);
+    max7219_queue_rows(rows_to_send);
+    max7219_collect_rows();
+    xSemaphoreGive(spi_mutex);
   }
+}
 #endif
 
-#ifndef MAX7219_ROTATE90
-  // Display columns do not need rotation
-  int col, chip;
-  for (col = 0; col < MAX7219_COLUMNS; col++) {
-    for (chip = 0; chip < MAX7219_COUNT; chip++) {
-      send_buffer[chip * 2] = col + 1;  // which column register to use
-      // The last display in the sendbuffer is the left display
-      // reverse picking the lines from display buffer
-      send_buffer[chip * 2 + 1] =
-          display_buffer[((MAX7219_COUNT - 1 - chip) * MAX7219_COLUMNS) + col];  // value
+// Here the bitmap from the display buffer is send to the display.
+// Only rows with changes are sent. With the queued flush these rows are
+// queued in one go as a list of transactions and this returns straight
+// away. The SPI driver sends them. Without it each row is send with a
+// blocking polling transmit.
+void max7219_send_display(void) {
+  // ESP_LOGI(TAG, "Display buffer is being sent");
+  int64_t call_start = esp_timer_get_time();
+  uint32_t call_us;
+#ifdef MAX7219_FLUSH_TASK
+  u_int8_t *drawn_buffer;
+#ifdef MAX7219_GRAYSCALE
+  // A normal frame replaces the grayscale frame
+  max7219_gray_hide();
+#endif
+  xSemaphoreTake(frame_mutex, portMAX_DELAY);
+  if (frame_ready) {
+    // Flush task did not get to the last frame. Only the newest is sent.
+    flush_stats.frames_dropped++;
+  }
+  drawn_buffer = display_buffer;
+  display_buffer = front_buffer;
+  front_buffer = drawn_buffer;
+  // Drawing continues on top of the last frame. Same as with one buffer.
+  memcpy(display_buffer, front_buffer, tot_columns);
+  if (frame_event_us == 0) {
+    frame_event_us = next_event_us;
+  }
+  next_event_us = 0;
+  frame_ready = true;
+  xSemaphoreGive(frame_mutex);
+  xTaskNotifyGive(flush_task);
+#elif defined(MAX7219_QUEUED_FLUSH)
+  // Normally the previous frame is long gone. Collect its transactions
+  // before the row buffers are overwritten.
+  max7219_collect_rows();
+  max7219_brightness_write();
+  flush_event_us = next_event_us;
+  next_event_us = 0;
+  max7219_queue_rows(max7219_build_rows(display_buffer));
+#else
+  int row;
+  bool rows_sent = false;
+  max7219_brightness_write();
+  // Once in a while send everything
+  if (--flushes_to_refresh <= 0) {
+    shadow_valid = 0;
+    flushes_to_refresh = MAX7219_FULL_REFRESH;
+  }
+  for (row = 0; row < MAX7219_COLUMNS; row++) {
+    max7219_fill_row(display_buffer, row, send_buffer);
+    if (max7219_diff_row(row, send_buffer)) {
+      max7219_send_buffer();  // send each changed line
+      rows_sent = true;
     }
-    max7219_send_buffer();  // send each line
   }
+  shadow_valid = 1;
+  if (rows_sent) {
+    max7219_flush_time((uint32_t)(esp_timer_get_time() - call_start));
+  }
+  flush_event_us = next_event_us;
+  next_event_us = 0;
+  max7219_latency_time();
 #endif
+  call_us = (uint32_t)(esp_timer_get_time() - call_start);
+  flush_stats.call_us_last = call_us;
+  if (call_us > flush_stats.call_us_max) {
+    flush_stats.call_us_max = call_us;
+  }
 }
@@ -14,6 +14,8 @@
 
 #include "driver/spi_master.h"
 #include "esp_err.h"
+#include "fonts.h"
+#include <stdbool.h>
 #include <sys/param.h>
 #include <sys/types.h>
 
@@ -24,26 +26,158 @@
 #define MAX7219_PIN_CLK 13
 #define MAX7219_PIN_CS 15
 //
+//Send a complete frame as one list of queued SPI transactions. The calling
+//task returns straight away and the SPI driver sends the 8 rows in the
+//background. Comment out to use the old blocking polling transmit per row.
+#define MAX7219_QUEUED_FLUSH
+//
+//Only rows (digit registers) which changed since the last flush are sent.
+//Once every so many flushes all rows are sent. This repairs the display
+//when a max7219 lost its data. (Noise on long wires)
+#define MAX7219_FULL_REFRESH 64
+//
+//Flush the display from its own low priority task. Drawing is done in the
+//back buffer. max7219_send_display swaps it with the front buffer and wakes
+//the flush task. So the display task never waits on the SPI bus. When a new
+//frame is ready before the last one is sent, only the newest is sent.
+//Needs MAX7219_QUEUED_FLUSH. Comment out to flush from the calling task.
+#define MAX7219_FLUSH_TASK
+#define MAX7219_FLUSH_TASK_CORE 1  // core the flush task is pinned to
+#define MAX7219_FLUSH_TASK_PRIO 3  // below the display task
+//
+//Cache for rendered strings. Strings are rendered once into a strip of
+//columns. Drawing the same string again is a copy of the strip. The least
+//recently used strip is replaced. Comment out to render each time.
+#define MAX7219_STRIP_CACHE 8         // number of cached strings
+#define MAX7219_STRIP_CACHE_TEXT 16   // longest string cached
+#define MAX7219_STRIP_CACHE_COLUMNS 64 // widest strip cached
+//
+//Grayscale with temporal dithering. The frame is split in bit planes.
+//Plane n is on the display for 2^n timer ticks. The flush task sends the
+//planes in turn. So each dot has (2^MAX7219_GRAY_BITS) - 1 levels besides
+//off. Only used when the chain can be refreshed fast enough. The flush of
+//a plane must fit in a tick. Needs MAX7219_FLUSH_TASK.
+//Comment out to leave the grayscale engine out.
+#define MAX7219_GRAYSCALE
+#define MAX7219_GRAY_BITS 2        // bit planes. 2 gives levels 0 - 3
+#define MAX7219_GRAY_TICK_US 1500  // shortest tick of the plane timer
+#define MAX7219_GRAY_MIN_HZ 100    // lowest full cycle rate without flicker
+#define MAX7219_GRAY_ROW_US 20     // time per row transaction besides the bits
+#define MAX7219_GRAY_TASK_PRIO 10  // flush task priority while showing planes
+#define MAX7219_GRAY_MAX_LEVEL ((1 << MAX7219_GRAY_BITS) - 1)
+//
 //Rotate 8x8 display 90 degrees clockwise
 //Some 4 * 8x8 matrix modules are 90 degrees off. (from china)
+//The display buffer then holds rows instead of columns and the text is
+//drawn with the glyphs turned into rows.
+//This is the default. It can be changed in the display settings.
 //#define MAX7219_ROTATE90 
 //
-#define MAX7219_COUNT 4   // number of max7219 daisy chained
+#define MAX7219_COUNT 4   // default number of max7219 daisy chained
+#define MAX7219_MAX_COUNT 64 // longest chain of max7219s supported
 #define MAX7219_COLUMNS 8 // number of columns driven by 1 max7219.
-#define MAX7219_TOT_COLUMNS ( MAX7219_COUNT * MAX7219_COLUMNS )
+#define MAX7219_TOT_COLUMNS ( MAX7219_COUNT * MAX7219_COLUMNS ) // default columns
+// DMA channel for the SPI bus. Chains longer than 32 do not fit the SPI fifo
+#define MAX7219_DMA_CHAN 2
+// Below is the name of the NVRAM var with the display settings
+#define NVFLASH_DISPLAYBLOB "display"
 // Align string to display left, right in the middle
 #define MAX7219_ALIGN_LEFT 1
 #define MAX7219_ALIGN_RIGHT 2
 #define MAX7219_ALIGN_MIDDLE 4
 #define MAXBRIGHT 0x0f  // Maximum brightness setting inside max7219 
 
-// Init SPI port
-esp_err_t max7219_init_spi(void);
+// Describes the chain of max7219s. Buffers are allocated on init with
+// these settings. Changes are used after a restart.
+typedef struct {
+  int count;      // number of max7219 daisy chained. 1 - MAX7219_MAX_COUNT
+  bool rotate90;  // 8x8 modules are 90 degrees off
+  bool reverse;   // chain starts at the right side. Normally the left side
+  char font[FONTS_NAME_LENGTH];  // name of the font. Empty is the default font
+} max7219_config_t;
+
+// Timing of the display flushes. All times in microseconds.
+// flush_us is the time from sending the first row until the last
+// row is on the display. call_us is the time the calling task was blocked.
+// With the queued flush these differ. With polling they are the same.
+// A flush with no changed rows sends nothing. It is not in the flush
+// times. Only in rows_skipped.
+typedef struct {
+  uint32_t flush_count;
+  uint32_t flush_us_last;
+  uint32_t flush_us_max;
+  uint32_t flush_us_avg;  // running average over the last flushes
+  uint32_t call_us_last;
+  uint32_t call_us_max;
+  uint32_t rows_sent;     // rows with changed data for at least one chip
+  uint32_t rows_skipped;  // rows not sent because nothing changed
+  uint32_t frames_dropped;  // frames replaced by a newer one before being sent
+  // Time from an input event (see max7219_mark_event) until the frame
+  // drawn after it is completely on the display.
+  uint32_t latency_count;
+  uint32_t latency_us_last;
+  uint32_t latency_us_max;
+  uint32_t latency_us_avg;
+  // Register writes (brightness, reset). 1 frame for all chips each.
+  uint32_t commands;
+  uint32_t command_us_last;  // time to send the last batch of writes
+  uint32_t command_us_max;
+} max7219_flush_stats_t;
+
+// Counters of the string strip cache
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;    // strings rendered and put in the cache
+  uint32_t uncached;  // strings too long or too wide for the cache. Or with a
+                      // character without glyph. Rendered each time
+} max7219_cache_stats_t;
+
+// Counters of the grayscale engine. A cycle is all planes once.
+// Planes late are ticks where the previous plane was not sent yet.
+typedef struct {
+  uint32_t tick_us;        // timer tick in use
+  uint32_t frame_us_estimate;  // time to send all rows of 1 plane
+  uint32_t max_hz;         // full cycles per second the chain allows
+  uint32_t cycles;
+  uint32_t planes_sent;
+  uint32_t planes_late;
+  uint32_t cycle_us_last;
+  uint32_t cycle_us_max;
+} max7219_gray_stats_t;
+
+// Init SPI port. And allocate the buffers for the chain of max7219s.
+// NULL uses the defaults from this header.
+esp_err_t max7219_init_spi(const max7219_config_t *config);
+
+// Get the display chain settings in use
+void max7219_get_config(max7219_config_t *config);
+
+// Get the width of the display in columns
+int max7219_get_width(void);
 
 // We have a display buffer with 1 byte for each column of 8 dots
 // Send display buffer to display
 void max7219_send_display(void);
 
+// Wait until the last queued frame is completely sent. Only needed when
+// the SPI bus is used for something else. Commands already wait.
+void max7219_wait_display(void);
+
+// Function called (from interrupt!) when a complete frame is on the display.
+// Keep it short. NULL disables the callback.
+void max7219_set_flush_done_cb(void (*flush_done_cb)(void));
+
+// Remember the time (esp_timer_get_time) of an input event. The next frame
+// sent with max7219_send_display is the answer to it. When that frame is
+// on the display the latency is added to the flush stats.
+void max7219_mark_event(int64_t event_us);
+
+// Copy of the flush timing counters
+void max7219_get_flush_stats(max7219_flush_stats_t *stats);
+
+// Copy of the string strip cache counters
+void max7219_get_cache_stats(max7219_cache_stats_t *stats);
+
 //Functions to fill or clear display buffer
 //get_length of the string you want to send. Used for calculating
 //positions in displaybuffer
@@ -55,13 +189,71 @@ void max7219_sprite_clear_buffer(int offset, uint length);
 // Fill the display buffer with certain string. And on certain position
 // Position can be (partially)outside of display buffer. Together with clear buffer
 // and the length of the string this allows for rolling displays.
+// The columns of the string and the spacing between the characters are
+// overwritten. Cached or not. Other columns are not changed.
 void max7219_sprite_fill_buffer(char *buf_to_send, int position);
 
+// Put a strip of columns (1 byte each. Bit 0 is the top row) in the display
+// buffer at a certain position. Position can be (partially) outside of the
+// display buffer. Used for pre-rendered text and animations.
+void max7219_sprite_fill_columns(const u_int8_t *columns, int position, int length);
+
+// Render a string into a strip of columns (1 byte each. Bit 0 is the top
+// row) with the same spacing as max7219_sprite_fill_buffer. Writes at most
+// length columns. Returns the amount of columns written.
+int max7219_render_columns(char *buf_to_send, u_int8_t *columns, int length);
+
+// Copy the display buffer as columns into a buffer of max7219_get_width() bytes
+void max7219_get_columns(u_int8_t *columns);
+
+// Decode what the max7219s show into columns like max7219_get_columns.
+// Read back from the shadow copy of the digit registers. So it is the
+// image after the chain order and rotation of the display are undone.
+// Returns ESP_ERR_INVALID_STATE until the first frame is sent. And while
+// a grayscale frame is shown. The chips then only have one bit plane.
+esp_err_t max7219_get_image(u_int8_t *columns);
+
+// Transpose the 8x8 bit blocks of a number of max7219s in place. Each block
+// is 8 bytes. to_rows true changes columns into rows as used in the display
+// buffer of rotated displays. False changes rows back into columns.
+void max7219_transpose(u_int8_t *buffer, int modules, bool to_rows);
+
 //Functions below calls above functions.
 //And are easier to use 
 void max7219_empty_display_buffer(void);
 void max7219_fill_display_buffer(char *buf_to_send, int align);
 
+#ifdef MAX7219_GRAYSCALE
+// Grayscale frames are drawn in separate bit planes. Levels are 0 (off)
+// up to MAX7219_GRAY_MAX_LEVEL (full on).
+// Clear the grayscale frame
+void max7219_gray_clear(void);
+
+// Copy the display buffer into the grayscale frame at full level
+void max7219_gray_from_display(void);
+
+// Put a strip of columns (1 byte each. Bit 0 is the top row) in the
+// grayscale frame. Dots which are on get the level. Other dots are not
+// changed. Position can be (partially) outside of the display.
+void max7219_gray_fill_columns(const u_int8_t *columns, int position, int length, int level);
+
+// Show the grayscale frame. The plane timer keeps sending the planes until
+// the next max7219_send_display. Returns ESP_ERR_NOT_SUPPORTED when the
+// chain is too long or the SPI clock too slow for MAX7219_GRAY_MIN_HZ.
+// Then show the display buffer instead.
+esp_err_t max7219_gray_show(void);
+
+// True while the grayscale frame is on the display
+bool max7219_gray_showing(void);
+
+// Copy of the grayscale counters
+void max7219_get_gray_stats(max7219_gray_stats_t *stats);
+#endif
+
 //brightness cannot be set higher than 15 (See datasheet)
 void max7219_set_brightness(int brightness);
+// Same without waiting for the SPI bus. For timer callbacks. The flush
+// task writes it. Without the flush task it is written with the next
+// frame.
+void max7219_post_brightness(int brightness);
 #endif
@@ -43,6 +43,9 @@ static const char *TAG = "NetStartStop";
 const int WIFI_CHANGE_EVENT = BIT0;
 static EventGroupHandle_t wifi_events;
 
+// IP address of the station as text. For showing on the display.
+static char ip_address[16] = "";
+
 // Arguments in the WIFI event handler
 typedef struct {
   int wifimode;
@@ -153,6 +156,7 @@ static void wifi_event_handler(void *from_task, esp_event_base_t event_base, int
     if (event_id == IP_EVENT_STA_GOT_IP) {
       ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
       ESP_LOGW(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+      snprintf(ip_address, sizeof(ip_address), IPSTR, IP2STR(&event->ip_info.ip));
       to_wifi_event->retry_cnt = 0;  // Reset count for retries of STA start.
     }
   }
@@ -164,6 +168,9 @@ static void wifi_event_handler(void *from_task, esp_event_base_t event_base, int
   }
   // Stop apps when we are sta only. And lose the ip address.
   // AP should never go down on event
+  if (event_id == IP_EVENT_STA_LOST_IP) {
+    ip_address[0] = 0;
+  }
   if ((event_id == IP_EVENT_STA_LOST_IP) && (to_wifi_event->wifimode == 3)) {
     ESP_LOGI(TAG, "Calling stop network apps");
     stop_network_apps();
@@ -417,6 +424,10 @@ void open_wifi_ap() {
   wifi_change_event();
 }
 
+void network_get_ip(char *ip_text, int length) {
+  strlcpy(ip_text, ip_address, length);
+}
+
 // Start mDNS (Bonjour)
 void start_stop_mDNS(bool action) {
   if (action == 1) {
@@ -23,4 +23,7 @@ void wifi_change_event();
 // Simple call to open up the ESP AP. Is used for last resort network setup.
 // This resets some parameters in setupparams
 void open_wifi_ap();
+
+// Copy the current IP address as text. Empty without a network.
+void network_get_ip(char *ip_text, int length);
 #endif
@@ -0,0 +1,151 @@
+/* Split from rotary_encoder.c. The decoding without any ESP-IDF parts.
+ * This file is GNU opensource. See comments below. Please respect this.
+ * Licenced under the GNU GPL Version 3. See LICENSE-GPLv3_rotaryEncoder
+ */
+
+/*
+ * Copyright (c) 2019 David Antliff
+ * Copyright 2011 Ben Buxton
+ *
+ * This file is part of the esp32-rotary-encoder component.
+ *
+ * esp32-rotary-encoder is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * esp32-rotary-encoder is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with esp32-rotary-encoder.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rotary_decoder.h"
+
+#include <stdlib.h>
+
+// See rotary_encoder.c for how the table decoding works.
+#define TABLE_COLS 4
+#define TABLE_ROWS 7
+
+// Create the half-step state table (emits a code at 00 and 11)
+#define R_START 0x0
+#define H_CCW_BEGIN 0x1
+#define H_CW_BEGIN 0x2
+#define H_START_M 0x3
+#define H_CW_BEGIN_M 0x4
+#define H_CCW_BEGIN_M 0x5
+
+static const uint8_t _ttable_half[TABLE_ROWS][TABLE_COLS] = {
+    // 00                  01              10            11                   // BA
+    {H_START_M, H_CW_BEGIN, H_CCW_BEGIN, R_START},             // R_START (00)
+    {H_START_M | DIR_CCW, R_START, H_CCW_BEGIN, R_START},      // H_CCW_BEGIN
+    {H_START_M | DIR_CW, H_CW_BEGIN, R_START, R_START},        // H_CW_BEGIN
+    {H_START_M, H_CCW_BEGIN_M, H_CW_BEGIN_M, R_START},         // H_START_M (11)
+    {H_START_M, H_START_M, H_CW_BEGIN_M, R_START | DIR_CW},    // H_CW_BEGIN_M
+    {H_START_M, H_CCW_BEGIN_M, H_START_M, R_START | DIR_CCW},  // H_CCW_BEGIN_M
+};
+
+// Create the full-step state table (emits a code at 00 only)
+#define F_CW_FINAL 0x1
+#define F_CW_BEGIN 0x2
+#define F_CW_NEXT 0x3
+#define F_CCW_BEGIN 0x4
+#define F_CCW_FINAL 0x5
+#define F_CCW_NEXT 0x6
+
+static const uint8_t _ttable_full[TABLE_ROWS][TABLE_COLS] = {
+    // 00        01           10           11                  // BA
+    {R_START, F_CW_BEGIN, F_CCW_BEGIN, R_START},            // R_START
+    {F_CW_NEXT, R_START, F_CW_FINAL, R_START | DIR_CW},     // F_CW_FINAL
+    {F_CW_NEXT, F_CW_BEGIN, R_START, R_START},              // F_CW_BEGIN
+    {F_CW_NEXT, F_CW_BEGIN, F_CW_FINAL, R_START},           // F_CW_NEXT
+    {F_CCW_NEXT, R_START, F_CCW_BEGIN, R_START},            // F_CCW_BEGIN
+    {F_CCW_NEXT, F_CCW_FINAL, R_START, R_START | DIR_CCW},  // F_CCW_FINAL
+    {F_CCW_NEXT, F_CCW_FINAL, F_CCW_BEGIN, R_START},        // F_CCW_NEXT
+};
+
+void rotary_decoder_init(rotary_decoder_t *decoder, bool half_step) {
+  decoder->table = half_step ? &_ttable_half[0] : &_ttable_full[0];
+  decoder->table_state = R_START;
+}
+
+uint8_t rotary_decoder_step(rotary_decoder_t *decoder, uint8_t pin_state) {
+  // Determine new state from the pins and state table.
+  decoder->table_state = decoder->table[decoder->table_state & 0xf][pin_state & 0x3];
+  // AND state to only return direction bits from state table
+  // Will only return the DIR_CW or DIR_CCW bits and zero for most states
+  return decoder->table_state & 0x30;
+}
+
+int32_t rotary_decoder_pcnt_counts(int16_t last, int16_t now, int16_t limit) {
+  int32_t counts = (int32_t)now - last;
+  // The counter jumped back to zero at a limit in between
+  if (counts > limit / 2) {
+    counts -= limit;
+  } else if (counts < -(limit / 2)) {
+    counts += limit;
+  }
+  return counts;
+}
+
+int rotary_decoder_detents(int32_t *counts, int counts_per_detent) {
+  // C division truncates to zero. The rest keeps the sign of counts
+  int detents = *counts / counts_per_detent;
+  *counts -= detents * counts_per_detent;
+  return detents;
+}
+
+void rotary_decoder_accel_init(rotary_accel_t *accel, const rotary_accel_point_t *curve,
+                               int points, uint32_t reset_us) {
+  accel->curve = curve;
+  accel->points = points;
+  accel->reset_us = reset_us;
+  accel->detent_time = 0;
+  accel->direction = 0;
+  accel->interval_us = 0;
+  accel->velocity = 0;
+  accel->velocity_max = 0;
+  accel->steps = 0;
+}
+
+int rotary_decoder_accelerate(rotary_accel_t *accel, int detents, int64_t now) {
+  int direction = (detents < 0) ? -1 : 1;
+  int64_t interval;
+  int steps = 1;
+  int x;
+  if (detents == 0) {
+    return 0;
+  }
+  // More detents at once share the time since the last one
+  interval = (now - accel->detent_time) / abs(detents);
+  accel->detent_time = now;
+  if ((direction != accel->direction) || (interval > accel->reset_us) || (interval <= 0)) {
+    // Starts turning or turns back. Slow
+    accel->direction = direction;
+    accel->interval_us = 0;
+    accel->velocity = 0;
+  } else {
+    // Smooth out the bounces and uneven turning of a hand
+    if (accel->interval_us == 0) {
+      accel->interval_us = (uint32_t)interval;
+    } else {
+      accel->interval_us = ((accel->interval_us * 3) + (uint32_t)interval) / 4;
+    }
+    accel->velocity = 1000000 / accel->interval_us;
+    if (accel->velocity > accel->velocity_max) {
+      accel->velocity_max = accel->velocity;
+    }
+  }
+  for (x = 0; (accel->curve != NULL) && (x < accel->points); x++) {
+    if (accel->velocity >= accel->curve[x].velocity) {
+      steps = accel->curve[x].steps;
+      break;
+    }
+  }
+  accel->steps += steps * abs(detents);
+  return steps * detents;
+}
@@ -0,0 +1,94 @@
+/* Split from rotary_encoder.c. The decoding without any ESP-IDF parts.
+ * This file is GNU opensource. See comments below. Please respect this.
+ * Licenced under the GNU GPL Version 3. See LICENSE-GPLv3_rotaryEncoder
+ */
+
+/*
+ * Copyright (c) 2019 David Antliff
+ * Copyright 2011 Ben Buxton
+ *
+ * This file is part of the esp32-rotary-encoder component.
+ *
+ * esp32-rotary-encoder is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * esp32-rotary-encoder is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with esp32-rotary-encoder.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROTARY_DECODER_H_
+#define ROTARY_DECODER_H_
+
+// Decoding of the encoder signals. Only plain C. No hardware. Used by
+// both backends in rotary_encoder.c and can be compiled on a host.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DIR_NONE 0x0  // No complete step yet.
+#define DIR_CW 0x10   // Clockwise step.
+#define DIR_CCW 0x20  // Anti-clockwise step.
+
+// State of the table decoder for the GPIO backend
+typedef struct {
+  const uint8_t (*table)[4];  // Pointer to active state transition table
+  uint8_t table_state;        // Internal state
+} rotary_decoder_t;
+
+// One point of the acceleration curve
+typedef struct {
+  uint32_t velocity;  // detents per second and faster
+  int steps;          // steps for one detent
+} rotary_accel_point_t;
+
+// State of the acceleration
+typedef struct {
+  const rotary_accel_point_t *curve;  // From fast to slow. NULL is no acceleration
+  int points;
+  uint32_t reset_us;     // pause after which the speed starts from zero
+  int64_t detent_time;   // time of the last detent
+  int direction;         // of the last detent. 1 or -1
+  uint32_t interval_us;  // smoothed time between detents. 0 is standing still
+  uint32_t velocity;     // detents per second. Of the last detent
+  uint32_t velocity_max;
+  uint32_t steps;        // all steps returned
+} rotary_accel_t;
+
+// Start the table decoder. Full step emits at 00 only. Half step also at 11.
+void rotary_decoder_init(rotary_decoder_t *decoder, bool half_step);
+
+// Feed the pin state (B << 1 | A) after an edge. Returns DIR_CW, DIR_CCW
+// when a detent is complete. Else DIR_NONE.
+uint8_t rotary_decoder_step(rotary_decoder_t *decoder, uint8_t pin_state);
+
+// Counts between two reads of a pulse counter which resets to zero at
+// plus and minus limit. Right as long as less than limit/2 counts passed.
+int32_t rotary_decoder_pcnt_counts(int16_t last, int16_t now, int16_t limit);
+
+// Whole detents in counts. The rest stays in counts for the next time.
+int rotary_decoder_detents(int32_t *counts, int counts_per_detent);
+
+// Start the acceleration with a curve. The curve is not copied.
+void rotary_decoder_accel_init(rotary_accel_t *accel, const rotary_accel_point_t *curve,
+                               int points, uint32_t reset_us);
+
+// Steps for detents turned at time now (us). Detents is signed. Negative
+// is counter clockwise. Returns signed steps.
+int rotary_decoder_accelerate(rotary_accel_t *accel, int detents, int64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ROTARY_DECODER_H_
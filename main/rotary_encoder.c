@@ -97,15 +97,20 @@
 #include "driver/gpio.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/portmacro.h"
 #include "freertos/projdefs.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
 #include "hal/gpio_types.h"
+#ifdef ROTARY_PCNT
+#include "driver/pcnt.h"
+#endif
 
 // include the queue definitions
 #include "app_queue.h"
+#include "rotary_decoder.h"
 
 // Set logging tag per module
 static const char *TAG = "RotaryEncoder";
@@ -113,56 +118,14 @@ static const char *TAG = "RotaryEncoder";
 // For debounce on the rotary encoder switch we need a timer
 
 //#define ROTARY_ENCODER_DEBUG
-#define TABLE_COLS 4
-typedef uint8_t table_row_t[TABLE_COLS];
-
-#define TABLE_ROWS 7
-
-#define DIR_NONE 0x0  // No complete step yet.
-#define DIR_CW 0x10   // Clockwise step.
-#define DIR_CCW 0x20  // Anti-clockwise step.
-
-#ifndef FULLSTEP
-// do half stepping
-// Create the half-step state table (emits a code at 00 and 11)
-#define R_START 0x0
-#define H_CCW_BEGIN 0x1
-#define H_CW_BEGIN 0x2
-#define H_START_M 0x3
-#define H_CW_BEGIN_M 0x4
-#define H_CCW_BEGIN_M 0x5
-
-static const uint8_t _ttable_half[TABLE_ROWS][TABLE_COLS] = {
-    // 00                  01              10            11                   // BA
-    {H_START_M, H_CW_BEGIN, H_CCW_BEGIN, R_START},             // R_START (00)
-    {H_START_M | DIR_CCW, R_START, H_CCW_BEGIN, R_START},      // H_CCW_BEGIN
-    {H_START_M | DIR_CW, H_CW_BEGIN, R_START, R_START},        // H_CW_BEGIN
-    {H_START_M, H_CCW_BEGIN_M, H_CW_BEGIN_M, R_START},         // H_START_M (11)
-    {H_START_M, H_START_M, H_CW_BEGIN_M, R_START | DIR_CW},    // H_CW_BEGIN_M
-    {H_START_M, H_CCW_BEGIN_M, H_START_M, R_START | DIR_CCW},  // H_CCW_BEGIN_M
-};
-#endif
 
 #ifdef FULLSTEP
-// Create the full-step state table (emits a code at 00 only)
-#define R_START 0x0
-#define F_CW_FINAL 0x1
-#define F_CW_BEGIN 0x2
-#define F_CW_NEXT 0x3
-#define F_CCW_BEGIN 0x4
-#define F_CCW_FINAL 0x5
-#define F_CCW_NEXT 0x6
-
-static const uint8_t _ttable_full[TABLE_ROWS][TABLE_COLS] = {
-    // 00        01           10           11                  // BA
-    {R_START, F_CW_BEGIN, F_CCW_BEGIN, R_START},            // R_START
-    {F_CW_NEXT, R_START, F_CW_FINAL, R_START | DIR_CW},     // F_CW_FINAL
-    {F_CW_NEXT, F_CW_BEGIN, R_START, R_START},              // F_CW_BEGIN
-    {F_CW_NEXT, F_CW_BEGIN, F_CW_FINAL, R_START},           // F_CW_NEXT
-    {F_CCW_NEXT, R_START, F_CCW_BEGIN, R_START},            // F_CCW_BEGIN
-    {F_CCW_NEXT, F_CCW_FINAL, R_START, R_START | DIR_CCW},  // F_CCW_FINAL
-    {F_CCW_NEXT, F_CCW_FINAL, F_CCW_BEGIN, R_START},        // F_CCW_NEXT
-};
+#define HALF_STEP false
+// Pulse counter counts every edge of both pins
+#define PCNT_COUNTS_PER_DETENT 4
+#else
+#define HALF_STEP true
+#define PCNT_COUNTS_PER_DETENT 2
 #endif
 
 /**
@@ -174,14 +137,64 @@ typedef struct {
   gpio_num_t pin_b;          // GPIO for Signal B from the rotary encoder device
   gpio_num_t pin_switch;     // Encoder switch pin. The other side of the switch should be grounded
   QueueHandle_t queue;       // Handle for event queue, created by ::rotary_encoder_create_queue
-  const table_row_t *table;  // Pointer to active state transition table
-  uint8_t table_state;       // Internal state
+  rotary_decoder_t decoder;  // State table decoding of the GPIO backend
   TimerHandle_t keyTimer;    // Timer for switch debounce
+  volatile int64_t edge_time;   // esp_timer time of the last switch edge handled
+  int64_t press_time;           // edge time of the last switch press
+  volatile uint32_t events;     // events sent to the queue
+  volatile uint32_t events_dropped;  // events lost because the queue was full
+  rotary_accel_t accel;         // speed of turning
+  rotary_encoder_backend_stats_t backend;
+#ifdef ROTARY_PCNT
+  esp_timer_handle_t poll_timer;  // reads the pulse counter
+  int16_t pcnt_last;              // counter at the last poll
+  int32_t pcnt_counts;            // counts not yet a whole detent
+#endif
 } rotary_encoder_info_t;
 
 // make the info var available to this file only
 static rotary_encoder_info_t info;
 
+#ifdef ROTARY_ACCEL
+static const rotary_accel_point_t accel_curve[] = ROTARY_ACCEL_CURVE;
+#define ACCEL_POINTS ((int)(sizeof(accel_curve) / sizeof(accel_curve[0])))
+#else
+#define accel_curve NULL
+#define ACCEL_POINTS 0
+#endif
+
+// Keep the CPU time spent on turning. In the GPIO interrupt or the poll.
+static void _backend_time(int64_t start) {
+  uint32_t used = (uint32_t)(esp_timer_get_time() - start);
+  info.backend.calls++;
+  info.backend.us_total += used;
+  if (used > info.backend.us_max) {
+    info.backend.us_max = used;
+  }
+}
+
+// Send detents turned to the display task. Positive is clockwise.
+// From an interrupt when task_woken is given.
+static void _send_turn(int detents, int64_t time, BaseType_t *task_woken) {
+  disp_task_queue_item_t signal;
+  BaseType_t sent;
+  signal.disp_task_signal = (detents > 0) ? encoder_up : encoder_down;
+  signal.time = time;
+  // Faster turning is more steps
+  signal.payload.delta = rotary_decoder_accelerate(&info.accel, detents, time);
+  if (task_woken != NULL) {
+    sent = xQueueSendToBackFromISR(info.queue, &signal, task_woken);
+  } else {
+    sent = xQueueSendToBack(info.queue, &signal, 0);
+  }
+  if (sent == pdTRUE) {
+    info.events++;
+  } else {
+    info.events_dropped++;
+  }
+}
+
+#ifndef ROTARY_PCNT
 static uint8_t _process() {
   uint8_t event = 0;
   // Get state of input pins.
@@ -189,42 +202,106 @@ static uint8_t _process() {
 
   // Determine new state from the pins and state table.
 #ifdef ROTARY_ENCODER_DEBUG
-  uint8_t old_state = info.table_state;
+  uint8_t old_state = info.decoder.table_state;
 #endif
-  info.table_state = info.table[info.table_state & 0xf][pin_state];
-
-  // AND state to only return direction bits from state table
-  // Will only return the DIR_CW or DIR_CCW bits and zero for most states
-  event = info.table_state & 0x30;
+  event = rotary_decoder_step(&info.decoder, pin_state);
 #ifdef ROTARY_ENCODER_DEBUG
   ESP_EARLY_LOGD(TAG, "BA %d%d, state 0x%02x, new state 0x%02x, event 0x%02x", pin_state >> 1,
-                 pin_state & 1, old_state, info.table_state, event);
+                 pin_state & 1, old_state, info.decoder.table_state, event);
 #endif
   return event;
 }
 
 static void _isr_rotenc(void *args) {
   // this is a interrupt service routine. Keep it fast and small
-  // Create event items
-  const disp_task_queue_item_t signal_up = {.disp_task_signal = encoder_up};
-  const disp_task_queue_item_t signal_down = {.disp_task_signal = encoder_down};
-
+  int64_t start = esp_timer_get_time();
   uint8_t event = _process();
   BaseType_t task_woken = pdFALSE;
+  // One detent per event. The display task adds them up
   switch (event) {
     case DIR_CW:
-      xQueueSendToBackFromISR(info.queue, &signal_up, &task_woken);
+      _send_turn(1, start, &task_woken);
       break;
     case DIR_CCW:
-      xQueueSendToBackFromISR(info.queue, &signal_down, &task_woken);
+      _send_turn(-1, start, &task_woken);
       break;
     default:
       break;
   }
+  _backend_time(start);
   if (task_woken) {
     portYIELD_FROM_ISR();
   }
 }
+#endif
+
+#ifdef ROTARY_PCNT
+// Runs in the esp_timer task. The pulse counter did the edges. Only
+// whole detents are sent. The rest waits for the next poll.
+static void _poll_pcnt(void *args) {
+  int64_t start = esp_timer_get_time();
+  int16_t count = 0;
+  int detents;
+  pcnt_get_counter_value(ROTARY_PCNT_UNIT, &count);
+  info.pcnt_counts += rotary_decoder_pcnt_counts(info.pcnt_last, count, ROTARY_PCNT_LIMIT);
+  info.pcnt_last = count;
+  detents = rotary_decoder_detents(&info.pcnt_counts, PCNT_COUNTS_PER_DETENT);
+  if (detents != 0) {
+    _send_turn(detents, start, NULL);
+  }
+  _backend_time(start);
+}
+
+// Both channels of a unit count the edges of 1 pin. The other pin gives
+// the direction. Together 4 counts per full step. Clockwise is up, like
+// DIR_CW of the state table: BA 11, 01, 00, 10, 11.
+static esp_err_t _init_pcnt(void) {
+  esp_err_t err;
+  pcnt_config_t pcnt_config = {
+      .pulse_gpio_num = info.pin_a,
+      .ctrl_gpio_num = info.pin_b,
+      .channel = PCNT_CHANNEL_0,
+      .unit = ROTARY_PCNT_UNIT,
+      .pos_mode = PCNT_COUNT_INC,
+      .neg_mode = PCNT_COUNT_DEC,
+      .lctrl_mode = PCNT_MODE_REVERSE,
+      .hctrl_mode = PCNT_MODE_KEEP,
+      .counter_h_lim = ROTARY_PCNT_LIMIT,
+      .counter_l_lim = -ROTARY_PCNT_LIMIT,
+  };
+  err = pcnt_unit_config(&pcnt_config);
+  if (err == ESP_OK) {
+    pcnt_config.pulse_gpio_num = info.pin_b;
+    pcnt_config.ctrl_gpio_num = info.pin_a;
+    pcnt_config.channel = PCNT_CHANNEL_1;
+    pcnt_config.pos_mode = PCNT_COUNT_DEC;
+    pcnt_config.neg_mode = PCNT_COUNT_INC;
+    err = pcnt_unit_config(&pcnt_config);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Error configuring the pulse counter");
+    return err;
+  }
+  // Contact bounce shorter than the filter is not counted
+  pcnt_set_filter_value(ROTARY_PCNT_UNIT, ROTARY_PCNT_FILTER);
+  pcnt_filter_enable(ROTARY_PCNT_UNIT);
+  pcnt_counter_pause(ROTARY_PCNT_UNIT);
+  pcnt_counter_clear(ROTARY_PCNT_UNIT);
+  pcnt_counter_resume(ROTARY_PCNT_UNIT);
+  info.pcnt_last = 0;
+  info.pcnt_counts = 0;
+
+  const esp_timer_create_args_t timer_args = {.callback = &_poll_pcnt, .name = "rotpoll"};
+  err = esp_timer_create(&timer_args, &info.poll_timer);
+  if (err == ESP_OK) {
+    err = esp_timer_start_periodic(info.poll_timer, ROTARY_PCNT_POLL_US);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Error starting the pulse counter poll timer");
+  }
+  return err;
+}
+#endif
 
 // For debouncing the switch we start a timer. This timer function checks the state of the pin
 // after some time.
@@ -239,6 +316,7 @@ static void _isr_rotpush(void *args) {
   // always 2 freeRTOS ticks longer than the debounce timer delay
   if (current_tick > (last_tick + DEBOUNCE_TICKS + 2)) {
     last_tick = current_tick;
+    info.edge_time = esp_timer_get_time();
     BaseType_t task_woken = pdFALSE;
     xTimerStartFromISR(info.keyTimer, &task_woken);
 
@@ -254,15 +332,26 @@ static void _isr_rotpush(void *args) {
 
 // Timer expires for key press. This gets called
 static void vTimerCallbackKeyPress(xTimerHandle pxTimer) {
-  // define the queue signals
-  const disp_task_queue_item_t signal_press = {.disp_task_signal = encoder_press};
-  const disp_task_queue_item_t signal_press_rel = {.disp_task_signal = encoder_press_released};
+  // define the queue signal
+  disp_task_queue_item_t signal;
   // we should be the debouce time after a key press or release
   // pin is negative when pressed
+  BaseType_t sent;
+  signal.time = esp_timer_get_time();
   if (gpio_get_level(info.pin_switch)) {
-    xQueueSendToBack(info.queue, &signal_press_rel, 0);
+    signal.disp_task_signal = encoder_press_released;
+    // Held from the press edge to the release edge
+    signal.payload.press_ms = (uint32_t)((info.edge_time - info.press_time) / 1000);
+  } else {
+    signal.disp_task_signal = encoder_press;
+    signal.payload.press_ms = 0;
+    info.press_time = info.edge_time;
+  }
+  sent = xQueueSendToBack(info.queue, &signal, 0);
+  if (sent == pdTRUE) {
+    info.events++;
   } else {
-    xQueueSendToBack(info.queue, &signal_press, 0);
+    info.events_dropped++;
   }
 }
 
@@ -273,13 +362,8 @@ esp_err_t rotary_encoder_init(gpio_num_t pin_a, gpio_num_t pin_b, gpio_num_t pin
   info.pin_a = pin_a;
   info.pin_b = pin_b;
   info.pin_switch = pin_switch;
-#ifdef FULLSTEP
-  info.table = &_ttable_full[0];  // enable_half_step ? &_ttable_half[0] : &_ttable_full[0];
-#endif
-#ifndef FULLSTEP
-  info.table = &_ttable_half[0];  // enable_half_step ? &_ttable_half[0] : &_ttable_full[0];
-#endif
-  info.table_state = R_START;
+  rotary_decoder_init(&info.decoder, HALF_STEP);
+  rotary_decoder_accel_init(&info.accel, accel_curve, ACCEL_POINTS, ROTARY_ACCEL_RESET_US);
 
   // Initialize switch debounce timer
   info.keyTimer = xTimerCreate("keyDebounce",   // Name
@@ -295,24 +379,51 @@ esp_err_t rotary_encoder_init(gpio_num_t pin_a, gpio_num_t pin_b, gpio_num_t pin
   gpio_pad_select_gpio(info.pin_a);
   gpio_set_pull_mode(info.pin_a, GPIO_PULLUP_ONLY);
   gpio_set_direction(info.pin_a, GPIO_MODE_INPUT);
-  gpio_set_intr_type(info.pin_a, GPIO_INTR_ANYEDGE);
 
   gpio_pad_select_gpio(info.pin_b);
   gpio_set_pull_mode(info.pin_b, GPIO_PULLUP_ONLY);
   gpio_set_direction(info.pin_b, GPIO_MODE_INPUT);
-  gpio_set_intr_type(info.pin_b, GPIO_INTR_ANYEDGE);
 
   gpio_pad_select_gpio(info.pin_switch);
   gpio_set_pull_mode(info.pin_switch, GPIO_PULLUP_ONLY);
   gpio_set_direction(info.pin_switch, GPIO_MODE_INPUT);
   gpio_set_intr_type(info.pin_switch, GPIO_INTR_ANYEDGE);
   // install interrupt handlers
+  gpio_isr_handler_add(info.pin_switch, _isr_rotpush, NULL);
+#ifdef ROTARY_PCNT
+  // Turning is counted by the pulse counter. No interrupts
+  info.backend.backend = "pcnt";
+  err = _init_pcnt();
+#else
+  // Every edge of both pins is an interrupt
+  info.backend.backend = "gpio";
+  gpio_set_intr_type(info.pin_a, GPIO_INTR_ANYEDGE);
+  gpio_set_intr_type(info.pin_b, GPIO_INTR_ANYEDGE);
   gpio_isr_handler_add(info.pin_a, _isr_rotenc, NULL);
   gpio_isr_handler_add(info.pin_b, _isr_rotenc, NULL);
-  gpio_isr_handler_add(info.pin_switch, _isr_rotpush, NULL);
+#endif
   return err;
 }
 
 int rotary_encoder_get_button() {
   return gpio_get_level(info.pin_switch);
 }
+
+void rotary_encoder_get_counts(uint32_t *events, uint32_t *events_dropped) {
+  *events = info.events;
+  *events_dropped = info.events_dropped;
+}
+
+void rotary_encoder_get_accel_stats(rotary_encoder_accel_stats_t *stats) {
+  stats->velocity = info.accel.velocity;
+  stats->velocity_max = info.accel.velocity_max;
+  stats->steps = info.accel.steps;
+}
+
+void rotary_encoder_get_backend_stats(rotary_encoder_backend_stats_t *stats) {
+  *stats = info.backend;
+  if (stats->backend == NULL) {
+    // Not started yet
+    stats->backend = "none";
+  }
+}
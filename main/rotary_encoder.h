@@ -49,6 +49,34 @@ extern "C" {
 #define ROT_ENC_B_GPIO GPIO_NUM_32
 #define ROT_ENC_PUSH_GPIO GPIO_NUM_27
 
+// Backend for turning. Default is a GPIO interrupt on every edge of both
+// pins. Define below to count the edges with the pulse counter peripheral
+// and its glitch filter instead. It is polled. No interrupts for turning.
+// The push switch is always a GPIO interrupt.
+//#define ROTARY_PCNT
+#define ROTARY_PCNT_UNIT PCNT_UNIT_0
+// Pulses shorter than this many APB clock cycles (12.5ns) are ignored. Max 1023
+#define ROTARY_PCNT_FILTER 1023
+#define ROTARY_PCNT_POLL_US 5000
+// Counter goes back to zero at plus and minus this. Multiple of 4
+#define ROTARY_PCNT_LIMIT 32000
+
+// Acceleration. Turning fast moves more steps per detent. Comment out
+// for one step per detent.
+#define ROTARY_ACCEL
+// Curve of {detents per second, steps per detent}. From fast to slow.
+// Slower than the last entry is one step.
+#define ROTARY_ACCEL_CURVE {{40, 6}, {25, 4}, {12, 2}}
+// Pause in turning after which the speed starts from zero again. In us.
+#define ROTARY_ACCEL_RESET_US 250000
+
+// Speed of turning and the steps it made.
+typedef struct {
+  uint32_t velocity;      // detents per second. Smoothed. Of the last detent
+  uint32_t velocity_max;  // fastest seen
+  uint32_t steps;         // steps sent in events. Detents times acceleration
+} rotary_encoder_accel_stats_t;
+
 /**
  * @brief Initialise the rotary encoder device with the specified GPIO pins and full step
  * increments. This function will set up the GPIOs as needed, Note: this function assumes that
@@ -69,6 +97,24 @@ esp_err_t rotary_encoder_init( gpio_num_t pin_a, gpio_num_t pin_b,
  */
 int rotary_encoder_get_button(void);
 
+// Events sent to the display task queue. And the ones dropped because
+// the queue was full.
+void rotary_encoder_get_counts(uint32_t *events, uint32_t *events_dropped);
+
+// Copy of the turning speed and steps
+void rotary_encoder_get_accel_stats(rotary_encoder_accel_stats_t *stats);
+
+// CPU spent on turning. For comparing the backends. With GPIO these are
+// the edge interrupts. With the pulse counter the polls.
+typedef struct {
+  const char *backend;  // "gpio" or "pcnt"
+  uint32_t calls;
+  uint64_t us_total;
+  uint32_t us_max;
+} rotary_encoder_backend_stats_t;
+
+void rotary_encoder_get_backend_stats(rotary_encoder_backend_stats_t *stats);
+
 
 #ifdef __cplusplus
 }
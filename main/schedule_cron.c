@@ -0,0 +1,200 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Cron like recurrence of alarms and sounds. See schedule_cron.h
+//
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_err.h"
+
+// Own files to include
+#include "schedule_cron.h"
+
+// Fields of the text. In order.
+typedef struct {
+  int low;
+  int high;
+  int offset;  // bit of the lowest value
+} cron_field_t;
+
+static const cron_field_t cron_fields[5] = {
+    {0, 59, 0},  // minute
+    {0, 23, 0},  // hour
+    {1, 31, 1},  // day
+    {1, 12, 1},  // month
+    {0, 7, 0},   // weekday. 7 is sunday too
+};
+
+void schedule_cron_daily(schedule_cron_t *cron, int hour, int minute) {
+  cron->minutes = 1ULL << minute;
+  cron->hours = 1UL << hour;
+  cron->days = CRON_ALL_DAYS;
+  cron->months = CRON_ALL_MONTHS;
+  cron->weekdays = CRON_ALL_WEEKDAYS;
+}
+
+bool schedule_cron_day_match(const schedule_cron_t *cron, int month, int day, int weekday) {
+  bool day_match = (cron->days >> (day - 1)) & 1;
+  bool weekday_match = (cron->weekdays >> weekday) & 1;
+  if (!((cron->months >> (month - 1)) & 1)) {
+    return false;
+  }
+  // Like cron. When both are limited one of them is enough
+  if ((cron->days != CRON_ALL_DAYS) && (cron->weekdays != CRON_ALL_WEEKDAYS)) {
+    return day_match || weekday_match;
+  }
+  return day_match && weekday_match;
+}
+
+bool schedule_cron_match(const schedule_cron_t *cron, const struct tm *time) {
+  return ((cron->minutes >> time->tm_min) & 1) && ((cron->hours >> time->tm_hour) & 1) &&
+         schedule_cron_day_match(cron, time->tm_mon + 1, time->tm_mday, time->tm_wday);
+}
+
+bool schedule_cron_every_day(const schedule_cron_t *cron) {
+  return (cron->days == CRON_ALL_DAYS) && (cron->months == CRON_ALL_MONTHS) &&
+         (cron->weekdays == CRON_ALL_WEEKDAYS);
+}
+
+bool schedule_cron_empty(const schedule_cron_t *cron) {
+  return (cron->minutes == 0) || (cron->hours == 0) || (cron->months == 0) ||
+         ((cron->days == 0) && (cron->weekdays == 0));
+}
+
+// Parse 1 field. Sets the bits of the values. Returns the end of the field
+static const char *cron_parse_field(const char *text, const cron_field_t *field,
+                                    uint64_t *bits) {
+  char *end;
+  long low, high, step;
+  *bits = 0;
+  while (1) {
+    step = 1;
+    if (*text == '*') {
+      low = field->low;
+      high = field->high;
+      text++;
+    } else {
+      low = strtol(text, &end, 10);
+      if (end == text) {
+        return NULL;
+      }
+      text = end;
+      high = low;
+      if (*text == '-') {
+        text++;
+        high = strtol(text, &end, 10);
+        if (end == text) {
+          return NULL;
+        }
+        text = end;
+      }
+    }
+    if (*text == '/') {
+      text++;
+      step = strtol(text, &end, 10);
+      if ((end == text) || (step < 1)) {
+        return NULL;
+      }
+      text = end;
+    }
+    if ((low < field->low) || (high > field->high) || (low > high)) {
+      return NULL;
+    }
+    for (long value = low; value <= high; value += step) {
+      *bits |= 1ULL << (value - field->offset);
+    }
+    if (*text != ',') {
+      break;
+    }
+    text++;
+  }
+  // A field ends with a space or the end of the text
+  if ((*text != '\0') && (*text != ' ') && (*text != '\t')) {
+    return NULL;
+  }
+  return text;
+}
+
+esp_err_t schedule_cron_parse(const char *text, schedule_cron_t *cron) {
+  uint64_t bits[5];
+  for (int x = 0; x < 5; x++) {
+    while ((*text == ' ') || (*text == '\t')) {
+      text++;
+    }
+    text = cron_parse_field(text, &cron_fields[x], &bits[x]);
+    if (text == NULL) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+  while ((*text == ' ') || (*text == '\t')) {
+    text++;
+  }
+  if (*text != '\0') {
+    return ESP_ERR_INVALID_ARG;
+  }
+  cron->minutes = bits[0];
+  cron->hours = bits[1];
+  cron->days = bits[2];
+  cron->months = bits[3];
+  // Sunday as 7 is the same as 0
+  cron->weekdays = (bits[4] | (bits[4] >> 7)) & CRON_ALL_WEEKDAYS;
+  return ESP_OK;
+}
+
+// Write 1 field. * when all bits are set. Else a list of values and ranges
+static int cron_format_field(uint64_t bits, const cron_field_t *field, int high, char *text,
+                             int length) {
+  int used = 0;
+  int value = field->low;
+  int start;
+  uint64_t all = (2ULL << (high - field->low)) - 1;
+  if (bits == all) {
+    return snprintf(text, length, "*");
+  }
+  while (value <= high) {
+    if (!((bits >> (value - field->offset)) & 1)) {
+      value++;
+      continue;
+    }
+    start = value;
+    while ((value + 1 <= high) && ((bits >> (value + 1 - field->offset)) & 1)) {
+      value++;
+    }
+    if (used > 0) {
+      used += snprintf(text + used, (used < length) ? length - used : 0, ",");
+    }
+    if (value == start) {
+      used += snprintf(text + used, (used < length) ? length - used : 0, "%d", start);
+    } else {
+      used += snprintf(text + used, (used < length) ? length - used : 0, "%d-%d", start, value);
+    }
+    value++;
+  }
+  if (used == 0) {
+    // Never. Not valid for the parser on purpose
+    used = snprintf(text, length, "-");
+  }
+  return used;
+}
+
+void schedule_cron_format(const schedule_cron_t *cron, char *text, int length) {
+  const uint64_t bits[5] = {cron->minutes, cron->hours, cron->days, cron->months,
+                            cron->weekdays};
+  int used = 0;
+  for (int x = 0; x < 5; x++) {
+    if (x > 0) {
+      used += snprintf(text + used, (used < length) ? length - used : 0, " ");
+    }
+    // Weekdays are written as 0-6
+    used += cron_format_field(bits[x], &cron_fields[x], (x == 4) ? 6 : cron_fields[x].high,
+                              text + used, (used < length) ? length - used : 0);
+  }
+}
@@ -0,0 +1,61 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef SCHEDULE_CRON_H_
+#define SCHEDULE_CRON_H_
+
+// When an alarm or sound goes off. As bitsets like a cron line. A minute
+// matches when its bit is set in all sets. Days of the month and weekdays
+// work like cron: when both are limited one of them has to match.
+//
+// Text is 5 fields: minute hour day month weekday. Each field is * or a
+// list of numbers and ranges. Optional with a step. Weekday 0 and 7 are
+// sunday. Like "0 7 * * 1-5" or "*/15 8-17 * * *" or "0 12 25 12 *".
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "esp_err.h"
+
+#define CRON_ALL_MINUTES 0x0FFFFFFFFFFFFFFFULL
+#define CRON_ALL_HOURS 0x00FFFFFFUL
+#define CRON_ALL_DAYS 0x7FFFFFFFUL
+#define CRON_ALL_MONTHS 0x0FFF
+#define CRON_ALL_WEEKDAYS 0x7F
+// Longest text made by schedule_cron_format
+#define CRON_TEXT_LENGTH 200
+
+typedef struct {
+  uint64_t minutes;  // bit 0 is minute 0
+  uint32_t hours;    // bit 0 is hour 0
+  uint32_t days;     // bit 0 is the first day of the month
+  uint16_t months;   // bit 0 is january
+  uint8_t weekdays;  // bit 0 is sunday
+} schedule_cron_t;
+
+// Every day at hour:minute
+void schedule_cron_daily(schedule_cron_t *cron, int hour, int minute);
+
+// The cron goes off on this day. Year, month (1-12), day and weekday (0 is sunday)
+bool schedule_cron_day_match(const schedule_cron_t *cron, int month, int day, int weekday);
+
+// The cron goes off at this local time
+bool schedule_cron_match(const schedule_cron_t *cron, const struct tm *time);
+
+// Goes off on all days. Not limited to certain dates or weekdays
+bool schedule_cron_every_day(const schedule_cron_t *cron);
+
+// Never goes off
+bool schedule_cron_empty(const schedule_cron_t *cron);
+
+// Parse the text. The cron is only changed when the text is valid.
+esp_err_t schedule_cron_parse(const char *text, schedule_cron_t *cron);
+
+// Write the cron as text. Ranges are combined.
+void schedule_cron_format(const schedule_cron_t *cron, char *text, int length);
+
+#endif
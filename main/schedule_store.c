@@ -0,0 +1,354 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Table of sounds on a cron stored in spiffs. See schedule_store.h
+//
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Own files to include
+#include "alarm_schedule.h"
+#include "schedule_store.h"
+
+// Set logging tag per module
+static const char *TAG = "ScheduleStore";
+
+typedef struct {
+  uint32_t when;  // local minute the record goes off next
+  int index;      // place in the file
+  schedule_record_t record;
+} store_entry_t;
+
+// Sorted on when. Only the records going off first
+static store_entry_t store_due[SCHEDULE_STORE_DUE];
+static int store_due_count = 0;
+// All records not in store_due go off at or after this minute
+static uint32_t store_horizon = SCHEDULE_NEVER;
+static volatile bool store_dirty = true;
+// Last minute handed out. Each minute only once
+static uint32_t store_checked = 0;
+// The http server writes. The display task reads
+static SemaphoreHandle_t store_lock = NULL;
+
+static bool store_take(void) {
+  if (store_lock == NULL) {
+    return false;
+  }
+  return xSemaphoreTake(store_lock, 1000 / portTICK_PERIOD_MS) == pdTRUE;
+}
+
+static void store_give(void) {
+  xSemaphoreGive(store_lock);
+}
+
+// Open the file and check the header. NULL when there is no usable file
+static FILE *store_open(const char *mode, schedule_store_header_t *header) {
+  FILE *file = fopen(SCHEDULE_STORE_FILE, mode);
+  if (file == NULL) {
+    return NULL;
+  }
+  if ((fread(header, 1, sizeof(schedule_store_header_t), file) !=
+       sizeof(schedule_store_header_t)) ||
+      (header->magic != SCHEDULE_STORE_MAGIC) || (header->version != SCHEDULE_STORE_VERSION) ||
+      (header->record_size != sizeof(schedule_record_t)) ||
+      (header->count > SCHEDULE_STORE_MAX)) {
+    ESP_LOGE(TAG, "File %s is not a schedule of version %d", SCHEDULE_STORE_FILE,
+             SCHEDULE_STORE_VERSION);
+    fclose(file);
+    return NULL;
+  }
+  return file;
+}
+
+// Open for writing. Starts a new empty file when there is none. A file
+// that is not a schedule is moved to SCHEDULE_STORE_BAD_FILE first. Its
+// records are not thrown away. When that one is still there nothing is
+// written.
+static FILE *store_open_write(schedule_store_header_t *header) {
+  errno = 0;
+  FILE *file = store_open("r+b", header);
+  if (file != NULL) {
+    return file;
+  }
+  if (errno != ENOENT) {
+    file = fopen(SCHEDULE_STORE_BAD_FILE, "rb");
+    if (file != NULL) {
+      fclose(file);
+      ESP_LOGE(TAG, "Not replacing %s. %s is still there", SCHEDULE_STORE_FILE,
+               SCHEDULE_STORE_BAD_FILE);
+      return NULL;
+    }
+    if (rename(SCHEDULE_STORE_FILE, SCHEDULE_STORE_BAD_FILE) != 0) {
+      ESP_LOGE(TAG, "Can not move %s to %s", SCHEDULE_STORE_FILE, SCHEDULE_STORE_BAD_FILE);
+      return NULL;
+    }
+    ESP_LOGW(TAG, "Moved %s to %s", SCHEDULE_STORE_FILE, SCHEDULE_STORE_BAD_FILE);
+  }
+  ESP_LOGI(TAG, "Starting new file %s", SCHEDULE_STORE_FILE);
+  file = fopen(SCHEDULE_STORE_FILE, "w+b");
+  if (file == NULL) {
+    ESP_LOGE(TAG, "Can not create %s", SCHEDULE_STORE_FILE);
+    return NULL;
+  }
+  header->magic = SCHEDULE_STORE_MAGIC;
+  header->version = SCHEDULE_STORE_VERSION;
+  header->record_size = sizeof(schedule_record_t);
+  header->count = 0;
+  if (fwrite(header, 1, sizeof(schedule_store_header_t), file) !=
+      sizeof(schedule_store_header_t)) {
+    fclose(file);
+    return NULL;
+  }
+  return file;
+}
+
+static long store_offset(int index) {
+  return sizeof(schedule_store_header_t) + ((long)index * sizeof(schedule_record_t));
+}
+
+// Put a record on its place in store_due. Records going off in the same
+// minute are in file order. When store_due is full the last one is
+// dropped. It is found again when the file is read again.
+static void store_insert(uint32_t when, int index, const schedule_record_t *record) {
+  int x;
+  if (when >= store_horizon) {
+    // Never. Or other records not in memory go off first
+    return;
+  }
+  if (store_due_count == SCHEDULE_STORE_DUE) {
+    x = store_due_count - 1;
+    if ((store_due[x].when < when) ||
+        ((store_due[x].when == when) && (store_due[x].index < index))) {
+      // Goes off after all records in memory
+      store_horizon = when;
+      return;
+    }
+    store_horizon = store_due[x].when;
+    store_due_count--;
+  }
+  x = store_due_count;
+  while ((x > 0) && ((store_due[x - 1].when > when) ||
+                     ((store_due[x - 1].when == when) && (store_due[x - 1].index > index)))) {
+    store_due[x] = store_due[x - 1];
+    x--;
+  }
+  store_due[x].when = when;
+  store_due[x].index = index;
+  store_due[x].record = *record;
+  store_due_count++;
+}
+
+// Read the whole file. Keep the records going off first from minute from.
+// Records up to after already went off in minute from.
+static void store_rebuild(uint32_t from, int after) {
+  schedule_store_header_t header;
+  schedule_record_t record;
+  int used = 0;
+  store_due_count = 0;
+  store_horizon = SCHEDULE_NEVER;
+  FILE *file = store_open("rb", &header);
+  if (file == NULL) {
+    return;
+  }
+  for (int x = 0; x < header.count; x++) {
+    if (fread(&record, 1, sizeof(schedule_record_t), file) != sizeof(schedule_record_t)) {
+      ESP_LOGE(TAG, "File %s ends at record %d of %d", SCHEDULE_STORE_FILE, x, header.count);
+      break;
+    }
+    if (record.flags & SCHEDULE_RECORD_USED) {
+      used++;
+      store_insert(alarm_schedule_cron_next(&record.cron, (x <= after) ? from + 1 : from), x,
+                   &record);
+    }
+  }
+  fclose(file);
+  ESP_LOGI(TAG, "Schedule read. %d of %d records. %d in memory", used, header.count,
+           store_due_count);
+}
+
+void schedule_store_start(void) {
+  store_lock = xSemaphoreCreateMutex();
+  store_dirty = true;
+}
+
+int schedule_store_count(void) {
+  schedule_store_header_t header;
+  int count = 0;
+  if (!store_take()) {
+    return 0;
+  }
+  FILE *file = store_open("rb", &header);
+  if (file != NULL) {
+    count = header.count;
+    fclose(file);
+  }
+  store_give();
+  return count;
+}
+
+int schedule_store_read(int first, schedule_record_t *records, int count) {
+  schedule_store_header_t header;
+  int read = 0;
+  if ((first < 0) || (count <= 0) || !store_take()) {
+    return 0;
+  }
+  FILE *file = store_open("rb", &header);
+  if (file != NULL) {
+    if (first < header.count) {
+      if (count > header.count - first) {
+        count = header.count - first;
+      }
+      if (fseek(file, store_offset(first), SEEK_SET) == 0) {
+        read = fread(records, sizeof(schedule_record_t), count, file);
+      }
+    }
+    fclose(file);
+  }
+  store_give();
+  return read;
+}
+
+esp_err_t schedule_store_write(int *index, const schedule_record_t *record) {
+  schedule_store_header_t header;
+  schedule_record_t free_record;
+  esp_err_t ret = ESP_FAIL;
+  int place = *index;
+  if ((place != SCHEDULE_STORE_APPEND) && ((place < 0) || (place >= SCHEDULE_STORE_MAX))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!store_take()) {
+    return ESP_ERR_TIMEOUT;
+  }
+  FILE *file = store_open_write(&header);
+  if (file == NULL) {
+    store_give();
+    return ESP_FAIL;
+  }
+  if (place == SCHEDULE_STORE_APPEND) {
+    // The first free place. Or the end of the file
+    for (place = 0; place < header.count; place++) {
+      if ((fread(&free_record, 1, sizeof(schedule_record_t), file) !=
+           sizeof(schedule_record_t)) ||
+          !(free_record.flags & SCHEDULE_RECORD_USED)) {
+        break;
+      }
+    }
+  }
+  if (place > header.count) {
+    // No gaps in the file
+    ret = ESP_ERR_INVALID_ARG;
+  } else if (place >= SCHEDULE_STORE_MAX) {
+    ret = ESP_ERR_NO_MEM;
+  } else if ((fseek(file, store_offset(place), SEEK_SET) == 0) &&
+             (fwrite(record, 1, sizeof(schedule_record_t), file) == sizeof(schedule_record_t))) {
+    ret = ESP_OK;
+    if (place == header.count) {
+      header.count++;
+      if ((fseek(file, 0, SEEK_SET) != 0) ||
+          (fwrite(&header, 1, sizeof(schedule_store_header_t), file) !=
+           sizeof(schedule_store_header_t))) {
+        ret = ESP_FAIL;
+      }
+    }
+  }
+  fclose(file);
+  if (ret == ESP_OK) {
+    *index = place;
+    store_dirty = true;
+  } else {
+    ESP_LOGE(TAG, "Writing record %d failed (%s)", place, esp_err_to_name(ret));
+  }
+  store_give();
+  return ret;
+}
+
+bool schedule_store_due(const struct tm *now, char *soundfile, int length) {
+  uint32_t minute = alarm_schedule_minute(now);
+  store_entry_t entry;
+  bool found = false;
+  int last = -1;
+  if (minute == store_checked) {
+    // Already done this minute
+    return false;
+  }
+  if (!store_take()) {
+    return false;
+  }
+  if (store_dirty || (minute < store_checked) || (store_horizon <= minute)) {
+    // New records. The time was set back. Or records not in memory are due
+    store_dirty = false;
+    store_rebuild(minute, -1);
+  }
+  store_checked = minute;
+  while (true) {
+    // Mostly the first entry is not due. Then this is all
+    while ((store_due_count > 0) && (store_due[0].when <= minute)) {
+      entry = store_due[0];
+      store_due_count--;
+      memmove(&store_due[0], &store_due[1], store_due_count * sizeof(store_entry_t));
+      if (entry.when == minute) {
+        if (!schedule_cron_every_day(&entry.record.cron)) {
+          strlcpy(soundfile, entry.record.soundfile, length);
+          ESP_LOGI(TAG, "Found sound %d for specific weekday or date.", entry.index);
+        } else if (!found) {
+          strlcpy(soundfile, entry.record.soundfile, length);
+          ESP_LOGI(TAG, "Found sound %d for certain time and for all days.", entry.index);
+        }
+        found = true;
+        last = entry.index;
+        store_insert(alarm_schedule_cron_next(&entry.record.cron, minute + 1), entry.index,
+                     &entry.record);
+      } else {
+        // Missed. Can still go off this minute
+        store_insert(alarm_schedule_cron_next(&entry.record.cron, minute), entry.index,
+                     &entry.record);
+      }
+    }
+    if (store_horizon > minute) {
+      break;
+    }
+    // More records go off this minute than fit in memory. Get the others
+    store_rebuild(minute, last);
+  }
+  if ((store_due_count == 0) && (store_horizon != SCHEDULE_NEVER)) {
+    // All records in memory went off. Get the next ones
+    store_rebuild(minute + 1, -1);
+  }
+  store_give();
+  return found;
+}
+
+void schedule_store_refresh(uint32_t from) {
+  if (!store_dirty || !store_take()) {
+    return;
+  }
+  store_dirty = false;
+  store_rebuild(from, -1);
+  store_give();
+}
+
+bool schedule_store_next(uint32_t *when, int *index) {
+  bool found = false;
+  if (!store_take()) {
+    return false;
+  }
+  if (!store_dirty && (store_due_count > 0)) {
+    *when = store_due[0].when;
+    *index = store_due[0].index;
+    found = true;
+  }
+  store_give();
+  return found;
+}
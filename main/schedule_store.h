@@ -0,0 +1,87 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef SCHEDULE_STORE_H_
+#define SCHEDULE_STORE_H_
+
+// A large table of sounds on a cron. Next to the alarm sound slots in
+// clock_settings. The table is a file on the spiffs filesystem. A header
+// and fixed size records. A record is found by its place in the file.
+// A deleted record stays as a free place and is used again.
+//
+// Only the records going off first are kept in memory. Like the alarm
+// schedule the minute tick only looks at the first one. The file is read
+// again after a change. Or when all records in memory went off. So the
+// memory used does not grow with the table.
+//
+// Sounds in the table play when no alarm or sound slot goes off in the
+// same minute. They never change the alarm sound.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "esp_err.h"
+
+// Own include files
+#include "display_functions.h"
+#include "filesystem.h"
+#include "schedule_cron.h"
+
+#define SCHEDULE_STORE_FILE FILESYSTEM1_BASE "/schedule.bin"
+// A damaged file is moved here before a new one is started
+#define SCHEDULE_STORE_BAD_FILE FILESYSTEM1_BASE "/schedule.bad"
+#define SCHEDULE_STORE_MAGIC 0x4c484353  // "SCHL"
+#define SCHEDULE_STORE_VERSION 1
+#define SCHEDULE_STORE_MAX 512  // records in the file
+#define SCHEDULE_STORE_DUE 16   // records going off first kept in memory
+#define SCHEDULE_STORE_APPEND -1
+// Record flags
+#define SCHEDULE_RECORD_USED 0x01
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t count;  // records in the file. Used and free
+} schedule_store_header_t;
+
+typedef struct {
+  schedule_cron_t cron;
+  char soundfile[MAX_SOUNDFILE_LENGTH];
+  uint8_t flags;
+  uint8_t reserved[3];
+} schedule_record_t;
+
+// Make the lock. After the filesystem is started.
+void schedule_store_start(void);
+
+// Records in the file. Used and free
+int schedule_store_count(void);
+
+// Read up to count records from first. Returns the number read. Free
+// records are read too. Check flags.
+int schedule_store_read(int first, schedule_record_t *records, int count);
+
+// Write a record. With index SCHEDULE_STORE_APPEND the first free place
+// is used. Index is set to the place written. A record without
+// SCHEDULE_RECORD_USED frees the place.
+esp_err_t schedule_store_write(int *index, const schedule_record_t *record);
+
+// Sound in the table going off in the minute of now. Each minute only
+// once. False when none. A sound for certain weekdays or dates wins from
+// a sound for all days.
+bool schedule_store_due(const struct tm *now, char *soundfile, int length);
+
+// Read the file again after a write. Without waiting for the next check.
+// From is the first minute not checked yet.
+void schedule_store_refresh(uint32_t from);
+
+// First record to go off. Local minute as in alarm_schedule. False when
+// none or not known yet.
+bool schedule_store_next(uint32_t *when, int *index);
+
+#endif
@@ -13,6 +13,7 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "lwip/apps/sntp.h"
@@ -36,6 +37,26 @@ static const char *TAG = "Time";
 // Struct is also used outside of this file. Do not use seconds.
 // Seconds are only updated 2 times a minute.
 struct tm current_timeinfo;
+// UTC second current_timeinfo was made from. The difference between the two
+// is the offset of local time.
+time_t current_time;
+
+// The clock was corrected. The display task sets the alarm timer again.
+static void time_changed(void) {
+  QueueHandle_t send_queue = display_task_queue();
+  const disp_task_queue_item_t signal_to_send = {.disp_task_signal = alarm_due,
+                                                 .time = esp_timer_get_time()};
+  if (send_queue != 0) {
+    // we do not check if the queue is full
+    xQueueSendToBack(send_queue, &signal_to_send, 0);
+  }
+}
+
+// Called by sntp after setting the time
+static void time_sync_notification(struct timeval *tv) {
+  ESP_LOGI(TAG, "SNTP time set");
+  time_changed();
+}
 
 // Below is started as a FreeRTOS task. And send events just after passing the minute mark. And just
 // after passing the 30 seconds mark.
@@ -64,6 +85,7 @@ void systemtime_start() {
   tzset_patch();
   gettimeofday(&now, NULL);
   localtime_patch(&now.tv_sec, &current_timeinfo);
+  current_time = now.tv_sec;
 
   // The loop below is trying to generate a queue entry just after the zero and
   // 30 second passing. The vtaskdelay is timed to expire just after the start of second 0
@@ -87,9 +109,11 @@ void systemtime_start() {
     gettimeofday(&now, NULL);
     // current_timeinfo is used elsewhere. Seconds are not correct. Because not updated every second.
     localtime_patch(&now.tv_sec, &current_timeinfo);
+    current_time = now.tv_sec;
     // Sending second signal on queue
     if (send_queue != 0) {
       // we do not check if the queue is full
+      signal_to_send.time = esp_timer_get_time();
       xQueueSendToBack(send_queue, &signal_to_send, 0);
     }
     // SNTP update elapsed minutes since last update
@@ -114,6 +138,10 @@ void systemtime_start() {
       ds3231_get_time(&ds3231_tm);
       now.tv_sec = mktime(&ds3231_tm);
       settimeofday(&now, NULL);
+      // Back to local time. The alarm timer can go off before the next loop
+      setenv("TZ", setupparams.timezone, 1);
+      tzset_patch();
+      time_changed();
       ESP_LOGV(TAG, "No recent SNTP sync. DS3231 sets time.");
     }
   }
@@ -137,6 +165,7 @@ void start_stop_sntp(bool action) {
     sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
     sntp_setoperatingmode(SNTP_OPMODE_POLL);
     sntp_setservername(0, setupparams.ntpserver);
+    sntp_set_time_sync_notification_cb(time_sync_notification);
     sntp_init();
   } else {
     ESP_LOGI(TAG, "SNTP will be stopped");
@@ -187,6 +216,7 @@ void set_time(time_t new_time) {
   ESP_LOGI(TAG, "New ESP32 timestamp %lld", new_time);
   now.tv_sec = new_time;
   settimeofday(&now, NULL);
+  time_changed();
   if (ds3231_set_time(gmtime(&now.tv_sec)) == ESP_OK) {
     ESP_LOGI(TAG, "Succesful manual set time in DS3231");
   } else {
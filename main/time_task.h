@@ -16,6 +16,8 @@
 #define SNTP_MAX_TIME_NOSYNC 121
 
 extern struct tm current_timeinfo;
+// UTC second of current_timeinfo
+extern time_t current_time;
 
 // Starts the tasks that sends an event each minute 
 void start_time_task();
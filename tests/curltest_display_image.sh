@@ -0,0 +1,9 @@
+#!/bin/bash
+# Parameter 1 is ip address or fqdn
+# Optional parameter 2 is a golden file with a former answer. Put the
+# clock on a known screen. The answer is compared with the golden file.
+if [ -z "$2" ]; then
+  curl --request POST -H "Content-Type: application/json" --data-binary @displayimage.json http://$1/api/json/request
+else
+  curl --silent --request POST -H "Content-Type: application/json" --data-binary @displayimage.json http://$1/api/json/request | diff -u $2 - && echo "Display image matches $2"
+fi
@@ -0,0 +1,3 @@
+#!/bin/bash
+# Parameter 1 is ip address or fqdn
+curl --request POST -H "Content-Type: application/json" --data-binary @displaytrace.json http://$1/api/json/request
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+#
+# MIT Licensed as described in the file LICENSE
+#
+# Generates font tables from the font header files in main/.
+# Runs at build time. See main/CMakeLists.txt
+#
+# pack:  packed font. The columns of all glyphs in one blob. Glyphs with the
+#        same columns share them. An index with one uint16_t per glyph has
+#        the offset of the first column << 4 | width. Prints the flash bytes
+#        saved compared to the font_8x8[][9] table.
+#        Glyphs of an optional extra header are added after the ASCII glyphs.
+#        Their unicode code point is in the comment as U+XXXX. A sorted
+#        code point table is written for a binary search.
+#
+# usage: fontgen.py pack <font name> <font header> <output header> [extra header]
+
+import os
+import re
+import sys
+
+ASCII_GLYPHS = 128
+
+GLYPH_RE = re.compile(r"^\s*\{((?:\s*0x[0-9a-fA-F]{2}\s*,?){9})\}\s*,?\s*(//.*)?$")
+
+
+def read_font(filename):
+    # Returns a list with (width, [8 columns], comment) for each glyph
+    glyphs = []
+    with open(filename, encoding="latin-1") as font_file:
+        for line in font_file:
+            match = GLYPH_RE.match(line)
+            if match:
+                values = [int(x, 16) for x in re.findall(r"0x[0-9a-fA-F]{2}", match.group(1))]
+                comment = (match.group(2) or "").lstrip("/ ").rstrip()
+                glyphs.append((values[0], values[1:], comment))
+    if not glyphs:
+        sys.exit("fontgen: no glyphs found in " + filename)
+    return glyphs
+
+
+def read_codepoints(glyphs, filename):
+    # Code point of each glyph from the comment. Must be sorted and above ASCII
+    codepoints = []
+    for width, columns, comment in glyphs:
+        match = re.match(r"U\+([0-9a-fA-F]{4})\b", comment)
+        if not match:
+            sys.exit("fontgen: no U+XXXX code point for glyph '%s' in %s" % (comment, filename))
+        codepoint = int(match.group(1), 16)
+        if codepoint < ASCII_GLYPHS or (codepoints and codepoint <= codepoints[-1]):
+            sys.exit("fontgen: code point U+%04X not sorted in %s" % (codepoint, filename))
+        codepoints.append(codepoint)
+    return codepoints
+
+
+def pack(glyphs):
+    # Returns the column blob and the index
+    blob = bytearray()
+    index = []
+    for width, columns, comment in glyphs:
+        glyph = bytes(columns[:width])
+        offset = blob.find(glyph) if width else 0
+        if offset < 0:
+            offset = len(blob)
+            blob += glyph
+        if offset > 0xFFF or width > 0xF:
+            sys.exit("fontgen: font does not fit the packed index")
+        index.append((offset << 4) | width)
+    return blob, index
+
+
+def write_pack(glyphs, codepoints, name, font_name, out_name):
+    if len(glyphs) != ASCII_GLYPHS + len(codepoints):
+        sys.exit("fontgen: %s needs %d ASCII glyphs" % (font_name, ASCII_GLYPHS))
+    blob, index = pack(glyphs)
+    packed_bytes = len(blob) + 2 * len(index) + 2 * len(codepoints)
+    table_bytes = 9 * len(glyphs)
+    report = "%s: %d glyphs. Packed %d bytes. Table %d bytes. Saved %d bytes." % (
+        name, len(glyphs), packed_bytes, table_bytes, table_bytes - packed_bytes)
+    print("fontgen: " + report)
+    lines = []
+    lines.append("// Generated by tools/fontgen.py from %s. Do not edit." % font_name)
+    lines.append("// Packed font. The columns of all glyphs in one blob. One index entry")
+    lines.append("// per glyph with the offset of the first column << 4 | width.")
+    lines.append("// " + report)
+    lines.append("#include <sys/types.h>")
+    lines.append('#include "fonts.h"')
+    lines.append("")
+    lines.append("static const u_int8_t font_%s_columns[] = {" % name)
+    for start in range(0, len(blob), 12):
+        lines.append("    %s," % ", ".join("0x%02X" % v for v in blob[start:start + 12]))
+    lines.append("};")
+    lines.append("")
+    lines.append("static const uint16_t font_%s_index[] = {" % name)
+    for (width, columns, comment), entry in zip(glyphs, index):
+        lines.append("    0x%04X, // %s" % (entry, comment))
+    lines.append("};")
+    lines.append("")
+    if codepoints:
+        lines.append("// Code points of the glyphs after ASCII. Sorted for a binary search.")
+        lines.append("static const uint16_t font_%s_codepoints[] = {" % name)
+        for start in range(0, len(codepoints), 8):
+            lines.append("    %s," % ", ".join("0x%04X" % v for v in codepoints[start:start + 8]))
+        lines.append("};")
+        lines.append("")
+    lines.append("static const font_t font_%s = {" % name)
+    lines.append('    .name = "%s",' % name)
+    lines.append("    .count = %d," % ASCII_GLYPHS)
+    lines.append("    .columns = font_%s_columns," % name)
+    lines.append("    .index = font_%s_index," % name)
+    lines.append("    .extra_count = %d," % len(codepoints))
+    if codepoints:
+        lines.append("    .codepoints = font_%s_codepoints," % name)
+    else:
+        lines.append("    .codepoints = NULL,")
+    lines.append("    .packed_bytes = %d," % packed_bytes)
+    lines.append("    .table_bytes = %d," % table_bytes)
+    lines.append("};")
+    lines.append("")
+    write_if_changed(out_name, "\n".join(lines))
+
+
+def write_if_changed(out_name, text):
+    # Keep the timestamp when nothing changed. Saves recompiling.
+    if os.path.exists(out_name):
+        with open(out_name, encoding="latin-1") as old_file:
+            if old_file.read() == text:
+                return
+    with open(out_name, "w", encoding="latin-1") as out_file:
+        out_file.write(text)
+
+
+def main():
+    if len(sys.argv) not in (5, 6) or sys.argv[1] != "pack":
+        sys.exit("usage: fontgen.py pack <font name> <font header> <output header> "
+                 "[extra header]")
+    glyphs = read_font(sys.argv[3])
+    codepoints = []
+    if len(sys.argv) == 6:
+        extra = read_font(sys.argv[5])
+        codepoints = read_codepoints(extra, sys.argv[5])
+        glyphs += extra
+    write_pack(glyphs, codepoints, sys.argv[2], os.path.basename(sys.argv[3]), sys.argv[4])
+
+
+if __name__ == "__main__":
+    main()
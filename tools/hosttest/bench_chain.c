@@ -0,0 +1,86 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Frames sent to chains of 1 up to MAX7219_MAX_COUNT max7219s. Each
+// chain in its own process. A frame with all dots changed and a frame with
+// one column changed. The time on the SPI wire is worked out from the bits
+// at MAX7219_SPISPEED. The host time is drawing until the frame is on the
+// emulated chain. The chain must show what was drawn.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "max7219.h"
+
+#define BENCH_FRAMES 200
+
+typedef struct {
+  uint32_t transactions;
+  uint64_t bits;
+  uint64_t bus_ns;
+  int64_t host_ns;
+} bench_frame_t;
+
+// Send frames. Each changes the dots of length columns from position
+static void bench_frames(int position, int length, bench_frame_t *result) {
+  u_int8_t columns[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  u_int8_t image[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  hostidf_spi_stats_t stats;
+  int width = max7219_get_width();
+  int frames;
+  int frame;
+  int64_t start;
+  hostidf_spi_stats_clear();
+  start = hosttest_now_ns();
+  for (frame = 0; frame < BENCH_FRAMES; frame++) {
+    memset(columns, (frame & 1) ? 0xAA : 0x55, length);
+    frames = hostdisplay_frames();
+    max7219_sprite_fill_columns(columns, position, length);
+    max7219_send_display();
+    HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "frame %d not sent", frame);
+  }
+  result->host_ns = (hosttest_now_ns() - start) / BENCH_FRAMES;
+  hostidf_spi_stats(&stats);
+  HOSTTEST_CHECK(stats.errors == 0, "%u transactions not the length of the chain", stats.errors);
+  result->transactions = stats.transactions;
+  result->bits = stats.bits / BENCH_FRAMES;
+  result->bus_ns = stats.bus_ns / BENCH_FRAMES;
+  max7219_get_columns(columns);
+  hostidf_chain_image(image);
+  HOSTTEST_CHECK(memcmp(columns, image, width) == 0, "chain of %d shows another image",
+                 width / MAX7219_COLUMNS);
+}
+
+static void bench_chain(void *arg) {
+  int count = *(int *)arg;
+  int width = count * MAX7219_COLUMNS;
+  bench_frame_t full;
+  bench_frame_t column;
+  hostdisplay_start(count, false, false);
+  bench_frames(0, width, &full);
+  bench_frames(width / 2, 1, &column);
+  printf("%6d %9.1f %9.1f %9llu %9.1f %9.1f %9.1f %9.1f\n", count,
+         (double)full.transactions / BENCH_FRAMES, (double)column.transactions / BENCH_FRAMES,
+         (unsigned long long)full.bits, full.bus_ns / 1000.0, column.bus_ns / 1000.0,
+         full.host_ns / 1000.0, column.host_ns / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+  int counts[] = {1, 2, 4, 8, 16, 32, 48, MAX7219_MAX_COUNT};
+  int x;
+  printf("%d frames. Per frame the rows sent, the bits, the time on the wire at %d Hz\n",
+         BENCH_FRAMES, MAX7219_SPISPEED);
+  printf("and the host time from drawing to the frame on the chain. Times in us\n");
+  printf("%6s %9s %9s %9s %9s %9s %9s %9s\n", "chips", "rows all", "rows col", "bits all",
+         "wire all", "wire col", "host all", "host col");
+  for (x = 0; x < sizeof(counts) / sizeof(counts[0]); x++) {
+    hosttest_fork(bench_chain, &counts[x]);
+  }
+  return hosttest_result("bench_chain");
+}
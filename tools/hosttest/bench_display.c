@@ -0,0 +1,76 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Time to draw each screen of display_functions.c. And the time until the
+// frame is on the emulated chain. Each draw starts from an empty display so
+// the rows of the screen are sent. A grayscale screen is only drawn. Its
+// planes are sent by the plane timer.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "max7219.h"
+
+#define BENCH_DRAWS 1000
+
+typedef struct {
+  int count;
+  bool rotate90;
+} bench_config_t;
+
+static void bench_display(void *arg) {
+  const bench_config_t *config = arg;
+  int64_t draw_ns;
+  int64_t frame_ns;
+  int64_t start;
+  int frames;
+  int screen;
+  int draw;
+  bool gray;
+  hostdisplay_start(config->count, config->rotate90, false);
+  for (screen = 0; screen < hostscreens_count; screen++) {
+    draw_ns = 0;
+    frame_ns = 0;
+    gray = false;
+    for (draw = 0; draw < BENCH_DRAWS; draw++) {
+      frames = hostdisplay_frames();
+      max7219_empty_display_buffer();
+      max7219_send_display();
+      HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "empty display not sent");
+      frames = hostdisplay_frames();
+      start = hosttest_now_ns();
+      hostscreens[screen].draw();
+      draw_ns += hosttest_now_ns() - start;
+      gray = max7219_gray_showing();
+      if (!gray) {
+        HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "%s not sent", hostscreens[screen].name);
+      }
+      frame_ns += hosttest_now_ns() - start;
+    }
+    if (gray) {
+      printf("%6d %-7s %-10s %9.2f %9s\n", config->count, config->rotate90 ? "rotated" : "normal",
+             hostscreens[screen].name, draw_ns / 1000.0 / BENCH_DRAWS, "gray");
+    } else {
+      printf("%6d %-7s %-10s %9.2f %9.2f\n", config->count,
+             config->rotate90 ? "rotated" : "normal", hostscreens[screen].name,
+             draw_ns / 1000.0 / BENCH_DRAWS, frame_ns / 1000.0 / BENCH_DRAWS);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bench_config_t configs[] = {{4, false}, {4, true}, {8, false}, {8, true}};
+  int x;
+  printf("%d draws of each screen. Times in us on the host\n", BENCH_DRAWS);
+  printf("%6s %-7s %-10s %9s %9s\n", "chips", "modules", "screen", "draw", "frame");
+  for (x = 0; x < sizeof(configs) / sizeof(configs[0]); x++) {
+    hosttest_fork(bench_display, &configs[x]);
+  }
+  return hosttest_result("bench_display");
+}
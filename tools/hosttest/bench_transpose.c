@@ -0,0 +1,85 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// max7219_transpose against turning the bits one by one. Both ways. On
+// random blocks for a chain of MAX7219_MAX_COUNT. Checks they give the
+// same rows and columns. Then times both.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "max7219.h"
+
+#define BENCH_BYTES (MAX7219_MAX_COUNT * MAX7219_COLUMNS)
+#define BENCH_ROUNDS 20000
+
+// The bit loop. Columns into rows of rotated modules. Row 0 of a module is
+// the bottom row. Bit 0 is the left column. And back.
+static void transpose_bits(u_int8_t *buffer, int modules, bool to_rows) {
+  u_int8_t block[MAX7219_COLUMNS];
+  int module;
+  int row;
+  int x;
+  for (module = 0; module < modules; module++) {
+    memset(block, 0, MAX7219_COLUMNS);
+    for (row = 0; row < MAX7219_COLUMNS; row++) {
+      for (x = 0; x < MAX7219_COLUMNS; x++) {
+        if (to_rows && (buffer[(module * MAX7219_COLUMNS) + x] & (0x80 >> row))) {
+          block[row] |= 1 << x;
+        }
+        if (!to_rows && (buffer[(module * MAX7219_COLUMNS) + row] & (1 << x))) {
+          block[x] |= 0x80 >> row;
+        }
+      }
+    }
+    memcpy(&buffer[module * MAX7219_COLUMNS], block, MAX7219_COLUMNS);
+  }
+}
+
+static double time_ns(void (*transpose)(u_int8_t *, int, bool), u_int8_t *buffer) {
+  int64_t start = hosttest_now_ns();
+  int round;
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    transpose(buffer, MAX7219_MAX_COUNT, (round & 1) == 0);
+  }
+  return (double)(hosttest_now_ns() - start) / ((double)BENCH_ROUNDS * MAX7219_MAX_COUNT);
+}
+
+int main(int argc, char *argv[]) {
+  u_int8_t columns[BENCH_BYTES];
+  u_int8_t words[BENCH_BYTES];
+  u_int8_t bits[BENCH_BYTES];
+  double words_ns;
+  double bits_ns;
+  int round;
+  int x;
+  srand(1);
+  for (round = 0; round < 1000; round++) {
+    for (x = 0; x < BENCH_BYTES; x++) {
+      columns[x] = rand();
+    }
+    memcpy(words, columns, BENCH_BYTES);
+    memcpy(bits, columns, BENCH_BYTES);
+    max7219_transpose(words, MAX7219_MAX_COUNT, true);
+    transpose_bits(bits, MAX7219_MAX_COUNT, true);
+    HOSTTEST_CHECK(memcmp(words, bits, BENCH_BYTES) == 0, "rows of round %d", round);
+    max7219_transpose(words, MAX7219_MAX_COUNT, false);
+    transpose_bits(bits, MAX7219_MAX_COUNT, false);
+    HOSTTEST_CHECK(memcmp(bits, columns, BENCH_BYTES) == 0, "bit loop back of round %d", round);
+    HOSTTEST_CHECK(memcmp(words, columns, BENCH_BYTES) == 0, "columns of round %d", round);
+  }
+  words_ns = time_ns(max7219_transpose, words);
+  bits_ns = time_ns(transpose_bits, bits);
+  printf("Transpose of an 8x8 block. %d blocks %d times\n", MAX7219_MAX_COUNT, BENCH_ROUNDS);
+  printf("  word parallel %6.2f ns\n", words_ns);
+  printf("  bit loop      %6.2f ns\n", bits_ns);
+  printf("  %.1f times faster\n", bits_ns / words_ns);
+  return hosttest_result("bench_transpose");
+}
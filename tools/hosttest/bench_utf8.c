@@ -0,0 +1,81 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Rendering ASCII strings against strings with UTF-8 characters. Both the
+// decoder alone and max7219_render_columns. In every font. Per character.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "fonts.h"
+#include "max7219.h"
+
+#define BENCH_ROUNDS 200000
+
+typedef struct {
+  const char *name;
+  char *text;
+} bench_text_t;
+
+static char ascii_text[] = "Alarm 07:30 Mo-Fr 21.5 C";
+static char mixed_text[] = "Alarm 07:30 M\xC3\xA5-F\xC3\xB6 21.5\xC2\xB0" "C";
+static char extra_text[] = "\xE2\x86\x90\xE2\x82\xAC\xC3\xA9\xC3\xBC\xC2\xB0\xE2\x86\x92";
+
+static int characters(const char *text) {
+  int count = 0;
+  while (*text) {
+    fonts_utf8_next(&text);
+    count++;
+  }
+  return count;
+}
+
+static double decode_ns(const char *text) {
+  int64_t start = hosttest_now_ns();
+  volatile uint32_t sum = 0;
+  const char *next;
+  int round;
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    next = text;
+    while (*next) {
+      sum += fonts_utf8_next(&next);
+    }
+  }
+  return (double)(hosttest_now_ns() - start) / ((double)BENCH_ROUNDS * characters(text));
+}
+
+static double render_ns(char *text) {
+  u_int8_t columns[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  int64_t start = hosttest_now_ns();
+  int round;
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    max7219_render_columns(text, columns, sizeof(columns));
+  }
+  return (double)(hosttest_now_ns() - start) / ((double)BENCH_ROUNDS * characters(text));
+}
+
+int main(int argc, char *argv[]) {
+  bench_text_t texts[] = {{"ascii", ascii_text}, {"mixed", mixed_text}, {"extra", extra_text}};
+  u_int8_t columns[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  int font;
+  int x;
+  printf("Per character in ns. %d rounds\n", BENCH_ROUNDS);
+  printf("%-10s %-6s %6s %7s %7s\n", "font", "text", "chars", "decode", "render");
+  for (font = 0; font < fonts_count(); font++) {
+    fonts_select(font);
+    for (x = 0; x < sizeof(texts) / sizeof(texts[0]); x++) {
+      // Every character has a glyph
+      HOSTTEST_CHECK(max7219_render_columns(texts[x].text, columns, sizeof(columns)) > 0,
+                     "%s not rendered in %s", texts[x].name, fonts_get(font)->name);
+      printf("%-10s %-6s %6d %7.1f %7.1f\n", fonts_get(font)->name, texts[x].name,
+             characters(texts[x].text), decode_ns(texts[x].text), render_ns(texts[x].text));
+    }
+  }
+  return hosttest_result("bench_utf8");
+}
@@ -0,0 +1,134 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The display of max7219.c on the emulated chain of hostidf.c. See
+// hosttest.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "max7219.h"
+
+// Counted by the flush task
+static volatile int frames_done = 0;
+
+static void hostdisplay_flush_done(void) {
+  __atomic_add_fetch(&frames_done, 1, __ATOMIC_SEQ_CST);
+}
+
+void hostdisplay_start(int count, bool rotate90, bool reverse) {
+  max7219_config_t config = {.count = count, .rotate90 = rotate90, .reverse = reverse};
+  int position;
+  hostidf_chain(count, rotate90, reverse);
+  HOSTTEST_CHECK(max7219_init_spi(&config) == ESP_OK, "max7219_init_spi %d chips", count);
+  max7219_set_flush_done_cb(hostdisplay_flush_done);
+  for (position = 0; position < count; position++) {
+    // Out of shutdown. All digits scanned. No decoding
+    HOSTTEST_CHECK((hostidf_chain_register(position, 0x0c) == 1) &&
+                       (hostidf_chain_register(position, 0x0b) == 7) &&
+                       (hostidf_chain_register(position, 0x09) == 0),
+                   "chip %d not reset", position);
+  }
+}
+
+int hostdisplay_frames(void) {
+  return __atomic_load_n(&frames_done, __ATOMIC_SEQ_CST);
+}
+
+bool hostdisplay_wait(int frames) {
+  int64_t until = hosttest_now_ns() + 1000000000;
+  while (hostdisplay_frames() < frames) {
+    if (hosttest_now_ns() > until) {
+      return false;
+    }
+    usleep(10);
+  }
+  // The flush task is done with the frame after collecting its rows
+  max7219_wait_display();
+  return true;
+}
+
+void hostdisplay_print(const u_int8_t *columns, int width) {
+  int x;
+  int y;
+  for (y = 0; y < 8; y++) {
+    for (x = 0; x < width; x++) {
+      fputc((columns[x] & (1 << y)) ? '#' : '.', stderr);
+    }
+    fputc('\n', stderr);
+  }
+}
+
+static void hostdisplay_golden_write(const char *path, const u_int8_t *levels, int width,
+                                     int max_level) {
+  FILE *file = fopen(path, "w");
+  int x;
+  int y;
+  if (file == NULL) {
+    HOSTTEST_CHECK(false, "can not write %s", path);
+    return;
+  }
+  if (max_level == 1) {
+    fprintf(file, "P1\n%d %d\n", width, MAX7219_COLUMNS);
+  } else {
+    fprintf(file, "P2\n%d %d\n%d\n", width, MAX7219_COLUMNS, max_level);
+  }
+  for (y = 0; y < MAX7219_COLUMNS; y++) {
+    for (x = 0; x < width; x++) {
+      fprintf(file, (max_level == 1) ? "%d" : "%d ", levels[(y * width) + x]);
+    }
+    fputc('\n', file);
+  }
+  fclose(file);
+}
+
+bool hostdisplay_golden(const char *name, const u_int8_t *levels, int width, int max_level) {
+  char path[128];
+  FILE *file;
+  bool same;
+  int magic;
+  int golden_width;
+  int height;
+  int level;
+  int x;
+  int y;
+  snprintf(path, sizeof(path), "golden/%s.%s", name, (max_level == 1) ? "pbm" : "pgm");
+  if (getenv("HOSTTEST_UPDATE") != NULL) {
+    hostdisplay_golden_write(path, levels, width, max_level);
+    return true;
+  }
+  file = fopen(path, "r");
+  if (file == NULL) {
+    HOSTTEST_CHECK(false, "no golden file %s", path);
+    return false;
+  }
+  // Written by hostdisplay_golden_write. No comments
+  same = (fscanf(file, "P%d %d %d", &magic, &golden_width, &height) == 3) &&
+         (magic == ((max_level == 1) ? 1 : 2)) && (golden_width == width) &&
+         (height == MAX7219_COLUMNS) &&
+         ((max_level == 1) || ((fscanf(file, "%d", &level) == 1) && (level == max_level)));
+  for (x = 0; same && (x < width * MAX7219_COLUMNS); x++) {
+    // Dots of a PBM need no space between them
+    same = (fscanf(file, (max_level == 1) ? " %1d" : "%d", &level) == 1) && (level == levels[x]);
+  }
+  fclose(file);
+  HOSTTEST_CHECK(same, "image is not %s", path);
+  if (!same) {
+    // Level per dot. Rows from the top
+    for (y = 0; y < MAX7219_COLUMNS; y++) {
+      for (x = 0; x < width; x++) {
+        fputc(levels[(y * width) + x] ? '0' + levels[(y * width) + x] : '.', stderr);
+      }
+      fputc('\n', stderr);
+    }
+  }
+  return same;
+}
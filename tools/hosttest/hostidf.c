@@ -0,0 +1,605 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// ESP-IDF and FreeRTOS of hosttest_idf.h on the host. And the checks of
+// hosttest.h.
+// - tasks are threads. Mutexes, queues and notifications are pthread ones
+// - esp_timer_get_time is the monotonic clock. esp_timers never go off
+// - gettimeofday is the clock of the host. settimeofday moves it
+// - the SPI bus is a chain of max7219s. Each transaction is shifted
+//   through the chain and latched. Straight away in the calling thread
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hosttest.h"
+
+#define HOSTIDF_CHAIN_MAX 64
+#define HOSTIDF_SPI_QUEUE 16
+
+uint32_t hosttest_checks = 0;
+uint32_t hosttest_failed = 0;
+
+void hosttest_fail(const char *file, int line, const char *format, ...) {
+  va_list args;
+  hosttest_failed++;
+  if (hosttest_failed > 20) {
+    return;
+  }
+  fprintf(stderr, "FAIL %s:%d: ", file, line);
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+int hosttest_result(const char *name) {
+  if (hosttest_failed) {
+    printf("%s: %u of %u checks failed\n", name, hosttest_failed, hosttest_checks);
+    return 1;
+  }
+  printf("%s: %u checks passed\n", name, hosttest_checks);
+  return 0;
+}
+
+int64_t hosttest_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+bool hosttest_fork(void (*run)(void *arg), void *arg) {
+  pid_t child;
+  int status;
+  int counts_pipe[2];
+  uint32_t counts[2] = {0, 1};
+  // Not twice in the output
+  fflush(stdout);
+  fflush(stderr);
+  if (pipe(counts_pipe) != 0) {
+    hosttest_checks++;
+    hosttest_failed++;
+    return false;
+  }
+  child = fork();
+  if (child == 0) {
+    close(counts_pipe[0]);
+    hosttest_checks = 0;
+    hosttest_failed = 0;
+    run(arg);
+    fflush(stdout);
+    fflush(stderr);
+    // The checks of the child are added to the parent
+    counts[0] = hosttest_checks;
+    counts[1] = hosttest_failed;
+    if (write(counts_pipe[1], counts, sizeof(counts)) != sizeof(counts)) {
+      _exit(1);
+    }
+    _exit(hosttest_failed ? 1 : 0);
+  }
+  close(counts_pipe[1]);
+  if ((child < 0) || (read(counts_pipe[0], counts, sizeof(counts)) != sizeof(counts))) {
+    // Crashed before counting. One failed check
+    counts[0] = 1;
+    counts[1] = 1;
+  }
+  close(counts_pipe[0]);
+  hosttest_checks += counts[0];
+  hosttest_failed += counts[1];
+  if ((child < 0) || (waitpid(child, &status, 0) != child) || !WIFEXITED(status) ||
+      (WEXITSTATUS(status) != 0)) {
+    if (counts[1] == 0) {
+      hosttest_checks++;
+      hosttest_failed++;
+    }
+    return false;
+  }
+  return true;
+}
+
+void timewarp_log(const char *level, const char *tag, const char *format, ...) {
+  va_list args;
+  if (getenv("HOSTTEST_VERBOSE") == NULL) {
+    return;
+  }
+  fprintf(stderr, "%s %s: ", level, tag);
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  return (code == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+uint32_t esp_random(void) {
+  // The same each run
+  static uint32_t seed = 1;
+  seed = (seed * 1103515245) + 12345;
+  return seed;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t copy = (length < size - 1) ? length : size - 1;
+    memcpy(dst, src, copy);
+    dst[copy] = 0;
+  }
+  return length;
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+  return calloc(n, size);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  return malloc(size);
+}
+
+// Clock
+static int64_t wall_offset_us = 0;
+
+int timewarp_gettimeofday(struct timeval *tv, void *tz) {
+  struct timeval host;
+  int64_t now;
+  gettimeofday(&host, NULL);
+  now = ((int64_t)host.tv_sec * 1000000) + host.tv_usec + wall_offset_us;
+  tv->tv_sec = now / 1000000;
+  tv->tv_usec = now % 1000000;
+  return 0;
+}
+
+int timewarp_settimeofday(const struct timeval *tv, const struct timezone *tz) {
+  struct timeval host;
+  gettimeofday(&host, NULL);
+  wall_offset_us = (((int64_t)tv->tv_sec - host.tv_sec) * 1000000) + tv->tv_usec - host.tv_usec;
+  return 0;
+}
+
+void tzset_patch(void) {
+  tzset();
+}
+
+struct tm *localtime_patch(const time_t *__restrict tim_p, struct tm *__restrict res) {
+  return localtime_r(tim_p, res);
+}
+
+int64_t esp_timer_get_time(void) {
+  return hosttest_now_ns() / 1000;
+}
+
+// esp_timer. Never goes off by itself. See hostidf_timer_fire
+typedef struct esp_timer {
+  esp_timer_cb_t callback;
+  void *arg;
+  const char *name;
+  bool running;
+  struct esp_timer *next;
+} hostidf_timer_t;
+
+static hostidf_timer_t *timers = NULL;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+  hostidf_timer_t *timer = calloc(1, sizeof(hostidf_timer_t));
+  if (timer == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  timer->callback = args->callback;
+  timer->arg = args->arg;
+  timer->name = args->name;
+  timer->next = timers;
+  timers = timer;
+  *handle = timer;
+  return ESP_OK;
+}
+
+bool hostidf_timer_fire(const char *name) {
+  hostidf_timer_t *timer;
+  for (timer = timers; timer != NULL; timer = timer->next) {
+    if ((timer->name != NULL) && (strcmp(timer->name, name) == 0) && timer->running) {
+      timer->callback(timer->arg);
+      return true;
+    }
+  }
+  return false;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  timer->running = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+  timer->running = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->running = false;
+  return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags) {
+  return ESP_OK;
+}
+
+// Tasks
+typedef struct timewarp_task {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  uint32_t notified;
+  void (*code)(void *);
+  void *arg;
+} hostidf_task_t;
+
+static hostidf_task_t main_task = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                                   .wake = PTHREAD_COND_INITIALIZER};
+static __thread hostidf_task_t *current_task = NULL;
+
+static void *hostidf_task_start(void *arg) {
+  current_task = arg;
+  current_task->code(current_task->arg);
+  return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core) {
+  hostidf_task_t *new_task = calloc(1, sizeof(hostidf_task_t));
+  if (new_task == NULL) {
+    return pdFALSE;
+  }
+  pthread_mutex_init(&new_task->lock, NULL);
+  pthread_cond_init(&new_task->wake, NULL);
+  new_task->code = task;
+  new_task->arg = arg;
+  if (pthread_create(&new_task->thread, NULL, hostidf_task_start, new_task) != 0) {
+    return pdFALSE;
+  }
+  pthread_detach(new_task->thread);
+  if (handle != NULL) {
+    *handle = new_task;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(void (*task)(), const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(task, name, stack, arg, priority, handle, 0);
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  pthread_mutex_lock(&task->lock);
+  task->notified++;
+  pthread_cond_signal(&task->wake);
+  pthread_mutex_unlock(&task->lock);
+}
+
+// Only waits forever. Like all callers in the firmware
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+  hostidf_task_t *task = (current_task != NULL) ? current_task : &main_task;
+  uint32_t notified;
+  pthread_mutex_lock(&task->lock);
+  while (task->notified == 0) {
+    pthread_cond_wait(&task->wake, &task->lock);
+  }
+  notified = task->notified;
+  task->notified = clear ? 0 : notified - 1;
+  pthread_mutex_unlock(&task->lock);
+  return notified;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+  usleep(ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return esp_timer_get_time() / (portTICK_PERIOD_MS * 1000);
+}
+
+// Queues and mutexes
+typedef struct timewarp_queue {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  u_int8_t *items;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  UBaseType_t head;
+  UBaseType_t count;
+  pthread_mutex_t hold;  // the mutex of xSemaphoreCreateMutex
+} hostidf_queue_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  hostidf_queue_t *queue = calloc(1, sizeof(hostidf_queue_t));
+  if (queue == NULL) {
+    return NULL;
+  }
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->changed, NULL);
+  pthread_mutex_init(&queue->hold, NULL);
+  queue->length = length;
+  queue->item_size = item_size;
+  queue->items = calloc(length ? length : 1, item_size ? item_size : 1);
+  return queue;
+}
+
+// Wait for the condition of a queue. False after the wait in ticks
+static bool hostidf_queue_wait(hostidf_queue_t *queue, TickType_t wait) {
+  struct timespec until;
+  int64_t ns;
+  if (wait == 0) {
+    return false;
+  }
+  if (wait == portMAX_DELAY) {
+    pthread_cond_wait(&queue->changed, &queue->lock);
+    return true;
+  }
+  clock_gettime(CLOCK_REALTIME, &until);
+  ns = until.tv_nsec + ((int64_t)wait * portTICK_PERIOD_MS * 1000000);
+  until.tv_sec += ns / 1000000000;
+  until.tv_nsec = ns % 1000000000;
+  return pthread_cond_timedwait(&queue->changed, &queue->lock, &until) == 0;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == queue->length) {
+    if (!hostidf_queue_wait(queue, wait)) {
+      pthread_mutex_unlock(&queue->lock);
+      return pdFALSE;
+    }
+  }
+  memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->item_size], item,
+         queue->item_size);
+  queue->count++;
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->lock);
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken) {
+  return xQueueSendToBack(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0) {
+    if (!hostidf_queue_wait(queue, wait)) {
+      pthread_mutex_unlock(&queue->lock);
+      return pdFALSE;
+    }
+  }
+  memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->lock);
+  return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0) {
+    if (!hostidf_queue_wait(queue, wait)) {
+      pthread_mutex_unlock(&queue->lock);
+      return pdFALSE;
+    }
+  }
+  memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+  pthread_mutex_unlock(&queue->lock);
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  UBaseType_t count;
+  pthread_mutex_lock(&queue->lock);
+  count = queue->count;
+  pthread_mutex_unlock(&queue->lock);
+  return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+  if (wait == 0) {
+    return (pthread_mutex_trylock(&semaphore->hold) == 0) ? pdTRUE : pdFALSE;
+  }
+  pthread_mutex_lock(&semaphore->hold);
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  pthread_mutex_unlock(&semaphore->hold);
+  return pdTRUE;
+}
+
+// FreeRTOS software timers. Never go off
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload, void *id,
+                           TimerCallbackFunction_t callback) {
+  static int timer;
+  return (TimerHandle_t)&timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait) {
+  return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait) {
+  return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait) {
+  return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait) {
+  return pdPASS;
+}
+
+// The chain of max7219s. 16 registers per chip
+static u_int8_t chain_registers[HOSTIDF_CHAIN_MAX][16];
+static int chain_count = 4;
+static bool chain_rotate90 = false;
+static bool chain_reverse = false;
+static hostidf_spi_stats_t spi_stats;
+static pthread_mutex_t spi_lock = PTHREAD_MUTEX_INITIALIZER;
+// Queued transactions to go before one is refused. 0 is none refused
+static volatile int spi_queue_fail = 0;
+
+struct spi_device_t {
+  spi_device_interface_config_t config;
+  spi_transaction_t *done[HOSTIDF_SPI_QUEUE];
+  int done_head;
+  int done_count;
+};
+
+void hostidf_chain(int count, bool rotate90, bool reverse) {
+  chain_count = MIN(count, HOSTIDF_CHAIN_MAX);
+  chain_rotate90 = rotate90;
+  chain_reverse = reverse;
+  memset(chain_registers, 0, sizeof(chain_registers));
+}
+
+void hostidf_chain_image(u_int8_t *columns) {
+  int module;
+  int position;
+  int x;
+  int y;
+  pthread_mutex_lock(&spi_lock);
+  for (module = 0; module < chain_count; module++) {
+    // The chip next to the ESP32 is the left module. Or the right one
+    position = chain_reverse ? (chain_count - 1 - module) : module;
+    for (x = 0; x < 8; x++) {
+      if (!chain_rotate90) {
+        // Digit register is a column. Bit 0 at the top
+        columns[(module * 8) + x] = chain_registers[position][1 + x];
+        continue;
+      }
+      // Digit register is a row. Register 1 at the bottom. Bit 0 on the left
+      columns[(module * 8) + x] = 0;
+      for (y = 0; y < 8; y++) {
+        if (chain_registers[position][8 - y] & (1 << x)) {
+          columns[(module * 8) + x] |= 1 << y;
+        }
+      }
+    }
+  }
+  pthread_mutex_unlock(&spi_lock);
+}
+
+u_int8_t hostidf_chain_register(int position, int reg) {
+  return chain_registers[position][reg & 0x0f];
+}
+
+void hostidf_spi_stats(hostidf_spi_stats_t *stats) {
+  pthread_mutex_lock(&spi_lock);
+  *stats = spi_stats;
+  pthread_mutex_unlock(&spi_lock);
+}
+
+void hostidf_spi_fail_queue(int nth) {
+  spi_queue_fail = nth;
+}
+
+void hostidf_spi_stats_clear(void) {
+  pthread_mutex_lock(&spi_lock);
+  memset(&spi_stats, 0, sizeof(spi_stats));
+  pthread_mutex_unlock(&spi_lock);
+}
+
+// Shift the 16 bit words through the chain. The first word sent ends in
+// the chip at the far end. Chip select going up latches all of them.
+static void hostidf_spi_send(spi_device_handle_t handle, spi_transaction_t *trans) {
+  const u_int8_t *data = trans->tx_buffer;
+  int words = trans->length / 16;
+  int position;
+  pthread_mutex_lock(&spi_lock);
+  spi_stats.transactions++;
+  spi_stats.bits += trans->length;
+  spi_stats.bus_ns += (uint64_t)trans->length * 1000000000 / handle->config.clock_speed_hz;
+  if ((words != chain_count) || (trans->length % 16)) {
+    spi_stats.errors++;
+  }
+  for (position = 0; (position < chain_count) && (position < words); position++) {
+    // No-op register 0 leaves the chip as it is
+    if (data[(words - 1 - position) * 2] & 0x0f) {
+      chain_registers[position][data[(words - 1 - position) * 2] & 0x0f] =
+          data[((words - 1 - position) * 2) + 1];
+    }
+  }
+  pthread_mutex_unlock(&spi_lock);
+  if (handle->config.post_cb != NULL) {
+    handle->config.post_cb(trans);
+  }
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                             int dma_chan) {
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle) {
+  spi_device_handle_t device = calloc(1, sizeof(struct spi_device_t));
+  if (device == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  device->config = *config;
+  *handle = device;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans) {
+  hostidf_spi_send(handle, trans);
+  return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans,
+                                 TickType_t wait) {
+  if ((spi_queue_fail > 0) && (--spi_queue_fail == 0)) {
+    return ESP_ERR_TIMEOUT;
+  }
+  if ((handle->done_count == HOSTIDF_SPI_QUEUE) ||
+      (handle->done_count == handle->config.queue_size)) {
+    return ESP_ERR_TIMEOUT;
+  }
+  hostidf_spi_send(handle, trans);
+  handle->done[(handle->done_head + handle->done_count) % HOSTIDF_SPI_QUEUE] = trans;
+  handle->done_count++;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans,
+                                      TickType_t wait) {
+  if (handle->done_count == 0) {
+    // Would wait forever on the ESP32
+    return ESP_ERR_TIMEOUT;
+  }
+  *trans = handle->done[handle->done_head];
+  handle->done_head = (handle->done_head + 1) % HOSTIDF_SPI_QUEUE;
+  handle->done_count--;
+  return ESP_OK;
+}
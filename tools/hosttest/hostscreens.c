@@ -0,0 +1,67 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The screens of display_functions.c with fixed settings. For the golden
+// images and the draw timing. See hosttest.h
+
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "display_functions.h"
+#include "max7219.h"
+#include "schedule_cron.h"
+#include "time_task.h"
+
+// Monday 2024-01-08 07:45
+static void hostscreens_now(void) {
+  current_timeinfo.tm_year = 124;
+  current_timeinfo.tm_mon = 0;
+  current_timeinfo.tm_mday = 8;
+  current_timeinfo.tm_hour = 7;
+  current_timeinfo.tm_min = 45;
+}
+
+static void hostscreens_time(void) {
+  hostscreens_now();
+  time_sendto_display();
+}
+
+static void hostscreens_alarm(void) {
+  // The time shown is the next one of the cron. Not the old fields
+  hostscreens_now();
+  schedule_cron_parse("30 6,21 * * *", &clock_settings.cron[0]);
+  clock_settings.alarmsounds[0].hour = 0;
+  clock_settings.alarmsounds[0].minute = 0;
+  clock_settings.alarm_onoff = true;
+  alarm_sendto_display();
+}
+
+static void hostscreens_sleep(void) {
+  clock_settings.sleep_minutes = 9;
+  sleep_sendto_display();
+}
+
+static void hostscreens_brightness(void) {
+  clock_settings.brightness = 12;
+  brightness_sendto_display();
+}
+
+// Like the start of display_clock
+static void hostscreens_clock(void) {
+  max7219_fill_display_buffer("Clock", MAX7219_ALIGN_MIDDLE);
+}
+
+const hostscreen_t hostscreens[] = {
+    {"time", hostscreens_time},
+    {"alarm", hostscreens_alarm},
+    {"sleep", hostscreens_sleep},
+    {"brightness", hostscreens_brightness},
+    {"clock", hostscreens_clock},
+};
+
+const int hostscreens_count = sizeof(hostscreens) / sizeof(hostscreens[0]);
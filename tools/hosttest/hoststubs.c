@@ -0,0 +1,84 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The rest of the clock for the host tests of the display and alarm code.
+// Like the time warp simulation. See hosttest.h
+
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "defaults_globals.h"
+#include "display_functions.h"
+#include "ds3231.h"
+#include "networkstartstop.h"
+#include "nvramfunctions.h"
+#include "sound.h"
+
+setupparams_t setupparams;
+clock_settings_t clock_settings;
+
+int hoststubs_alarms = 0;
+int hoststubs_sounds = 0;
+char hoststubs_last_sound[32];
+
+// No network. No SNTP
+bool sntp_enabled(void) {
+  return false;
+}
+void sntp_init(void) {
+}
+void sntp_stop(void) {
+}
+void sntp_set_sync_mode(sntp_sync_mode_t mode) {
+}
+void sntp_setoperatingmode(uint8_t mode) {
+}
+void sntp_setservername(uint8_t index, const char *server) {
+}
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {
+}
+sntp_sync_status_t sntp_get_sync_status(void) {
+  return SNTP_SYNC_STATUS_RESET;
+}
+void network_get_ip(char *ip_text, int length) {
+  strlcpy(ip_text, "0.0.0.0", length);
+}
+
+// The DS3231 has the time of the ESP32
+esp_err_t ds3231_get_time(struct tm *time) {
+  struct timeval now;
+  timewarp_gettimeofday(&now, NULL);
+  gmtime_r(&now.tv_sec, time);
+  return ESP_OK;
+}
+
+esp_err_t ds3231_set_time(struct tm *time) {
+  return ESP_OK;
+}
+
+esp_err_t ds3231_get_temp_float(float *temp) {
+  *temp = 21.5;
+  return ESP_OK;
+}
+
+void play_wav(char *wavsound, int repeat) {
+  if (repeat) {
+    hoststubs_alarms++;
+  } else {
+    hoststubs_sounds++;
+  }
+  strlcpy(hoststubs_last_sound, wavsound, sizeof(hoststubs_last_sound));
+}
+
+void stop_sound(void) {
+}
+
+void write_nvram(void *blob, size_t sizeof_blob, char *blobname) {
+}
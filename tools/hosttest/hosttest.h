@@ -0,0 +1,111 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef HOSTTEST_H_
+#define HOSTTEST_H_
+
+// Checks and helpers for the host tests and benchmarks. See hosttest.sh
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "hosttest_idf.h"
+
+// Check a condition. Failures are counted. The first ones are printed.
+#define HOSTTEST_CHECK(condition, ...)                   \
+  do {                                                   \
+    hosttest_checks++;                                   \
+    if (!(condition)) {                                  \
+      hosttest_fail(__FILE__, __LINE__, __VA_ARGS__);    \
+    }                                                    \
+  } while (0)
+
+extern uint32_t hosttest_checks;
+extern uint32_t hosttest_failed;
+
+void hosttest_fail(const char *file, int line, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Print the result. Returns the exit status for main
+int hosttest_result(const char *name);
+
+// Monotonic time in nanoseconds. For the benchmarks
+int64_t hosttest_now_ns(void);
+
+// Run in a child process. max7219_init_spi and other starts only work
+// once per process. The checks and failures of the child are added. False
+// when the child failed.
+bool hosttest_fork(void (*run)(void *arg), void *arg);
+
+// The emulated chain of max7219s on the SPI bus. hostidf.c
+// How the modules are really wired. Set before max7219_init_spi. Position
+// 0 is the chip next to the ESP32. Reverse is a chain starting on the
+// right side. Rotate90 are modules turned 90 degrees.
+void hostidf_chain(int count, bool rotate90, bool reverse);
+
+// What the modules show. A byte per column from the left. Bit 0 is the
+// top row. Only the digit registers. Shutdown and test mode are not
+// looked at.
+void hostidf_chain_image(u_int8_t *columns);
+
+// Register of a chip in the chain
+u_int8_t hostidf_chain_register(int position, int reg);
+
+// Run the callback of a running esp_timer. By the name it was created
+// with. Like it went off. False when no such timer runs.
+bool hostidf_timer_fire(const char *name);
+
+typedef struct {
+  uint32_t transactions;
+  uint64_t bits;
+  uint64_t bus_ns;  // time on the wire at the clock of the device
+  uint32_t errors;  // transactions not the length of the chain
+} hostidf_spi_stats_t;
+void hostidf_spi_stats(hostidf_spi_stats_t *stats);
+void hostidf_spi_stats_clear(void);
+
+// Refuse the nth transaction queued from now. Like a full queue. Once
+void hostidf_spi_fail_queue(int nth);
+
+// The display on the emulated chain. hostdisplay.c
+// Start the display with this chain. Checks the reset of the chips.
+void hostdisplay_start(int count, bool rotate90, bool reverse);
+
+// Frames completely on the display
+int hostdisplay_frames(void);
+
+// Wait until frames are on the display. False after a second.
+bool hostdisplay_wait(int frames);
+
+// Show columns as rows of '#' and '.'. For failures
+void hostdisplay_print(const u_int8_t *columns, int width);
+
+// Compare an image with the golden file golden/<name>.pbm. A byte per dot
+// with the level. Rows of width dots from the top. A max_level of 1 is a
+// plain PBM (P1). Others a plain PGM (P2) in golden/<name>.pgm. With
+// HOSTTEST_UPDATE set in the environment the golden file is written.
+// True when they are the same.
+bool hostdisplay_golden(const char *name, const u_int8_t *levels, int width, int max_level);
+
+// The screens of display_functions.c. Each draws with its own settings
+// and sends the frame. hostscreens.c
+typedef struct {
+  const char *name;
+  void (*draw)(void);
+} hostscreen_t;
+extern const hostscreen_t hostscreens[];
+extern const int hostscreens_count;
+
+// The rest of the clock around the display and alarm code. hoststubs.c
+// No network. No NVS. The DS3231 has the time of hostidf.c. The sounds
+// played are counted.
+extern int hoststubs_alarms;
+extern int hoststubs_sounds;
+extern char hoststubs_last_sound[32];
+
+#endif
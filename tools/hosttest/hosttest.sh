@@ -0,0 +1,104 @@
+#!/bin/bash
+# Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+#
+# MIT Licensed as described in the file LICENSE
+#
+# Builds the host tests and benchmarks of this directory and runs them.
+# Files of main/ are compiled with hosttest_idf.h in place of ESP-IDF and
+# FreeRTOS. hostidf.c implements it on the host. The SPI bus is a chain of
+# emulated max7219s. The C compiler of the host is used. No ESP-IDF.
+#
+# usage: hosttest.sh [name]...
+#   test_*   checks. Without names all tests run
+#   bench_*  timings. Only run when named
+# Exit status is 1 when a test fails.
+# Build directory is $HOSTTEST_BUILD. Default /tmp/hosttest
+
+set -e
+
+TOOL=$(cd "$(dirname "$0")" && pwd)
+MAIN=$(cd "$TOOL/../../main" && pwd)
+BUILD=${HOSTTEST_BUILD:-/tmp/hosttest}
+CC=${CC:-cc}
+CFLAGS="-O2 -g -pthread -Wall -Wno-format -Wno-unused-variable -Wno-unused-function"
+
+TESTS="test_glyphs test_cache test_utf8 test_display test_transitions test_decoder test_schedule test_alarm"
+
+# The screens of display_functions.c and the code they call
+DISPLAY_SOURCES="main/display_functions main/display_anim main/display_scroll main/max7219
+  main/fonts main/alarm_schedule main/schedule_cron main/schedule_store main/app_queue
+  main/time_task hostdisplay hostscreens hoststubs"
+
+# Files each program is built from besides its own and hostidf.c.
+# main/ files are firmware. Others are in this directory.
+sources() {
+  case $1 in
+    test_glyphs) echo "main/max7219 main/fonts hostdisplay" ;;
+    test_cache) echo "main/max7219 main/fonts hostdisplay" ;;
+    test_utf8) echo "main/fonts" ;;
+    test_display) echo "$DISPLAY_SOURCES" ;;
+    test_transitions) echo "main/app_queue" ;;
+    test_decoder) echo "main/rotary_decoder" ;;
+    test_schedule) echo "main/alarm_schedule main/schedule_cron" ;;
+    test_alarm) echo "$DISPLAY_SOURCES" ;;
+    bench_transpose) echo "main/max7219 main/fonts" ;;
+    bench_chain) echo "main/max7219 main/fonts hostdisplay" ;;
+    bench_utf8) echo "main/max7219 main/fonts" ;;
+    bench_display) echo "$DISPLAY_SOURCES" ;;
+    *)
+      echo "Unknown test $1" >&2
+      exit 1
+      ;;
+  esac
+}
+
+# IDF header names the firmware includes
+HEADERS="esp_attr.h esp_err.h esp_heap_caps.h esp_log.h esp_system.h esp_timer.h sdkconfig.h
+  sntp.h freertos/FreeRTOS.h freertos/portmacro.h freertos/queue.h freertos/semphr.h
+  freertos/task.h freertos/timers.h driver/gpio.h driver/i2c.h driver/pcnt.h
+  driver/spi_common.h driver/spi_master.h hal/gpio_types.h lwip/apps/sntp.h"
+
+mkdir -p "$BUILD/include" "$BUILD/main"
+for header in $HEADERS; do
+  mkdir -p "$BUILD/include/$(dirname "$header")"
+  echo '#include "hosttest_idf.h"' >"$BUILD/include/$header"
+done
+# Packed fonts. Like main/CMakeLists.txt
+for font in terminal noto; do
+  python3 "$TOOL/../fontgen.py" pack $font "$MAIN/font_$font.h" "$BUILD/font_${font}_packed.h" \
+    "$MAIN/font_extra.h" >/dev/null
+done
+
+INCLUDES="-I$BUILD/include -I$BUILD -I$TOOL -I$TOOL/../timewarp -I$MAIN"
+
+# Compile a file once a run. Firmware gets the clock of hostidf.c
+object() {
+  local name=$1
+  local object="$BUILD/$name.o"
+  if [ ! -f "$object" ]; then
+    case $name in
+      main/*)
+        $CC $CFLAGS $INCLUDES -Dgettimeofday=timewarp_gettimeofday \
+          -Dsettimeofday=timewarp_settimeofday -c "$MAIN/${name#main/}.c" -o "$object"
+        ;;
+      *) $CC $CFLAGS $INCLUDES -c "$TOOL/$name.c" -o "$object" ;;
+    esac
+  fi
+  echo "$object"
+}
+
+NAMES=${*:-$TESTS}
+rm -f "$BUILD"/*.o "$BUILD"/main/*.o
+failed=0
+for name in $NAMES; do
+  objects="$(object "$name") $(object hostidf)"
+  for source in $(sources "$name"); do
+    objects="$objects $(object "$source")"
+  done
+  $CC $CFLAGS -o "$BUILD/$name" $objects -lm
+  # Golden files are found from this directory
+  if ! (cd "$TOOL" && "$BUILD/$name"); then
+    failed=1
+  fi
+done
+exit $failed
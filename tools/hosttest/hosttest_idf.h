@@ -0,0 +1,94 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef HOSTTEST_IDF_H_
+#define HOSTTEST_IDF_H_
+
+// The part of ESP-IDF and FreeRTOS used by the firmware files in the host
+// tests. On top of the one of the time warp simulation. hosttest.sh makes
+// every IDF header name the firmware includes point to this file.
+// hostidf.c implements it.
+
+#include <sys/types.h>
+
+#include "timewarp_idf.h"
+
+// esp_heap_caps.h
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_8BIT (1 << 2)
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *heap_caps_malloc(size_t size, uint32_t caps);
+
+// freertos/queue.h
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait);
+
+// driver/gpio.h. No interrupts
+esp_err_t gpio_install_isr_service(int flags);
+
+// freertos/task.h. Tasks are threads
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+
+// driver/spi_common.h, driver/spi_master.h. The bus is a chain of
+// emulated max7219s.
+#define SPI_DEVICE_NO_DUMMY (1 << 6)
+typedef struct {
+  int mosi_io_num;
+  int miso_io_num;
+  int sclk_io_num;
+  int quadwp_io_num;
+  int quadhd_io_num;
+  int max_transfer_sz;
+  uint32_t flags;
+  int intr_flags;
+} spi_bus_config_t;
+
+typedef struct {
+  uint32_t flags;
+  uint16_t cmd;
+  uint64_t addr;
+  size_t length;  // bits
+  size_t rxlength;
+  void *user;
+  const void *tx_buffer;
+  void *rx_buffer;
+} spi_transaction_t;
+
+typedef void (*transaction_cb_t)(spi_transaction_t *trans);
+
+typedef struct {
+  uint8_t command_bits;
+  uint8_t address_bits;
+  uint8_t dummy_bits;
+  uint8_t mode;
+  uint16_t duty_cycle_pos;
+  uint16_t cs_ena_pretrans;
+  uint8_t cs_ena_posttrans;
+  int clock_speed_hz;
+  int input_delay_ns;
+  int spics_io_num;
+  uint32_t flags;
+  int queue_size;
+  transaction_cb_t pre_cb;
+  transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+                             int dma_chan);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans,
+                                 TickType_t wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans,
+                                      TickType_t wait);
+
+#endif
@@ -0,0 +1,104 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The alarm of display_functions.c over a few days. The alarm on workdays.
+// It is off when it goes off on friday and switched on later that day. It
+// must not ring in the weekend. On monday sleep is pressed once and the
+// alarm switched off after. Tuesday rings at the alarm time again. Minute
+// ticks twice a minute like time_task.c. Then the encoder on the alarm
+// display.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "alarm_schedule.h"
+#include "display_functions.h"
+#include "schedule_cron.h"
+#include "time_task.h"
+
+#define TEST_TZ "CET-1CEST,M3.5.0,M10.5.0/3"
+#define TEST_START 1704433800  // 2024-01-05 06:50 CET. A friday
+#define TEST_END 1704783600    // 2024-01-09 08:00 CET
+
+int main(int argc, char *argv[]) {
+  // Rings expected. Day of the month, hour and minute
+  const int expected[][3] = {{8, 7, 0}, {8, 7, 9}, {9, 7, 0}};
+  const int expected_count = sizeof(expected) / sizeof(expected[0]);
+  struct timeval now = {0};
+  struct tm local;
+  schedule_cron_t cron;
+  int rings = 0;
+  setenv("TZ", TEST_TZ, 1);
+  tzset();
+  memset(&clock_settings, 0, sizeof(clock_settings));
+  clock_settings.cron_version = CLOCK_CRON_VERSION;
+  clock_settings.sleep_minutes = 9;
+  clock_settings.default_on = true;
+  clock_settings.alarmsounds[0].hour = 7;
+  strcpy(clock_settings.alarmsounds[0].soundfile, "alarm");
+  schedule_cron_parse("0 7 * * 1-5", &clock_settings.cron[0]);
+  alarm_schedule_changed();
+  for (now.tv_sec = TEST_START; now.tv_sec < TEST_END; now.tv_sec += 30) {
+    timewarp_settimeofday(&now, NULL);
+    localtime_r(&now.tv_sec, &local);
+    // Like the minute tick of time_task.c
+    current_time = now.tv_sec;
+    current_timeinfo = local;
+    if ((local.tm_mday == 5) && (local.tm_hour == 12) && (local.tm_min == 0) &&
+        (local.tm_sec == 0)) {
+      // Switched on after the alarm time
+      alarm_onoff();
+      HOSTTEST_CHECK(clock_settings.alarm_onoff, "alarm not switched on");
+    }
+    if (check_for_alarm(&local)) {
+      HOSTTEST_CHECK((rings < expected_count) && (local.tm_mday == expected[rings][0]) &&
+                         (local.tm_hour == expected[rings][1]) &&
+                         (local.tm_min == expected[rings][2]),
+                     "alarm rings on the %d at %02d:%02d", local.tm_mday, local.tm_hour,
+                     local.tm_min);
+      if (rings == 0) {
+        alarm_add_sleep();
+      } else {
+        alarm_off();
+      }
+      rings++;
+    }
+    alarm_timer_arm();
+  }
+  HOSTTEST_CHECK(rings == expected_count, "%d rings", rings);
+  HOSTTEST_CHECK(hoststubs_alarms == rings, "%d alarm sounds for %d rings", hoststubs_alarms,
+                 rings);
+  HOSTTEST_CHECK(strcmp(hoststubs_last_sound, "alarm") == 0, "alarm sound %s",
+                 hoststubs_last_sound);
+  // One time. The encoder changes it. The days stay
+  clock_settings.alarm_onoff = true;
+  alarm_set_time(1);
+  HOSTTEST_CHECK((clock_settings.alarmsounds[0].hour == 7) &&
+                     (clock_settings.alarmsounds[0].minute == 5),
+                 "encoder set the alarm to %02d:%02d", clock_settings.alarmsounds[0].hour,
+                 clock_settings.alarmsounds[0].minute);
+  schedule_cron_parse("5 7 * * 1-5", &cron);
+  HOSTTEST_CHECK(memcmp(&cron, &clock_settings.cron[0], sizeof(cron)) == 0,
+                 "encoder did not keep the workdays");
+  // More times. Not thrown away by the encoder
+  schedule_cron_parse("0 7,9 * * 1-5", &clock_settings.cron[0]);
+  cron = clock_settings.cron[0];
+  alarm_set_time(-1);
+  HOSTTEST_CHECK(memcmp(&cron, &clock_settings.cron[0], sizeof(cron)) == 0,
+                 "encoder changed an alarm with more times");
+  // Shown is the next time. It is tuesday 07:59
+  alarm_time_from_cron();
+  HOSTTEST_CHECK((clock_settings.alarmsounds[0].hour == 9) &&
+                     (clock_settings.alarmsounds[0].minute == 0),
+                 "next alarm shown at %02d:%02d", clock_settings.alarmsounds[0].hour,
+                 clock_settings.alarmsounds[0].minute);
+  return hosttest_result("test_alarm");
+}
@@ -0,0 +1,110 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The string strip cache of max7219.c. Every draw is counted once. A string
+// in the cache and a string too long for it are drawn the same way. On a lit
+// background only the glyphs and the spacing between them change. Normal
+// and rotated modules.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "fonts.h"
+#include "max7219.h"
+
+#define TEST_COUNT 8
+#define TEST_WIDTH (TEST_COUNT * MAX7219_COLUMNS)
+
+// Columns of text from the font on a lit background
+static void expected_columns(const char *text, int position, u_int8_t *columns) {
+  const char *next = text;
+  const u_int8_t *glyph;
+  int width;
+  int x;
+  memset(columns, 0xFF, TEST_WIDTH);
+  while (*next) {
+    width = fonts_glyph(fonts_utf8_next(&next), &glyph);
+    for (x = 0; x < width; x++, position++) {
+      if ((position >= 0) && (position < TEST_WIDTH)) {
+        columns[position] = glyph[x];
+      }
+    }
+    if ((*next) && (position >= 0) && (position < TEST_WIDTH)) {
+      columns[position] = 0x00;
+    }
+    position++;
+  }
+}
+
+static void check_draw(char *text, int position, bool cached) {
+  u_int8_t lit[TEST_WIDTH];
+  u_int8_t columns[TEST_WIDTH];
+  u_int8_t expected[TEST_WIDTH];
+  max7219_cache_stats_t before;
+  max7219_cache_stats_t after;
+  memset(lit, 0xFF, TEST_WIDTH);
+  max7219_sprite_fill_columns(lit, 0, TEST_WIDTH);
+  max7219_get_cache_stats(&before);
+  max7219_sprite_fill_buffer(text, position);
+  max7219_get_cache_stats(&after);
+  HOSTTEST_CHECK((after.hits + after.misses) - (before.hits + before.misses) == (cached ? 1 : 0),
+                 "\"%s\" looked up in the cache %u times", text,
+                 (after.hits + after.misses) - (before.hits + before.misses));
+  HOSTTEST_CHECK(after.uncached - before.uncached == (cached ? 0 : 1),
+                 "\"%s\" counted %u times uncached", text, after.uncached - before.uncached);
+  max7219_get_columns(columns);
+  expected_columns(text, position, expected);
+  if (memcmp(columns, expected, TEST_WIDTH) != 0) {
+    HOSTTEST_CHECK(false, "\"%s\" at %d %s", text, position, cached ? "cached" : "uncached");
+    hostdisplay_print(expected, TEST_WIDTH);
+    hostdisplay_print(columns, TEST_WIDTH);
+  }
+}
+
+static void test_cache(void *arg) {
+  bool rotate90 = *(bool *)arg;
+  char short_text[] = "12:34";
+  char long_text[] = "Alarm 07:30 Mo-Fr";
+  char wide_text[] = "WWWWWWWWWWWWWW";
+  max7219_cache_stats_t before;
+  max7219_cache_stats_t after;
+  int position;
+  hostdisplay_start(TEST_COUNT, rotate90, false);
+  // First a miss. Then hits
+  max7219_get_cache_stats(&before);
+  max7219_fill_display_buffer(short_text, 0);
+  max7219_fill_display_buffer(short_text, 0);
+  max7219_get_cache_stats(&after);
+  HOSTTEST_CHECK((after.misses - before.misses == 1) && (after.hits - before.hits == 1) &&
+                     (after.uncached == before.uncached),
+                 "short string %u misses %u hits %u uncached", after.misses - before.misses,
+                 after.hits - before.hits, after.uncached - before.uncached);
+  // Too long and too wide strings are counted once a draw
+  max7219_get_cache_stats(&before);
+  max7219_fill_display_buffer(long_text, 0);
+  max7219_fill_display_buffer(wide_text, 0);
+  max7219_get_cache_stats(&after);
+  HOSTTEST_CHECK((after.uncached - before.uncached == 2) && (after.misses == before.misses) &&
+                     (after.hits == before.hits),
+                 "uncached strings %u misses %u hits %u uncached", after.misses - before.misses,
+                 after.hits - before.hits, after.uncached - before.uncached);
+  for (position = -12; position < 24; position++) {
+    check_draw(short_text, position, true);
+    check_draw(long_text, position, false);
+    check_draw(wide_text, position, false);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool rotate90 = false;
+  hosttest_fork(test_cache, &rotate90);
+  rotate90 = true;
+  hosttest_fork(test_cache, &rotate90);
+  return hosttest_result("test_cache");
+}
@@ -0,0 +1,202 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The encoder decoding of rotary_decoder.c. The state tables on turns with
+// bouncing contacts. The pulse counter with its jump back to zero at the
+// limits. Detents with the rest kept for the next poll. And the steps of
+// the acceleration.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "rotary_decoder.h"
+#include "rotary_encoder.h"
+
+// Pins BA of one full step clockwise. From rest at 11
+static const uint8_t cw_cycle[4] = {0x3, 0x1, 0x0, 0x2};
+
+// Feed pin states. Returns the detents. Clockwise positive
+static int feed(rotary_decoder_t *decoder, const uint8_t *pins, int length) {
+  int detents = 0;
+  uint8_t event;
+  int x;
+  for (x = 0; x < length; x++) {
+    event = rotary_decoder_step(decoder, pins[x]);
+    if (event == DIR_CW) {
+      detents++;
+    } else if (event == DIR_CCW) {
+      detents--;
+    }
+  }
+  return detents;
+}
+
+// Turns of full steps. Bounce goes back a state and forward again at each
+// edge.
+static int turn(rotary_decoder_t *decoder, int steps, bool bounce) {
+  uint8_t pins[1024];
+  int length = 0;
+  int direction = (steps < 0) ? -1 : 1;
+  int position;
+  for (position = 1; position <= abs(steps) * 4; position++) {
+    if (bounce) {
+      pins[length++] = cw_cycle[(direction * position) & 3];
+      pins[length++] = cw_cycle[(direction * (position - 1)) & 3];
+    }
+    pins[length++] = cw_cycle[(direction * position) & 3];
+  }
+  return feed(decoder, pins, length);
+}
+
+static void test_tables(void) {
+  rotary_decoder_t decoder;
+  const uint8_t half_back[] = {0x1, 0x0, 0x1, 0x3};
+  int half;
+  int steps;
+  int bounce;
+  for (half = 0; half < 2; half++) {
+    for (bounce = 0; bounce < 2; bounce++) {
+      for (steps = -5; steps <= 5; steps++) {
+        rotary_decoder_init(&decoder, half);
+        HOSTTEST_CHECK(turn(&decoder, steps, bounce) == steps * (half ? 2 : 1),
+                       "%d steps %s%s", steps, half ? "half step" : "full step",
+                       bounce ? " bouncing" : "");
+      }
+    }
+    // Half way and back is no detent for full step. Half step gives one
+    // each way.
+    rotary_decoder_init(&decoder, half);
+    HOSTTEST_CHECK(feed(&decoder, half_back, sizeof(half_back)) == 0,
+                   "half way and back %s", half ? "half step" : "full step");
+  }
+}
+
+// The pulse counter. Counts one by one. Back to zero at the limits.
+static int16_t pcnt_move(int16_t count, int counts, int16_t limit) {
+  int x;
+  for (x = 0; x < abs(counts); x++) {
+    count += (counts < 0) ? -1 : 1;
+    if ((count == limit) || (count == -limit)) {
+      count = 0;
+    }
+  }
+  return count;
+}
+
+static void test_pcnt(int16_t limit, int16_t stride) {
+  int last;
+  int counts;
+  int16_t now;
+  for (last = -limit + 1; last < limit; last += stride) {
+    for (counts = -(limit / 2) + 1; counts < limit / 2; counts += stride) {
+      now = pcnt_move(last, counts, limit);
+      HOSTTEST_CHECK(rotary_decoder_pcnt_counts(last, now, limit) == counts,
+                     "limit %d from %d to %d is not %d counts", limit, last, now, counts);
+    }
+  }
+}
+
+// Polls of the pulse counter during random turns. Only whole detents come
+// out. The rest is kept.
+static void test_detents(int counts_per_detent) {
+  int32_t counts = 0;
+  int32_t turned = 0;
+  int16_t last = 0;
+  int16_t now = 0;
+  int detents = 0;
+  int moved;
+  int poll;
+  int x;
+  srand(counts_per_detent);
+  for (x = -12; x <= 12; x++) {
+    counts = x;
+    moved = rotary_decoder_detents(&counts, counts_per_detent);
+    HOSTTEST_CHECK((moved * counts_per_detent + counts == x) && (abs(counts) < counts_per_detent) &&
+                       ((counts == 0) || ((counts < 0) == (x < 0))),
+                   "%d counts are %d detents and %d left", x, moved, counts);
+  }
+  counts = 0;
+  for (poll = 0; poll < 100000; poll++) {
+    moved = (rand() % 200) - 100;
+    turned += moved;
+    now = pcnt_move(now, moved, ROTARY_PCNT_LIMIT);
+    counts += rotary_decoder_pcnt_counts(last, now, ROTARY_PCNT_LIMIT);
+    last = now;
+    detents += rotary_decoder_detents(&counts, counts_per_detent);
+  }
+  HOSTTEST_CHECK((detents * counts_per_detent) + counts == turned,
+                 "%d detents and %d counts after %d counts", detents, counts, turned);
+}
+
+typedef struct {
+  int detents;
+  int after_ms;  // since the previous one
+  int steps;
+} accel_case_t;
+
+static void test_accel(void) {
+  const rotary_accel_point_t curve[] = {{40, 6}, {20, 3}, {10, 2}};
+  const rotary_accel_point_t encoder_curve[] = ROTARY_ACCEL_CURVE;
+  const accel_case_t cases[] = {
+      {0, 10, 0},     // nothing turned
+      {1, 1000, 1},   // starts slow
+      {1, 20, 6},     // 50 per second
+      {1, 20, 6},
+      {1, 60, 3},     // smoothed to 30ms. 33 per second
+      {1, 60, 3},     // 37ms
+      {1, 100, 2},    // 53ms. 18 per second
+      {-1, 20, -1},   // turns back. Slow
+      {-3, 60, -18},  // 20ms each. 6 steps each
+      {-1, 300, -1},  // pause longer than the reset
+      {2, 0, 2},      // turns back at the same time
+  };
+  rotary_accel_t accel;
+  int64_t now = 0;
+  uint32_t steps = 0;
+  int x;
+  int step;
+  int previous;
+  rotary_decoder_accel_init(&accel, curve, 3, 250000);
+  for (x = 0; x < sizeof(cases) / sizeof(cases[0]); x++) {
+    now += cases[x].after_ms * 1000;
+    step = rotary_decoder_accelerate(&accel, cases[x].detents, now);
+    HOSTTEST_CHECK(step == cases[x].steps, "case %d: %d steps. Not %d", x, step, cases[x].steps);
+    steps += abs(cases[x].steps);
+  }
+  HOSTTEST_CHECK(accel.steps == steps, "%u steps counted. Not %u", accel.steps, steps);
+  HOSTTEST_CHECK(accel.velocity_max == 50, "fastest %u detents per second", accel.velocity_max);
+  // Without a curve a detent is a step
+  rotary_decoder_accel_init(&accel, NULL, 0, 250000);
+  HOSTTEST_CHECK((rotary_decoder_accelerate(&accel, 3, 1000) == 3) &&
+                     (rotary_decoder_accelerate(&accel, 3, 2000) == 3),
+                 "no curve");
+  // The curve of the clock. Never fewer steps when turning faster
+  previous = 0;
+  for (x = 500; x >= 2; x--) {
+    rotary_decoder_accel_init(&accel, encoder_curve,
+                              sizeof(encoder_curve) / sizeof(encoder_curve[0]),
+                              ROTARY_ACCEL_RESET_US);
+    for (now = 0, step = 0; now < 20 * x * 1000; now += x * 1000) {
+      step = rotary_decoder_accelerate(&accel, 1, now + 1000000);
+    }
+    HOSTTEST_CHECK((step >= previous) && (step >= 1), "%d steps at a detent each %dms", step, x);
+    previous = step;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  test_tables();
+  test_pcnt(40, 1);
+  test_pcnt(ROTARY_PCNT_LIMIT, 61);
+  test_detents(4);
+  test_detents(2);
+  test_accel();
+  return hosttest_result("test_decoder");
+}
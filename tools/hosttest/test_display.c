@@ -0,0 +1,156 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Every screen of display_functions.c on chains of 4 and 8 max7219s.
+// Normal, rotated and reversed. What the emulated chips show must be the
+// golden image golden/<screen>_<width>. The same for every way the
+// modules are wired. A grayscale screen is taken plane by plane. Its
+// golden image is a PGM with the level of each dot.
+// HOSTTEST_UPDATE=1 hosttest.sh test_display writes the golden images.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "max7219.h"
+
+typedef struct {
+  int count;
+  bool rotate90;
+  bool reverse;
+} display_config_t;
+
+static const display_config_t configs[] = {
+    {4, false, false}, {4, true, false}, {8, false, true}, {8, true, true},
+};
+
+// The columns of the chain as a level per dot. Rows from the top
+static void add_levels(const u_int8_t *columns, int width, int level, u_int8_t *levels) {
+  int x;
+  int y;
+  for (y = 0; y < MAX7219_COLUMNS; y++) {
+    for (x = 0; x < width; x++) {
+      if (columns[x] & (1 << y)) {
+        levels[(y * width) + x] += level;
+      }
+    }
+  }
+}
+
+// Let the plane timer go off for one cycle. Each plane is sent once
+static void gray_levels(int width, u_int8_t *levels) {
+  u_int8_t image[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  int frames;
+  int slot;
+  int plane;
+  u_int8_t columns[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  HOSTTEST_CHECK(max7219_get_image(columns) == ESP_ERR_INVALID_STATE,
+                 "image read back of a grayscale frame");
+  for (slot = 0; slot < MAX7219_GRAY_MAX_LEVEL; slot++) {
+    frames = hostdisplay_frames();
+    HOSTTEST_CHECK(hostidf_timer_fire("grayplanes"), "plane timer not running");
+    // A plane starts at slot 2^n - 1
+    if (((slot + 1) & slot) != 0) {
+      continue;
+    }
+    for (plane = 0; (slot + 1) >> (plane + 1); plane++) {
+    }
+    HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "plane %d not sent", plane);
+    hostidf_chain_image(image);
+    add_levels(image, width, 1 << plane, levels);
+  }
+}
+
+// Wait until every chip has the brightness. False after a second
+static bool brightness_wait(int count, int brightness) {
+  int64_t until = hosttest_now_ns() + 1000000000;
+  int position;
+  for (position = 0; position < count; position++) {
+    while (hostidf_chain_register(position, 0x0a) != brightness) {
+      if (hosttest_now_ns() > until) {
+        return false;
+      }
+      usleep(10);
+    }
+  }
+  return true;
+}
+
+static void test_display(void *arg) {
+  const display_config_t *config = arg;
+  u_int8_t image[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  u_int8_t columns[MAX7219_MAX_COUNT * MAX7219_COLUMNS];
+  u_int8_t levels[MAX7219_MAX_COUNT * MAX7219_COLUMNS * MAX7219_COLUMNS];
+  max7219_flush_stats_t before;
+  max7219_flush_stats_t after;
+  char name[32];
+  int width = config->count * MAX7219_COLUMNS;
+  int frames;
+  int screen;
+  hostdisplay_start(config->count, config->rotate90, config->reverse);
+  for (screen = 0; screen < hostscreens_count; screen++) {
+    snprintf(name, sizeof(name), "%s_%d", hostscreens[screen].name, width);
+    memset(levels, 0, sizeof(levels));
+    frames = hostdisplay_frames();
+    hostscreens[screen].draw();
+    if (max7219_gray_showing()) {
+      gray_levels(width, levels);
+      hostdisplay_golden(name, levels, width, MAX7219_GRAY_MAX_LEVEL);
+      continue;
+    }
+    HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "%s not sent", name);
+    hostidf_chain_image(image);
+    add_levels(image, width, 1, levels);
+    if (!hostdisplay_golden(name, levels, width, 1)) {
+      fprintf(stderr, "%d chips%s%s\n", config->count, config->rotate90 ? " rotated" : "",
+              config->reverse ? " reversed" : "");
+    }
+    // The drawn frame is what the chips show. And what is read back.
+    max7219_get_columns(columns);
+    HOSTTEST_CHECK(memcmp(columns, image, width) == 0, "%s drawn is not shown", name);
+    HOSTTEST_CHECK((max7219_get_image(columns) == ESP_OK) && (memcmp(columns, image, width) == 0),
+                   "%s read back is not shown", name);
+  }
+  // A frame with nothing changed sends nothing. It is done but has no
+  // flush time. Unless it is the full refresh
+  max7219_get_flush_stats(&before);
+  frames = hostdisplay_frames();
+  max7219_send_display();
+  HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "unchanged frame not done");
+  max7219_get_flush_stats(&after);
+  HOSTTEST_CHECK(after.flush_count == before.flush_count + (after.rows_sent != before.rows_sent),
+                 "unchanged frame has a flush time");
+  // The last row can not be queued. The frame is still done
+  memset(columns, 0x5a, width);
+  max7219_sprite_fill_columns(columns, 0, width);
+  frames = hostdisplay_frames();
+  hostidf_spi_fail_queue(MAX7219_COLUMNS);
+  max7219_send_display();
+  HOSTTEST_CHECK(hostdisplay_wait(frames + 1), "frame with a refused row not done");
+  hostidf_spi_fail_queue(0);
+  // Posted by the brightness timer. The flush task writes it without a
+  // frame. Also while it sends the planes of a grayscale screen
+  frames = hostdisplay_frames();
+  max7219_post_brightness(9);
+  HOSTTEST_CHECK(brightness_wait(config->count, 9), "posted brightness not written");
+  HOSTTEST_CHECK(hostdisplay_frames() == frames, "posted brightness sent a frame");
+  hostscreens[0].draw();
+  max7219_post_brightness(4);
+  HOSTTEST_CHECK(brightness_wait(config->count, 4), "posted brightness not written in grayscale");
+  max7219_set_brightness(6);
+  HOSTTEST_CHECK(brightness_wait(config->count, 6), "brightness not set");
+}
+
+int main(int argc, char *argv[]) {
+  int x;
+  for (x = 0; x < sizeof(configs) / sizeof(configs[0]); x++) {
+    hosttest_fork(test_display, (void *)&configs[x]);
+  }
+  return hosttest_result("test_display");
+}
@@ -0,0 +1,114 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Every glyph of every font drawn on a rotated display. At every position
+// from just left of the display to just right of it. The rows in the
+// display buffer must be the columns of the font turned bit by bit.
+// Through the strip cache (the glyph alone) and through the glyph path
+// (the glyph and 16 spaces is too long for the cache).
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "fonts.h"
+#include "max7219.h"
+
+#define TEST_MODULES 4
+#define TEST_COLUMNS (TEST_MODULES * MAX7219_COLUMNS)
+
+// max7219.c. The rows of the rotated display
+extern u_int8_t *display_buffer;
+
+// Code point as UTF-8
+static int utf8_encode(uint32_t character, char *text) {
+  if (character < 0x80) {
+    text[0] = character;
+    return 1;
+  }
+  if (character < 0x800) {
+    text[0] = 0xC0 | (character >> 6);
+    text[1] = 0x80 | (character & 0x3F);
+    return 2;
+  }
+  text[0] = 0xE0 | (character >> 12);
+  text[1] = 0x80 | ((character >> 6) & 0x3F);
+  text[2] = 0x80 | (character & 0x3F);
+  return 3;
+}
+
+// Columns into the rows of rotated modules. Bit by bit. Row 0 of a
+// module is the bottom row. Bit 0 is the left column.
+static void rows_from_columns(const u_int8_t *columns, u_int8_t *rows) {
+  int module;
+  int row;
+  int x;
+  memset(rows, 0, TEST_COLUMNS);
+  for (module = 0; module < TEST_MODULES; module++) {
+    for (row = 0; row < MAX7219_COLUMNS; row++) {
+      for (x = 0; x < MAX7219_COLUMNS; x++) {
+        if (columns[(module * MAX7219_COLUMNS) + x] & (0x80 >> row)) {
+          rows[(module * MAX7219_COLUMNS) + row] |= 1 << x;
+        }
+      }
+    }
+  }
+}
+
+// Draw the text at all positions. Only the glyph columns are expected on
+// the background.
+static void check_glyph(char *text, uint32_t character, u_int8_t background) {
+  const u_int8_t *glyph;
+  int width = fonts_glyph(character, &glyph);
+  u_int8_t fill[TEST_COLUMNS];
+  u_int8_t expected[TEST_COLUMNS];
+  u_int8_t rows[TEST_COLUMNS];
+  int position;
+  int x;
+  memset(fill, background, TEST_COLUMNS);
+  for (position = -MAX7219_COLUMNS - 1; position <= TEST_COLUMNS; position++) {
+    max7219_empty_display_buffer();
+    max7219_sprite_fill_columns(fill, 0, TEST_COLUMNS);
+    max7219_sprite_fill_buffer(text, position);
+    memcpy(expected, fill, TEST_COLUMNS);
+    for (x = 0; x < width; x++) {
+      if ((position + x >= 0) && (position + x < TEST_COLUMNS)) {
+        expected[position + x] = glyph[x];
+      }
+    }
+    rows_from_columns(expected, rows);
+    HOSTTEST_CHECK(memcmp(rows, display_buffer, TEST_COLUMNS) == 0,
+                   "font %d U+%04X \"%s\" at %d", fonts_selected(), character, text, position);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const font_t *font;
+  char text[32];
+  int length;
+  int font_nr;
+  int glyph;
+  hostdisplay_start(TEST_MODULES, true, false);
+  for (font_nr = 0; font_nr < fonts_count(); font_nr++) {
+    fonts_select(font_nr);
+    font = fonts_get(font_nr);
+    // Character 0 ends the string
+    for (glyph = 1; glyph < font->count + font->extra_count; glyph++) {
+      uint32_t character = (glyph < font->count) ? glyph : font->codepoints[glyph - font->count];
+      length = utf8_encode(character, text);
+      text[length] = 0;
+      // Cached. On a lit display to see only the glyph columns change
+      check_glyph(text, character, 0xFF);
+      // Too long for the cache. On an empty display, the spaces clear
+      memset(&text[length], ' ', MAX7219_STRIP_CACHE_TEXT);
+      text[length + MAX7219_STRIP_CACHE_TEXT] = 0;
+      check_glyph(text, character, 0x00);
+    }
+  }
+  return hosttest_result("test_glyphs");
+}
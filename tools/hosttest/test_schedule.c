@@ -0,0 +1,165 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The index of alarm_schedule.c against the scan it replaced. A year of
+// minute ticks twice a minute in CET/CEST. With the daylight saving
+// changes. The scan matches the cron of every slot with the local time.
+// Each local minute once. The slots are random crons. They change each
+// month. The first entry of the index must be the next time a slot goes
+// off.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "alarm_schedule.h"
+#include "display_functions.h"
+#include "schedule_cron.h"
+
+#define TEST_TZ "CET-1CEST,M3.5.0,M10.5.0/3"
+#define TEST_START 1704067200  // 2024-01-01 00:00 UTC
+#define TEST_DAYS 366
+#define TEST_LOOKAHEAD_DAYS 8
+
+clock_settings_t clock_settings;
+
+// A field of a cron line. All, a number, a list, a range or a step.
+static void random_field(char *text, int low, int high, int all_percent) {
+  int first = low + (rand() % (high - low + 1));
+  int second = low + (rand() % (high - low + 1));
+  switch ((rand() % 100) < all_percent ? 0 : 1 + (rand() % 4)) {
+    case 0:
+      strcpy(text, "*");
+      break;
+    case 1:
+      sprintf(text, "%d", first);
+      break;
+    case 2:
+      sprintf(text, "%d,%d", first, second);
+      break;
+    case 3:
+      sprintf(text, "%d-%d", (first < second) ? first : second, (first < second) ? second : first);
+      break;
+    default:
+      sprintf(text, "*/%d", 2 + (rand() % 20));
+      break;
+  }
+}
+
+static void random_slots(void) {
+  char fields[5][32];
+  char text[200];
+  int slot;
+  memset(&clock_settings, 0, sizeof(clock_settings));
+  clock_settings.cron_version = CLOCK_CRON_VERSION;
+  // The alarm on workdays. Sounds on few minutes. Some only pick the
+  // alarm sound.
+  schedule_cron_parse("0 7 * * 1-5", &clock_settings.cron[0]);
+  for (slot = 1; slot < MAX_SOUNDFILES; slot++) {
+    if ((rand() % 4) == 0) {
+      // Empty slot
+      continue;
+    }
+    random_field(fields[0], 0, 59, 0);
+    random_field(fields[1], 0, 23, 10);
+    random_field(fields[2], 1, 31, 70);
+    random_field(fields[3], 1, 12, 70);
+    random_field(fields[4], 0, 7, 60);
+    snprintf(text, sizeof(text), "%s %s %s %s %s", fields[0], fields[1], fields[2], fields[3],
+             fields[4]);
+    HOSTTEST_CHECK(schedule_cron_parse(text, &clock_settings.cron[slot]) == ESP_OK,
+                   "cron \"%s\" not parsed", text);
+    clock_settings.alarmsounds[slot].is_alarm = ((rand() % 8) == 0);
+  }
+  alarm_schedule_changed();
+}
+
+// The scan. Slots going off at this local time
+static uint32_t scan_due(const struct tm *local) {
+  uint32_t due = 0;
+  int slot;
+  for (slot = 0; slot < MAX_SOUNDFILES; slot++) {
+    if ((slot != 0) && clock_settings.alarmsounds[slot].is_alarm) {
+      continue;
+    }
+    if (schedule_cron_match(&clock_settings.cron[slot], local)) {
+      due |= 1UL << slot;
+    }
+  }
+  return due;
+}
+
+// The scan minute by minute from a local minute. SCHEDULE_NEVER when
+// nothing goes off in the lookahead.
+static uint32_t scan_next(uint32_t from) {
+  struct tm local;
+  uint32_t minute;
+  for (minute = from; minute < from + (TEST_LOOKAHEAD_DAYS * 24 * 60); minute++) {
+    alarm_schedule_to_tm(minute, &local);
+    if (scan_due(&local) != 0) {
+      return minute;
+    }
+  }
+  return SCHEDULE_NEVER;
+}
+
+int main(int argc, char *argv[]) {
+  schedule_entry_t next;
+  struct tm local;
+  time_t now;
+  uint32_t minute;
+  uint32_t checked = SCHEDULE_NEVER;
+  uint32_t index_due;
+  uint32_t scan;
+  uint32_t alarms = 0;
+  int month = -1;
+  int last_day = -1;
+  srand(21);
+  setenv("TZ", TEST_TZ, 1);
+  tzset();
+  for (now = TEST_START; now < TEST_START + (TEST_DAYS * 86400); now += 30) {
+    localtime_r(&now, &local);
+    if (local.tm_mon != month) {
+      // New settings at the start of a month
+      month = local.tm_mon;
+      random_slots();
+      // Nothing from the old settings until the index is rebuilt
+      HOSTTEST_CHECK(!alarm_schedule_next(&next), "month %d next from the old settings", month);
+    }
+    minute = alarm_schedule_minute(&local);
+    index_due = alarm_schedule_due(&local);
+    scan = (minute == checked) ? 0 : scan_due(&local);
+    checked = minute;
+    alarms += (scan & 1);
+    HOSTTEST_CHECK(index_due == scan, "%04d-%02d-%02d %02d:%02d %s index %08X scan %08X",
+                   local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour,
+                   local.tm_min, local.tm_isdst ? "CEST" : "CET", index_due, scan);
+    if (local.tm_yday != last_day) {
+      // Once a day the first entry of the index
+      last_day = local.tm_yday;
+      scan = scan_next(minute + 1);
+      if (!alarm_schedule_next(&next)) {
+        next.when = SCHEDULE_NEVER;
+      }
+      HOSTTEST_CHECK((next.when == scan) || ((scan == SCHEDULE_NEVER) &&
+                                             (next.when >= minute + 1 +
+                                                               (TEST_LOOKAHEAD_DAYS * 24 * 60))),
+                     "day %d next at minute %u. Scan %u", local.tm_yday, next.when, scan);
+      HOSTTEST_CHECK((next.when == SCHEDULE_NEVER) ||
+                         (alarm_schedule_cron_next(&clock_settings.cron[next.slot], minute + 1) ==
+                          next.when),
+                     "day %d next slot %d does not go off at %u", local.tm_yday, next.slot,
+                     next.when);
+    }
+  }
+  // Workdays. Not on the DST changes, they are on sunday
+  HOSTTEST_CHECK(alarms == 262, "%u alarms in 2024", alarms);
+  return hosttest_result("test_schedule");
+}
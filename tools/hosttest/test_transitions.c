@@ -0,0 +1,394 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The transition table of the clock menu in display_clock.c. Every event
+// in every display state is handled by the table. And by the switch the
+// menu had before the table. Both must call the same functions, start the
+// same menu timer, go to the same state and draw the same screen. With the
+// button held and released, with and without an alarm due, and with the
+// scroll and animation running or finished. The alarm_due event and the
+// alarm timer came after the switch. They are added to it like the minute.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// The table and the handler are static. The firmware file is part of the
+// test. Everything it calls is stubbed below.
+#include "display_clock.c"
+
+struct tm current_timeinfo;
+
+// What the stubs were called with
+static char calls[256];
+static int timeout;
+static int button;
+static int alarm_found;
+static bool frames_left;
+
+static void call(const char *name, int value) {
+  char text[48];
+  snprintf(text, sizeof(text), (value == INT32_MIN) ? "%s " : "%s(%d) ", name, value);
+  strncat(calls, text, sizeof(calls) - strlen(calls) - 1);
+}
+
+#define CALL(name) call(name, INT32_MIN)
+
+// display_functions.c
+void time_sendto_display(void) {
+  CALL("time_sendto_display");
+}
+void time_animate_to_display(void) {
+  CALL("time_animate_to_display");
+}
+void alarm_sendto_display(void) {
+  CALL("alarm_sendto_display");
+}
+void sleep_sendto_display(void) {
+  CALL("sleep_sendto_display");
+}
+void brightness_sendto_display(void) {
+  CALL("brightness_sendto_display");
+}
+void info_scroll_start(void) {
+  CALL("info_scroll_start");
+}
+void clock_store_nvram(int x) {
+  CALL("clock_store_nvram");
+}
+void alarm_onoff(void) {
+  CALL("alarm_onoff");
+}
+void alarm_off(void) {
+  CALL("alarm_off");
+}
+void alarm_add_sleep() {
+  CALL("alarm_add_sleep");
+}
+void stop_alarm(void) {
+  CALL("stop_alarm");
+}
+void alarm_set_time(int adjustment) {
+  call("alarm_set_time", adjustment);
+}
+void sleep_set_time(int adjustment) {
+  call("sleep_set_time", adjustment);
+}
+void brightness_set(int adjustment) {
+  call("brightness_set", adjustment);
+}
+void menu_timer(u_int timer_timeout) {
+  timeout = timer_timeout;
+}
+int check_for_alarm(const struct tm *now) {
+  CALL("check_for_alarm");
+  return alarm_found;
+}
+void alarm_timer_arm(void) {
+  CALL("alarm_timer_arm");
+}
+int alarm_timer_expired(void) {
+  CALL("alarm_timer_expired");
+  return alarm_found;
+}
+
+// The other modules
+int rotary_encoder_get_button(void) {
+  CALL("rotary_encoder_get_button");
+  return button;
+}
+esp_err_t rotary_encoder_init(gpio_num_t pin_a, gpio_num_t pin_b, gpio_num_t pin_switch) {
+  return ESP_OK;
+}
+void open_wifi_ap() {
+  CALL("open_wifi_ap");
+}
+bool display_anim_frame(void) {
+  CALL("display_anim_frame");
+  return frames_left;
+}
+void display_anim_stop(void) {
+}
+bool display_anim_active(void) {
+  return false;
+}
+bool display_scroll_frame(void) {
+  CALL("display_scroll_frame");
+  return frames_left;
+}
+void display_scroll_stop(void) {
+}
+bool display_scroll_active(void) {
+  return false;
+}
+void max7219_fill_display_buffer(char *buf_to_send, int align) {
+  char text[32];
+  snprintf(text, sizeof(text), "fill(%s) ", buf_to_send);
+  strncat(calls, text, sizeof(calls) - strlen(calls) - 1);
+}
+void max7219_send_display(void) {
+  CALL("max7219_send_display");
+}
+void max7219_mark_event(int64_t event_us) {
+}
+esp_err_t max7219_init_spi(const max7219_config_t *config) {
+  return ESP_OK;
+}
+void brightness_ramp_start(int brightness) {
+}
+void alarm_schedule_migrate(void) {
+}
+void alarm_schedule_changed(void) {
+}
+esp_err_t read_nvram(void *blob, size_t sizeof_blob, char *blobname) {
+  return ESP_FAIL;
+}
+
+// The menu before the table. Returns the next state
+static enum display_state_t switch_handle(enum display_state_t state,
+                                          const disp_task_queue_item_t *item) {
+  switch (item->disp_task_signal) {
+    case encoder_press:
+      switch (state) {
+        case clockdisplay:
+          menu_timer(MENU_TIMEOUT_SHORT);
+          return alarmdisplay;
+        case alarmdisplay:
+          menu_timer(MENU_TIMOUT);
+          return sleeptime;
+        case alarmset:
+          alarm_onoff();
+          menu_timer(MENU_TIMOUT);
+          return alarmset;
+        case sleeptime:
+          menu_timer(MENU_TIMOUT);
+          return brightness;
+        case brightness:
+          menu_timer(MENU_TIMOUT);
+          return openwifiap;
+        case alarmgoing:
+          stop_alarm();
+          alarm_add_sleep();
+          menu_timer(ALARM_LONG_PRESS);
+          return alarmgoingpressed;
+        case openwifiap:
+          menu_timer(WIFIOPENAP_LONG_PRESS);
+          return openwifiappressed;
+        case openwifiappressed:
+        case infoscroll:
+          return clockdisplay;
+        default:
+          return state;
+      }
+    case encoder_press_released:
+      return (state == openwifiappressed) ? clockdisplay : state;
+    case minute_passed:
+      if (check_for_alarm(&current_timeinfo)) {
+        state = alarmgoing;
+        menu_timer(3600000);
+      }
+      // Added with the alarm timer
+      alarm_timer_arm();
+      clock_store_nvram(-1);
+      return state;
+    case alarm_due:
+      // Added with the alarm timer. Like the minute
+      if (alarm_timer_expired()) {
+        menu_timer(3600000);
+        return alarmgoing;
+      }
+      return state;
+    case encoder_up:
+    case encoder_down:
+      switch (state) {
+        case clockdisplay:
+          info_scroll_start();
+          return infoscroll;
+        case alarmset:
+          alarm_set_time(item->payload.delta);
+          menu_timer(MENU_TIMOUT);
+          return state;
+        case sleeptime:
+          sleep_set_time(item->payload.delta);
+          menu_timer(MENU_TIMOUT);
+          return state;
+        case brightness:
+          brightness_set(item->payload.delta);
+          menu_timer(MENU_TIMOUT);
+          return state;
+        default:
+          return state;
+      }
+    case timer_expired:
+      switch (state) {
+        case alarmdisplay:
+          menu_timer(MENU_TIMOUT);
+          return alarmset;
+        case alarmgoing:
+          stop_alarm();
+          alarm_off();
+          return clockdisplay;
+        case alarmgoingpressed:
+          if (rotary_encoder_get_button() == 0) {
+            alarm_off();
+            menu_timer(2000);
+            return alarmgoingoff;
+          }
+          return clockdisplay;
+        case openwifiappressed:
+          if (rotary_encoder_get_button() == 0) {
+            open_wifi_ap();
+          }
+          return clockdisplay;
+        default:
+          return clockdisplay;
+      }
+    default:
+      return state;
+  }
+}
+
+// The screens before the table. Returns the state after drawing
+static enum display_state_t switch_draw(enum display_state_t state, enum display_state_t previous,
+                                        const disp_task_queue_item_t *item) {
+  switch (state) {
+    case clockdisplay:
+      if (item->disp_task_signal == anim_frame) {
+        if (!display_anim_frame()) {
+          time_sendto_display();
+        }
+      } else if ((item->disp_task_signal == minute_passed) && (previous == clockdisplay)) {
+        time_animate_to_display();
+      } else {
+        time_sendto_display();
+      }
+      break;
+    case alarmdisplay:
+      max7219_fill_display_buffer("Alarm", MAX7219_ALIGN_MIDDLE);
+      max7219_send_display();
+      break;
+    case alarmset:
+      alarm_sendto_display();
+      break;
+    case sleeptime:
+      sleep_sendto_display();
+      break;
+    case brightness:
+      brightness_sendto_display();
+      break;
+    case alarmgoing:
+    case alarmgoingpressed:
+      time_sendto_display();
+      break;
+    case alarmgoingoff:
+      max7219_fill_display_buffer("Off", MAX7219_ALIGN_MIDDLE);
+      max7219_send_display();
+      break;
+    case openwifiap:
+      max7219_fill_display_buffer("Wifi AP", MAX7219_ALIGN_LEFT);
+      max7219_send_display();
+      break;
+    case infoscroll:
+      if (!display_scroll_frame()) {
+        time_sendto_display();
+        return clockdisplay;
+      }
+      break;
+    default:
+      break;
+  }
+  return state;
+}
+
+typedef struct {
+  enum display_state_t handled;  // state after the event
+  enum display_state_t drawn;    // state after drawing
+  int timeout;
+  char calls[256];
+  char draws[256];
+} outcome_t;
+
+static void table_outcome(enum display_state_t state, const disp_task_queue_item_t *item,
+                          outcome_t *outcome) {
+  display_trace_t entry;
+  uint32_t traced = trace_count;
+  timeout = -1;
+  calls[0] = 0;
+  display_state = state;
+  display_clock_handle(item);
+  outcome->handled = display_state;
+  outcome->timeout = timeout;
+  strcpy(outcome->calls, calls);
+  // Each change of state is traced
+  HOSTTEST_CHECK((outcome->handled == state) || (trace_count == traced + 1),
+                 "%s in %s to %s not traced", disp_task_signal_name(item->disp_task_signal),
+                 display_screens[state].name, display_screens[outcome->handled].name);
+  if (trace_count != traced) {
+    display_clock_get_trace(&entry, 1);
+    HOSTTEST_CHECK((strcmp(entry.from, display_screens[state].name) == 0) &&
+                       (strcmp(entry.to, display_screens[outcome->handled].name) == 0) &&
+                       (strcmp(entry.signal, disp_task_signal_name(item->disp_task_signal)) == 0),
+                   "trace %s %s to %s", entry.signal, entry.from, entry.to);
+  }
+  calls[0] = 0;
+  if (display_screens[display_state].draw != NULL) {
+    display_screens[display_state].draw(item, state);
+  }
+  outcome->drawn = display_state;
+  strcpy(outcome->draws, calls);
+}
+
+static void switch_outcome(enum display_state_t state, const disp_task_queue_item_t *item,
+                           outcome_t *outcome) {
+  timeout = -1;
+  calls[0] = 0;
+  outcome->handled = switch_handle(state, item);
+  outcome->timeout = timeout;
+  strcpy(outcome->calls, calls);
+  calls[0] = 0;
+  outcome->drawn = switch_draw(outcome->handled, state, item);
+  strcpy(outcome->draws, calls);
+}
+
+static void check_transition(enum display_state_t state, disp_task_signal_t signal) {
+  disp_task_queue_item_t item = {.disp_task_signal = signal};
+  outcome_t table;
+  outcome_t old;
+  int variant;
+  // Held or released button. Alarm due or not. Frames left or not
+  for (variant = 0; variant < 8; variant++) {
+    button = variant & 1;
+    alarm_found = (variant >> 1) & 1;
+    frames_left = (variant >> 2) & 1;
+    item.payload.delta = (signal == encoder_down) ? -2 : 3;
+    table_outcome(state, &item, &table);
+    switch_outcome(state, &item, &old);
+    HOSTTEST_CHECK((table.handled == old.handled) && (table.timeout == old.timeout) &&
+                       (strcmp(table.calls, old.calls) == 0),
+                   "%s in %s button %d alarm %d: table to %s timer %d calls %s. switch to %s "
+                   "timer %d calls %s",
+                   disp_task_signal_name(signal), display_screens[state].name, button,
+                   alarm_found, display_screens[table.handled].name, table.timeout, table.calls,
+                   display_screens[old.handled].name, old.timeout, old.calls);
+    HOSTTEST_CHECK((table.drawn == old.drawn) && (strcmp(table.draws, old.draws) == 0),
+                   "%s in %s frames %d: table draws %s in %s. switch draws %s in %s",
+                   disp_task_signal_name(signal), display_screens[state].name, frames_left,
+                   table.draws, display_screens[table.drawn].name, old.draws,
+                   display_screens[old.drawn].name);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int state;
+  int signal;
+  for (state = 0; state < DISPLAY_SCREENS; state++) {
+    for (signal = 0; signal < DISP_TASK_SIGNALS; signal++) {
+      check_transition(state, signal);
+    }
+  }
+  return hosttest_result("test_transitions");
+}
@@ -0,0 +1,104 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// The UTF-8 decoder of fonts.c. Every code point is decoded back. Overlong
+// sequences, UTF-16 surrogates, code points above U+10FFFF and broken
+// sequences give the replacement character. Every font has a glyph for it.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hosttest.h"
+
+// Firmware headers
+#include "fonts.h"
+
+// Encoded in length bytes. Also longer than needed
+static void utf8_encode(uint32_t character, int length, char *text) {
+  static const uint8_t lead[] = {0x00, 0x00, 0xC0, 0xE0, 0xF0};
+  int x;
+  for (x = length - 1; x > 0; x--) {
+    text[x] = 0x80 | (character & 0x3F);
+    character >>= 6;
+  }
+  text[0] = lead[length] | character;
+  text[length] = 0;
+}
+
+// Decode a whole string. Returns the amount of characters
+static int decode(const char *text, uint32_t *characters, int max) {
+  const char *next = text;
+  int count = 0;
+  while (*next && (count < max)) {
+    characters[count++] = fonts_utf8_next(&next);
+  }
+  return count;
+}
+
+typedef struct {
+  const char *text;
+  int count;
+  uint32_t characters[4];
+} utf8_case_t;
+
+static const utf8_case_t cases[] = {
+    {"A\xC3\xA9", 2, {'A', 0xE9}},                          // e acute
+    {"\xE2\x82\xAC", 1, {0x20AC}},                           // euro
+    {"\xF0\x9F\x98\x80", 1, {0x1F600}},                      // 4 bytes
+    {"\xC0\xAF", 2, {FONTS_INVALID_CHAR, FONTS_INVALID_CHAR}},  // overlong '/'
+    {"\xC1\xBF", 2, {FONTS_INVALID_CHAR, FONTS_INVALID_CHAR}},
+    {"\xE0\x80\xAF", 3, {FONTS_INVALID_CHAR, FONTS_INVALID_CHAR, FONTS_INVALID_CHAR}},
+    {"\xED\xA0\x80", 3, {FONTS_INVALID_CHAR, FONTS_INVALID_CHAR, FONTS_INVALID_CHAR}},  // U+D800
+    {"\xED\x9F\xBF", 1, {0xD7FF}},
+    {"\xF4\x90\x80\x80", 4, {FONTS_INVALID_CHAR, FONTS_INVALID_CHAR, FONTS_INVALID_CHAR,
+                             FONTS_INVALID_CHAR}},  // above U+10FFFF
+    {"\xF5\x80", 2, {FONTS_INVALID_CHAR, FONTS_INVALID_CHAR}},
+    {"\xE2\x82" "A", 2, {FONTS_INVALID_CHAR, 'A'}},  // cut short
+    {"\xE2\x82", 1, {FONTS_INVALID_CHAR}},            // cut by the end
+    {"\x80" "A", 2, {FONTS_INVALID_CHAR, 'A'}},
+};
+
+int main(int argc, char *argv[]) {
+  char text[8];
+  uint32_t characters[8];
+  uint32_t character;
+  const u_int8_t *glyph;
+  int length;
+  int count;
+  int font;
+  int x;
+  for (x = 0; x < sizeof(cases) / sizeof(cases[0]); x++) {
+    count = decode(cases[x].text, characters, 8);
+    HOSTTEST_CHECK((count == cases[x].count) &&
+                       (memcmp(characters, cases[x].characters, count * sizeof(uint32_t)) == 0),
+                   "case %d gives %d characters U+%04X", x, count, characters[0]);
+  }
+  for (character = 0x80; character <= 0x10FFFF; character++) {
+    length = (character < 0x800) ? 2 : (character < 0x10000) ? 3 : 4;
+    utf8_encode(character, length, text);
+    count = decode(text, characters, 8);
+    if ((character >= 0xD800) && (character <= 0xDFFF)) {
+      HOSTTEST_CHECK((count == 3) && (characters[0] == FONTS_INVALID_CHAR),
+                     "surrogate U+%04X decoded", character);
+    } else {
+      HOSTTEST_CHECK((count == 1) && (characters[0] == character), "U+%04X gives U+%04X",
+                     character, characters[0]);
+    }
+    // One byte more than needed is overlong
+    if (length < 4) {
+      utf8_encode(character, length + 1, text);
+      count = decode(text, characters, 8);
+      HOSTTEST_CHECK((count == length + 1) && (characters[0] == FONTS_INVALID_CHAR),
+                     "overlong U+%04X gives U+%04X", character, characters[0]);
+    }
+  }
+  for (font = 0; font < fonts_count(); font++) {
+    fonts_select(font);
+    HOSTTEST_CHECK(fonts_glyph(FONTS_INVALID_CHAR, &glyph) > 0, "no replacement glyph in %s",
+                   fonts_get(font)->name);
+  }
+  return hosttest_result("test_utf8");
+}
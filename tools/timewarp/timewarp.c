@@ -0,0 +1,603 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ *
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+// Time warp simulation of the alarm clock on the host. Build and run it
+// with timewarp.sh.
+//
+// The time task (systemtime_start), the alarm schedule, check_for_alarm,
+// the alarm timer and sleep (alarm_add_sleep) are the firmware code. Below
+// they run on a virtual clock:
+// - gettimeofday and settimeofday are the wall clock of the ESP32
+// - esp_timer_get_time is the time since boot. The ESP32 crystal runs fast
+//   by the drift. So the wall clock drifts away from the DS3231. The time
+//   task sets it back every SNTP_MAX_TIME_NOSYNC minutes. There is no SNTP
+// - vTaskDelay of the time task moves the clock on. While waiting the
+//   esp_timers go off and this file handles the display task queue. Like
+//   the display task does for the minute and alarm events
+// - a user presses the button a while after the alarm starts. A few times
+//   for sleep. Then long to switch the alarm off for the day
+//
+// Every sound started is written to stdout with its local time. The same
+// settings give the same output. Diff it to see what a change does. The
+// speed in simulated days per second is on stderr.
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "timewarp_idf.h"
+
+// Firmware headers
+#include "64bitpatch_localtime.h"
+#include "alarm_schedule.h"
+#include "app_queue.h"
+#include "defaults_globals.h"
+#include "display_anim.h"
+#include "display_functions.h"
+#include "display_scroll.h"
+#include "ds3231.h"
+#include "max7219.h"
+#include "networkstartstop.h"
+#include "nvramfunctions.h"
+#include "schedule_cron.h"
+#include "sound.h"
+#include "time_task.h"
+
+// time_task.c. Not in time_task.h
+void systemtime_start();
+
+#define TIMEWARP_TIMERS 8
+#define TIMEWARP_QUEUE_LENGTH 32
+#define TIMEWARP_QUEUE_ITEM 32
+
+// Settings of the run
+static const char *timezone_text = "CET-1CEST,M3.5.0,M10.5.0/3";
+static int64_t start_us = 1704067200LL * 1000000;  // 2024-01-01 00:00 UTC
+static int days = 365;
+static int drift_ppm = 20;
+static int sleeps = 2;             // sleep presses before switching the alarm off
+static int press_after_s = 45;     // seconds from the start of the alarm to a press
+static bool verbose = false;
+
+// The virtual clock. All in microseconds
+static int64_t boot_us = 0;         // since boot. esp_timer_get_time
+static int64_t wall_offset_us = 0;  // wall clock is boot_us + wall_offset_us
+static int64_t end_boot_us;
+
+typedef struct esp_timer {
+  esp_timer_cb_t callback;
+  void *arg;
+  int64_t deadline;  // boot_us. 0 when not running
+  uint64_t period;
+} timewarp_timer_t;
+static timewarp_timer_t timers[TIMEWARP_TIMERS];
+static int timer_count = 0;
+
+typedef struct timewarp_queue {
+  uint8_t items[TIMEWARP_QUEUE_LENGTH][TIMEWARP_QUEUE_ITEM];
+  UBaseType_t item_size;
+  int head;
+  int count;
+} timewarp_queue_t;
+static timewarp_queue_t display_queue;
+// The display task runs the events of the current screen
+static disp_task_signal_t handling = noop;
+
+// The user
+static int64_t press_at = -1;  // boot_us of the next press. -1 none
+static int sleeps_done = 0;
+
+// Totals for the summary
+static uint32_t alarms = 0;
+static uint32_t sounds = 0;
+static uint32_t presses = 0;
+static uint32_t corrections = 0;
+static bool clock_set = false;
+static sntp_sync_time_cb_t sntp_callback = NULL;
+
+setupparams_t setupparams;
+clock_settings_t clock_settings;
+
+// DS3231 time. The real time. The ESP32 clock runs drift_ppm fast
+static int64_t rtc_us(void) {
+  return start_us + boot_us - ((boot_us / 1000000) * drift_ppm);
+}
+
+static int64_t wall_us(void) {
+  return boot_us + wall_offset_us;
+}
+
+// Wall clock as local time text. For the log
+static void wall_text(char *text, int length) {
+  struct timeval now;
+  struct tm now_tm;
+  char date[32];
+  // The time task sets TZ to UTC for a while when it reads the DS3231
+  setenv("TZ", setupparams.timezone, 1);
+  tzset();
+  timewarp_gettimeofday(&now, NULL);
+  localtime_r(&now.tv_sec, &now_tm);
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &now_tm);
+  snprintf(text, length, "%s.%06ld %s", date, (long)now.tv_usec, now_tm.tm_isdst ? "dst" : "std");
+}
+
+void timewarp_log(const char *level, const char *tag, const char *format, ...) {
+  va_list args;
+  if (!verbose) {
+    return;
+  }
+  fprintf(stderr, "%s (%lld) %s: ", level, (long long)(boot_us / 1000), tag);
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  return (code == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+uint32_t esp_random(void) {
+  // Nothing random in a simulation
+  return 4;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t copy = (length < size - 1) ? length : size - 1;
+    memcpy(dst, src, copy);
+    dst[copy] = 0;
+  }
+  return length;
+}
+
+// Wall clock
+int timewarp_gettimeofday(struct timeval *tv, void *tz) {
+  int64_t now = wall_us();
+  tv->tv_sec = now / 1000000;
+  tv->tv_usec = now % 1000000;
+  return 0;
+}
+
+int timewarp_settimeofday(const struct timeval *tv, const struct timezone *tz) {
+  int64_t old = wall_us();
+  wall_offset_us = ((int64_t)tv->tv_sec * 1000000) + tv->tv_usec - boot_us;
+  if (clock_set && (wall_us() != old)) {
+    corrections++;
+  }
+  clock_set = true;
+  timewarp_log("I", "Timewarp", "Clock set %+lld us", (long long)(wall_us() - old));
+  return 0;
+}
+
+void tzset_patch(void) {
+  tzset();
+}
+
+struct tm *localtime_patch(const time_t *__restrict tim_p, struct tm *__restrict res) {
+  return localtime_r(tim_p, res);
+}
+
+// esp_timer
+int64_t esp_timer_get_time(void) {
+  return boot_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+  if (timer_count == TIMEWARP_TIMERS) {
+    return ESP_ERR_NO_MEM;
+  }
+  timers[timer_count].callback = args->callback;
+  timers[timer_count].arg = args->arg;
+  *handle = &timers[timer_count++];
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  timer->deadline = boot_us + timeout_us;
+  timer->period = 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+  timer->deadline = boot_us + period;
+  timer->period = period;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (timer->deadline == 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->deadline = 0;
+  return ESP_OK;
+}
+
+// Queues. Only the display task queue is used
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  if (item_size > TIMEWARP_QUEUE_ITEM) {
+    fprintf(stderr, "Queue items of %u bytes do not fit\n", item_size);
+    exit(1);
+  }
+  display_queue.item_size = item_size;
+  return &display_queue;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait) {
+  if (queue->count == TIMEWARP_QUEUE_LENGTH) {
+    return pdFALSE;
+  }
+  memcpy(queue->items[(queue->head + queue->count) % TIMEWARP_QUEUE_LENGTH], item,
+         queue->item_size);
+  queue->count++;
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken) {
+  return xQueueSendToBack(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  if (queue->count == 0) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items[queue->head], queue->item_size);
+  queue->head = (queue->head + 1) % TIMEWARP_QUEUE_LENGTH;
+  queue->count--;
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return &display_queue;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  return pdTRUE;
+}
+
+BaseType_t xTaskCreate(void (*task)(), const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  // Only the time task runs. Called from main
+  return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return boot_us / (portTICK_PERIOD_MS * 1000);
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload, void *id,
+                           TimerCallbackFunction_t callback) {
+  return (TimerHandle_t)&display_queue;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait) {
+  return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait) {
+  return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait) {
+  return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait) {
+  return pdPASS;
+}
+
+// No network. No SNTP. The DS3231 keeps the time
+bool sntp_enabled(void) {
+  return false;
+}
+void sntp_init(void) {
+}
+void sntp_stop(void) {
+}
+void sntp_set_sync_mode(sntp_sync_mode_t mode) {
+}
+void sntp_setoperatingmode(uint8_t mode) {
+}
+void sntp_setservername(uint8_t index, const char *server) {
+}
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {
+  sntp_callback = callback;
+}
+sntp_sync_status_t sntp_get_sync_status(void) {
+  return SNTP_SYNC_STATUS_RESET;
+}
+
+esp_err_t ds3231_get_time(struct tm *time) {
+  time_t now = rtc_us() / 1000000;
+  gmtime_r(&now, time);
+  return ESP_OK;
+}
+
+esp_err_t ds3231_set_time(struct tm *time) {
+  // Keeps its own time
+  return ESP_OK;
+}
+
+esp_err_t ds3231_get_temp_float(float *temp) {
+  *temp = 20.0;
+  return ESP_OK;
+}
+
+// Sound
+void play_wav(char *wavsound, int repeat) {
+  struct timeval now;
+  char text[48];
+  timewarp_gettimeofday(&now, NULL);
+  wall_text(text, sizeof(text));
+  // Local time offsets are whole minutes. Time since the start of the minute
+  printf("%s %-5s %-12s onset %6ld us %s\n", text, repeat ? "alarm" : "sound", wavsound,
+         (long)(((now.tv_sec % 60) * 1000000) + now.tv_usec),
+         (handling == alarm_due) ? "timer" : "tick");
+  if (repeat) {
+    alarms++;
+    // The user presses the button a while later
+    press_at = boot_us + ((int64_t)press_after_s * 1000000);
+  } else {
+    sounds++;
+  }
+}
+
+void stop_sound(void) {
+}
+
+// No display. No network. No NVS
+bool display_anim_active(void) {
+  return false;
+}
+esp_err_t display_anim_start(const display_anim_digit_t *digits, int count,
+                             display_anim_effect_t effect) {
+  return ESP_ERR_NOT_FOUND;
+}
+void display_anim_stop(void) {
+}
+esp_err_t display_scroll_start(char *text, int cols_per_sec) {
+  return ESP_OK;
+}
+int max7219_get_width(void) {
+  return 32;
+}
+void max7219_send_display(void) {
+}
+void max7219_empty_display_buffer(void) {
+}
+void max7219_sprite_fill_buffer(char *buf_to_send, int position) {
+}
+int max7219_render_columns(char *buf_to_send, u_int8_t *columns, int length) {
+  return 0;
+}
+void max7219_gray_from_display(void) {
+}
+void max7219_gray_fill_columns(const u_int8_t *columns, int position, int length, int level) {
+}
+esp_err_t max7219_gray_show(void) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+void network_get_ip(char *ip_text, int length) {
+  strlcpy(ip_text, "0.0.0.0", length);
+}
+void write_nvram(void *blob, size_t sizeof_blob, char *blobname) {
+}
+
+// The button. Sleep a few times. Then a long press switches the alarm off
+static void timewarp_press(void) {
+  char text[48];
+  wall_text(text, sizeof(text));
+  press_at = -1;
+  presses++;
+  stop_alarm();
+  alarm_add_sleep();
+  if (sleeps_done < sleeps) {
+    sleeps_done++;
+    printf("%s press sleep %d\n", text, sleeps_done);
+  } else {
+    sleeps_done = 0;
+    alarm_off();
+    printf("%s press alarm off\n", text);
+  }
+}
+
+// The alarm events of the display task. See the transitions in display_clock.c
+static void timewarp_display_task(void) {
+  disp_task_queue_item_t item;
+  while (xQueueReceive(&display_queue, &item, 0) == pdTRUE) {
+    handling = item.disp_task_signal;
+    switch (item.disp_task_signal) {
+      case minute_passed:
+        check_for_alarm(&current_timeinfo);
+        alarm_timer_arm();
+        clock_store_nvram(-1);
+        break;
+      case alarm_due:
+        alarm_timer_expired();
+        break;
+      default:
+        break;
+    }
+    handling = noop;
+  }
+}
+
+static void timewarp_summary(void) {
+  alarm_onset_stats_t onset[2];
+  struct timespec now;
+  static struct timespec started;
+  double seconds;
+  if (started.tv_sec == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  seconds = (now.tv_sec - started.tv_sec) + ((now.tv_nsec - started.tv_nsec) / 1e9);
+  alarm_get_onset_stats(&onset[0], &onset[1]);
+  fprintf(stderr, "Simulated %d days in %.2f s. %.0f days per second\n", days, seconds,
+          days / seconds);
+  fprintf(stderr, "Alarms %u. Sounds %u. Presses %u. Clock corrections %u\n", alarms, sounds,
+          presses, corrections);
+  for (int x = 0; x < 2; x++) {
+    fprintf(stderr, "Onset %s: count %u timer %u us_avg %u us_max %u\n", x ? "sound" : "alarm",
+            onset[x].count, onset[x].timer, onset[x].us_avg, onset[x].us_max);
+  }
+}
+
+// The time task waits. Everything else happens in the mean time
+void vTaskDelay(TickType_t ticks) {
+  int64_t until = boot_us + ((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+  timewarp_timer_t *next;
+  int64_t next_at;
+  timewarp_display_task();
+  while (true) {
+    next = NULL;
+    next_at = until + 1;
+    for (int x = 0; x < timer_count; x++) {
+      if ((timers[x].deadline != 0) && (timers[x].deadline < next_at)) {
+        next = &timers[x];
+        next_at = timers[x].deadline;
+      }
+    }
+    if ((press_at >= 0) && (press_at < next_at)) {
+      boot_us = press_at;
+      timewarp_press();
+      timewarp_display_task();
+      continue;
+    }
+    if (next == NULL) {
+      break;
+    }
+    boot_us = next_at;
+    next->deadline = next->period ? (next_at + next->period) : 0;
+    next->callback(next->arg);
+    timewarp_display_task();
+  }
+  boot_us = until;
+  if (boot_us >= end_boot_us) {
+    timewarp_summary();
+    fflush(stdout);
+    exit(0);
+  }
+}
+
+// -c "<cron> <sound>". The last word is the sound
+static void timewarp_add_sound(int slot, const char *text) {
+  char cron_text[CRON_TEXT_LENGTH];
+  const char *sound = strrchr(text, ' ');
+  if ((sound == NULL) || (sound - text >= CRON_TEXT_LENGTH) ||
+      (strlen(sound + 1) >= MAX_SOUNDFILE_LENGTH)) {
+    fprintf(stderr, "Use -c \"<cron> <sound>\"\n");
+    exit(1);
+  }
+  memcpy(cron_text, text, sound - text);
+  cron_text[sound - text] = 0;
+  if (schedule_cron_parse(cron_text, &clock_settings.cron[slot]) != ESP_OK) {
+    fprintf(stderr, "Not a valid cron: %s\n", cron_text);
+    exit(1);
+  }
+  strcpy(clock_settings.alarmsounds[slot].soundfile, sound + 1);
+}
+
+static void timewarp_usage(void) {
+  fprintf(stderr,
+          "timewarp [-z timezone] [-s yyyy-mm-dd] [-d days] [-a hh:mm|off] [-c \"cron sound\"]...\n"
+          "         [-n sleeps] [-p press seconds] [-r drift ppm] [-v]\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int option;
+  int slot = 1;
+  int year, month, day;
+  int hour = 6;
+  int minute = 45;
+  struct tm start_tm;
+  clock_settings.alarm_onoff = true;
+  clock_settings.default_on = true;
+  clock_settings.sleep_minutes = 9;
+  strcpy(clock_settings.alarmsounds[0].soundfile, "alarm");
+  while ((option = getopt(argc, argv, "z:s:d:a:c:n:p:r:v")) != -1) {
+    switch (option) {
+      case 'z':
+        timezone_text = optarg;
+        break;
+      case 's':
+        if (sscanf(optarg, "%d-%d-%d", &year, &month, &day) != 3) {
+          timewarp_usage();
+        }
+        memset(&start_tm, 0, sizeof(start_tm));
+        start_tm.tm_year = year - 1900;
+        start_tm.tm_mon = month - 1;
+        start_tm.tm_mday = day;
+        start_us = (int64_t)timegm(&start_tm) * 1000000;
+        break;
+      case 'd':
+        days = atoi(optarg);
+        break;
+      case 'a':
+        if (strcmp(optarg, "off") == 0) {
+          clock_settings.alarm_onoff = false;
+        } else if (sscanf(optarg, "%d:%d", &hour, &minute) != 2) {
+          timewarp_usage();
+        }
+        break;
+      case 'c':
+        if (slot == MAX_SOUNDFILES) {
+          fprintf(stderr, "Max %d sounds\n", MAX_SOUNDFILES - 1);
+          exit(1);
+        }
+        timewarp_add_sound(slot++, optarg);
+        break;
+      case 'n':
+        sleeps = atoi(optarg);
+        break;
+      case 'p':
+        press_after_s = atoi(optarg);
+        break;
+      case 'r':
+        drift_ppm = atoi(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        timewarp_usage();
+    }
+  }
+  if (slot == 1) {
+    // Some sounds to start with
+    timewarp_add_sound(slot++, "0 12 * * 1-5 noon");
+    timewarp_add_sound(slot++, "30 7 * * 0,6 weekend");
+    timewarp_add_sound(slot++, "0 20 24 12 * christmas");
+    timewarp_add_sound(slot++, "*/15 2 * * * night");
+  }
+  clock_settings.alarmsounds[0].hour = hour;
+  clock_settings.alarmsounds[0].minute = minute;
+  schedule_cron_daily(&clock_settings.cron[0], hour, minute);
+  clock_settings.cron_version = CLOCK_CRON_VERSION;
+  alarm_schedule_changed();
+  strlcpy(setupparams.timezone, timezone_text, sizeof(setupparams.timezone));
+  end_boot_us = (int64_t)days * 24 * 3600 * 1000000;
+  timewarp_summary();
+  // Never returns. vTaskDelay ends the run
+  systemtime_start();
+  return 0;
+}
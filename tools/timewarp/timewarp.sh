@@ -0,0 +1,57 @@
+#!/bin/bash
+# Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+#
+# MIT Licensed as described in the file LICENSE
+#
+# Builds the time warp simulation on the host and runs it. See timewarp.c
+# The alarm code of main/ is compiled with timewarp_idf.h in place of
+# ESP-IDF and FreeRTOS. The C compiler of the host is used. No ESP-IDF.
+#
+# usage: timewarp.sh [options of timewarp]
+#   -z timezone    POSIX TZ. Default CET-1CEST,M3.5.0,M10.5.0/3
+#   -s yyyy-mm-dd  first day. UTC. Default 2024-01-01
+#   -d days        days to simulate. Default 365
+#   -a hh:mm|off   alarm. Default 06:45
+#   -c "cron sound" sound slot. More than once for more slots
+#   -n sleeps      sleep presses before the alarm is switched off
+#   -p seconds     seconds from the alarm to a press
+#   -r ppm         ESP32 clock drift
+#   -v             log of the firmware on stderr
+#
+# Sounds and presses go to stdout. Diff two runs to see what changed.
+# Build directory is $TIMEWARP_BUILD. Default /tmp/timewarp
+
+set -e
+
+TOOL=$(cd "$(dirname "$0")" && pwd)
+MAIN="$TOOL/../../main"
+BUILD=${TIMEWARP_BUILD:-/tmp/timewarp}
+CC=${CC:-cc}
+CFLAGS="-O2 -g -Wall -Wno-format -Wno-unused-variable -Wno-unused-function"
+
+# Firmware files in the simulation
+FIRMWARE="time_task app_queue display_functions alarm_schedule schedule_cron schedule_store"
+
+# IDF header names the firmware includes
+HEADERS="esp_attr.h esp_err.h esp_log.h esp_system.h esp_timer.h sdkconfig.h sntp.h
+  freertos/FreeRTOS.h freertos/portmacro.h freertos/queue.h freertos/semphr.h
+  freertos/task.h freertos/timers.h driver/gpio.h driver/i2c.h driver/pcnt.h
+  driver/spi_common.h driver/spi_master.h hal/gpio_types.h lwip/apps/sntp.h"
+
+mkdir -p "$BUILD/include"
+for header in $HEADERS; do
+  mkdir -p "$BUILD/include/$(dirname "$header")"
+  echo '#include "timewarp_idf.h"' >"$BUILD/include/$header"
+done
+
+INCLUDES="-I$BUILD/include -I$TOOL -I$MAIN"
+OBJECTS=""
+for name in $FIRMWARE; do
+  $CC $CFLAGS $INCLUDES -Dgettimeofday=timewarp_gettimeofday \
+    -Dsettimeofday=timewarp_settimeofday -c "$MAIN/$name.c" -o "$BUILD/$name.o"
+  OBJECTS="$OBJECTS $BUILD/$name.o"
+done
+$CC $CFLAGS $INCLUDES -c "$TOOL/timewarp.c" -o "$BUILD/timewarp.o"
+$CC -o "$BUILD/timewarp" "$BUILD/timewarp.o" $OBJECTS
+
+"$BUILD/timewarp" "$@"
@@ -0,0 +1,157 @@
+/* Copyright (C) 2020 Udo de Boer <udo.de.boer1@gmail.com>
+ * 
+ * MIT Licensed as described in the file LICENSE
+ */
+
+
+#ifndef TIMEWARP_IDF_H_
+#define TIMEWARP_IDF_H_
+
+// The part of ESP-IDF and FreeRTOS used by the alarm code. For the host
+// build of the time warp simulation. timewarp.sh makes every IDF header
+// name the firmware includes point to this file. timewarp.c implements it
+// on a virtual clock. The host tests in tools/hosttest add to it.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+// sdkconfig.h, esp_attr.h
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+// esp_err.h
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERROR_CHECK(x) (void)(x)
+const char *esp_err_to_name(esp_err_t code);
+
+// esp_log.h. Only printed with TIMEWARP_VERBOSE set
+void timewarp_log(const char *level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+#define ESP_LOGE(tag, ...) timewarp_log("E", tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) timewarp_log("W", tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) timewarp_log("I", tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) timewarp_log("D", tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) timewarp_log("V", tag, __VA_ARGS__)
+
+// esp_system.h
+uint32_t esp_random(void);
+
+// esp_timer.h
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+int64_t esp_timer_get_time(void);
+
+// freertos/FreeRTOS.h, portmacro.h
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffff
+// CONFIG_FREERTOS_HZ=100
+#define portTICK_PERIOD_MS 10
+#define pdMS_TO_TICKS(x) ((x) / portTICK_PERIOD_MS)
+typedef struct {
+  int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+#define portENTER_CRITICAL_ISR(mux) (void)(mux)
+#define portEXIT_CRITICAL_ISR(mux) (void)(mux)
+#define portYIELD_FROM_ISR()
+
+// freertos/queue.h, semphr.h
+typedef struct timewarp_queue *QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+// freertos/task.h
+typedef struct timewarp_task *TaskHandle_t;
+BaseType_t xTaskCreate(void (*task)(), const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+// freertos/timers.h. The menus are not simulated. These never go off.
+typedef struct timewarp_timer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t reload, void *id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait);
+
+// hal/gpio_types.h, driver/gpio.h, driver/i2c.h, driver/spi_master.h.
+// Only the names used in the headers of the firmware.
+typedef int gpio_num_t;
+#define GPIO_NUM_9 9
+#define GPIO_NUM_27 27
+#define GPIO_NUM_32 32
+#define GPIO_NUM_33 33
+typedef int i2c_port_t;
+#define I2C_NUM_1 1
+typedef enum { SPI1_HOST, SPI2_HOST, SPI3_HOST } spi_host_device_t;
+
+// lwip/apps/sntp.h, sntp.h
+typedef enum { SNTP_SYNC_MODE_IMMED, SNTP_SYNC_MODE_SMOOTH } sntp_sync_mode_t;
+typedef enum {
+  SNTP_SYNC_STATUS_RESET,
+  SNTP_SYNC_STATUS_COMPLETED,
+  SNTP_SYNC_STATUS_IN_PROGRESS
+} sntp_sync_status_t;
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+#define SNTP_OPMODE_POLL 0
+bool sntp_enabled(void);
+void sntp_init(void);
+void sntp_stop(void);
+void sntp_set_sync_mode(sntp_sync_mode_t mode);
+void sntp_setoperatingmode(uint8_t mode);
+void sntp_setservername(uint8_t index, const char *server);
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+sntp_sync_status_t sntp_get_sync_status(void);
+
+// string.h of newlib. Not in every C library of a host
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+// gettimeofday and settimeofday of the firmware are renamed by timewarp.sh
+// to these. timewarp.c has them on the virtual clock.
+int timewarp_gettimeofday(struct timeval *tv, void *tz);
+int timewarp_settimeofday(const struct timeval *tv, const struct timezone *tz);
+
+#endif